@@ -0,0 +1,90 @@
+#include <allocation_counter.h>
+
+#include <cstddef>
+#include <errno.h>
+
+// glibc's allocator, the replacements below forward to it
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace
+{
+// plain thread locals in the executable, usable before any constructor runs
+__thread bool counting = false;
+__thread uint64_t calls = 0;
+
+inline void count()
+{
+  if (counting)
+    calls++;
+}
+}
+
+namespace prosthesis
+{
+void AllocationCounter::start()
+{
+  calls = 0;
+  counting = true;
+}
+
+uint64_t AllocationCounter::stop()
+{
+  counting = false;
+  return calls;
+}
+}
+
+extern "C" {
+void* malloc(size_t size)
+{
+  count();
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count_, size_t size)
+{
+  count();
+  return __libc_calloc(count_, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+  count();
+  return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer)
+{
+  if (pointer)
+    count();
+  __libc_free(pointer);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+  count();
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+  count();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+  count();
+  void* result = __libc_memalign(alignment, size);
+  if (!result)
+    return ENOMEM;
+  *pointer = result;
+  return 0;
+}
+}
@@ -0,0 +1,190 @@
+// Checks that EmgWindow gives bit identical features to sums recomputed over the whole window, for
+// whatever SIMD path the build selects (AVX2, SSE2 or scalar). The samples include values outside
+// the Myo's 8 bit range, the window wraps and is resized, and the zero crossing threshold changes on
+// the way. Exit code 1 on the first mismatch, no ROS needed.
+//
+// usage: emg_window_check [samples]
+#include <emg_features.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+
+namespace
+{
+using namespace prosthesis;
+
+int32_t clampSample(int32_t x)
+{
+  return x < emg_min ? emg_min : (x > emg_max ? emg_max : x);
+}
+
+// the window as a plain list of the clamped samples and the crossing flag each one added
+struct ReferenceWindow
+{
+  struct Entry
+  {
+    int32_t x[emg_channels];
+    int32_t crossing[emg_channels];
+  };
+
+  std::deque<Entry> entries;
+  std::size_t length;
+  int32_t previous[emg_channels];
+
+  void resize(std::size_t new_length)
+  {
+    length = new_length < 1 ? 1 : (new_length > EmgWindow::max_length ? EmgWindow::max_length : new_length);
+    entries.clear();
+    for (int c = 0; c < emg_channels; c++)
+      previous[c] = 0;
+  }
+
+  void push(const int16_t* sample, int32_t threshold)
+  {
+    Entry entry;
+    for (int c = 0; c < emg_channels; c++)
+    {
+      const int32_t x = clampSample(sample[c]);
+      const bool sign_change = (previous[c] > 0 && x < 0) || (previous[c] < 0 && x > 0);
+      entry.x[c] = x;
+      entry.crossing[c] = sign_change && std::abs(x - previous[c]) >= threshold;
+      previous[c] = x;
+    }
+    entries.push_back(entry);
+    if (entries.size() > length)
+      entries.pop_front();
+  }
+
+  // the same float arithmetic as EmgWindow::features, on sums taken over the window in 64 bit
+  void features(EmgFeatures& features) const
+  {
+    const float scale = !entries.empty() ? 1.0f / entries.size() : 0.0f;
+    for (int c = 0; c < emg_channels; c++)
+    {
+      int64_t square = 0, abs = 0, crossings = 0;
+      for (std::size_t k = 0; k < entries.size(); k++)
+      {
+        square += int64_t(entries[k].x[c]) * entries[k].x[c];
+        abs += std::abs(entries[k].x[c]);
+        crossings += entries[k].crossing[c];
+      }
+      features.rms[c] = std::sqrt(static_cast<int32_t>(square) * scale);
+      features.mav[c] = static_cast<int32_t>(abs) * scale;
+      features.zero_crossings[c] = static_cast<int32_t>(crossings) * scale;
+    }
+  }
+};
+
+bool same(const EmgFeatures& a, const EmgFeatures& b)
+{
+  return memcmp(a.rms, b.rms, sizeof(a.rms)) == 0 && memcmp(a.mav, b.mav, sizeof(a.mav)) == 0 &&
+         memcmp(a.zero_crossings, b.zero_crossings, sizeof(a.zero_crossings)) == 0;
+}
+
+void print(const char* name, const float* values)
+{
+  fprintf(stderr, "  %s:", name);
+  for (int c = 0; c < emg_channels; c++)
+    fprintf(stderr, " %.9g", values[c]);
+  fprintf(stderr, "\n");
+}
+
+void printDifference(std::size_t step, const EmgFeatures& window, const EmgFeatures& reference)
+{
+  fprintf(stderr, "sample %lu: features differ, window then reference\n", static_cast<unsigned long>(step));
+  print("rms", window.rms);
+  print("rms", reference.rms);
+  print("mav", window.mav);
+  print("mav", reference.mav);
+  print("zero crossings", window.zero_crossings);
+  print("zero crossings", reference.zero_crossings);
+}
+
+// the longest window full of the largest square, where an int32 sum would overflow one sample later
+bool checkLongest()
+{
+  EmgWindow window(EmgWindow::max_length + 1000);
+  if (window.length() != EmgWindow::max_length)
+  {
+    fprintf(stderr, "length %lu is not capped at %lu\n", static_cast<unsigned long>(window.length()),
+            static_cast<unsigned long>(EmgWindow::max_length));
+    return false;
+  }
+  const int16_t sample[emg_channels] = { -32768, -32768, -32768, -32768, -32768, -32768, -32768, -32768 };
+  for (std::size_t k = 0; k < EmgWindow::max_length + 10; k++)
+    window.push(sample);
+
+  EmgFeatures features;
+  window.features(features);
+  const float scale = 1.0f / EmgWindow::max_length;
+  const float rms = std::sqrt(static_cast<int32_t>(128 * 128 * EmgWindow::max_length) * scale);
+  const float mav = static_cast<int32_t>(128 * EmgWindow::max_length) * scale;
+  for (int c = 0; c < emg_channels; c++)
+  {
+    if (features.rms[c] != rms || features.mav[c] != mav || features.zero_crossings[c] != 0.0f)
+    {
+      fprintf(stderr, "full window of -128: channel %d rms %.9g != %.9g or mav %.9g != %.9g\n", c, features.rms[c],
+              rms, features.mav[c], mav);
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+int main(int argc, char** argv)
+{
+  const std::size_t steps = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> myo(emg_min, emg_max);
+  std::uniform_int_distribution<int> full(-32768, 32767);
+  std::uniform_int_distribution<int> small(-3, 3);
+  const std::size_t lengths[] = { 1, 2, 3, 7, 40, 200 };
+
+  EmgWindow window(lengths[0]);
+  ReferenceWindow reference;
+  reference.resize(lengths[0]);
+  EmgFeatures features, expected;
+  int16_t sample[emg_channels];
+
+  for (std::size_t step = 0; step < steps; step++)
+  {
+    if (step % 5000 == 0)
+    {
+      const std::size_t length = lengths[(step / 5000) % 6];
+      window.resize(length);
+      reference.resize(length);
+    }
+    if (step % 777 == 0)
+      window.threshold = random() % 20;
+
+    // mostly the Myo's range, small values around zero for crossings just at the threshold, and now
+    // and then anything an int16_t holds
+    for (int c = 0; c < emg_channels; c++)
+    {
+      const int kind = (step / 100 + c) % 10;
+      sample[c] = static_cast<int16_t>(kind < 6 ? myo(random) : (kind < 9 ? small(random) : full(random)));
+    }
+    window.push(sample);
+    reference.push(sample, window.threshold);
+
+    window.features(features);
+    reference.features(expected);
+    if (window.size() != reference.entries.size() || !same(features, expected))
+    {
+      printDifference(step, features, expected);
+      return 1;
+    }
+  }
+
+  if (!checkLongest())
+    return 1;
+
+  printf("%lu samples: bit identical to the sums over the window\n", static_cast<unsigned long>(steps));
+  return 0;
+}
@@ -0,0 +1,116 @@
+// messages/s and per message latency of the myo_control_node command logic on synthetic Myo
+// streams of a million poses, no ROS needed.
+#include <benchmark/benchmark.h>
+
+#include <latency_histogram.h>
+#include <myo_control_core.h>
+#include <quaternion_math.h>
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+using prosthesis::LatencyHistogram;
+using prosthesis::MyoControlCore;
+using prosthesis::Quaternion;
+using prosthesis::Vector3;
+
+const std::size_t stream_length = 1 << 20;
+const double pose_period = 0.02;  // the Myo IMU runs at 50 Hz
+
+// a slowly swinging arm with sensor noise, so (almost) every pose changes the command
+const std::vector<Quaternion>& poses()
+{
+  static std::vector<Quaternion> stream;
+  if (stream.empty())
+  {
+    stream.resize(stream_length);
+    for (std::size_t k = 0; k < stream_length; k++)
+    {
+      const double t = k * pose_period;
+      const double noise = 1e-3 * sin(12.9898 * k);
+      stream[k] = prosthesis::fromRPY(0.8 * sin(0.9 * t) + noise, 0.4 * sin(1.1 * t + 1.0) - noise,
+                                      1.2 * sin(0.5 * t + 2.0) + noise);
+    }
+  }
+  return stream;
+}
+
+void BM_Pose(benchmark::State& state)
+{
+  const std::vector<Quaternion>& stream = poses();
+  MyoControlCore core;
+  std::size_t k = 0;
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(core.pose(stream[k]));
+    k = (k + 1) & (stream_length - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Pose);
+
+// what the node sees: poses at 50 Hz, lateral input at 10 Hz integrated on arrival, a gesture every second
+void BM_MixedStream(benchmark::State& state)
+{
+  const std::vector<Quaternion>& stream = poses();
+  MyoControlCore core;
+  std::size_t k = 0;
+  int64_t messages = 0;
+  for (auto _ : state)
+  {
+    const double time = k * pose_period;
+    bool changed = core.pose(stream[k]);
+    messages++;
+    if (k % 5 == 0)
+    {
+      const Vector3 velocity = { 0.5 * sin(0.3 * time), 0.5 * cos(0.3 * time), 0.0 };
+      core.lateralInput(velocity, time);
+      changed |= core.updateLateral(time);
+      messages++;
+    }
+    if (k % 50 == 0)
+    {
+      changed |= core.gesture(k % 100 == 0 ? prosthesis::MYO_FIST : prosthesis::MYO_REST);
+      messages++;
+    }
+    benchmark::DoNotOptimize(changed);
+    k = (k + 1) & (stream_length - 1);
+  }
+  state.SetItemsProcessed(messages);
+}
+BENCHMARK(BM_MixedStream);
+
+// every pose timed on its own, the percentiles include the two clock reads (clock_ns)
+void BM_PoseLatency(benchmark::State& state)
+{
+  typedef std::chrono::steady_clock Clock;
+  const std::vector<Quaternion>& stream = poses();
+  MyoControlCore core;
+  LatencyHistogram latency;
+  LatencyHistogram clock;
+  std::size_t k = 0;
+  for (auto _ : state)
+  {
+    const Clock::time_point start = Clock::now();
+    benchmark::DoNotOptimize(core.pose(stream[k]));
+    const Clock::time_point end = Clock::now();
+    latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+    const Clock::time_point empty = Clock::now();
+    clock.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - empty).count());
+    k = (k + 1) & (stream_length - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["p50_ns"] = latency.percentile(0.5);
+  state.counters["p99_ns"] = latency.percentile(0.99);
+  state.counters["p999_ns"] = latency.percentile(0.999);
+  state.counters["max_ns"] = latency.max();
+  state.counters["clock_ns"] = clock.percentile(0.5);
+}
+BENCHMARK(BM_PoseLatency);
+}
+
+BENCHMARK_MAIN();
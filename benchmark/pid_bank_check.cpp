@@ -0,0 +1,160 @@
+// Checks that PIDBank is bit identical to the per-axis PIDController it replaced, on random gains,
+// inputs and ranges, for whatever SIMD path the build selects (AVX, SSE2 or scalar). Exit code 1 on
+// the first mismatch, no ROS needed.
+//
+// usage: pid_bank_check [steps]
+#include <pid_bank.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+using prosthesis::PIDBank;
+using prosthesis::PIDGains;
+
+// GazeboSimpleController::PIDController as it was before the bank, the reference
+struct PIDController
+{
+  double gain_p;
+  double gain_i;
+  double gain_d;
+  double time_constant;
+  double limit;
+
+  double input;
+  double dinput;
+  double output;
+  double p, i, d;
+
+  double update(double new_input, double x, double dx, double dt)
+  {
+    // limit command
+    if (limit > 0.0 && fabs(new_input) > limit)
+      new_input = (new_input < 0 ? -1.0 : 1.0) * limit;
+
+    // filter command
+    if (dt + time_constant > 0.0)
+    {
+      dinput = (new_input - input) / (dt + time_constant);
+      input = (dt * new_input + time_constant * input) / (dt + time_constant);
+    }
+
+    // update proportional, differential and integral errors
+    p = input - x;
+    d = dinput - dx;
+    i = i + dt * p;
+
+    // update control output
+    output = gain_p * p + gain_d * d + gain_i * i;
+    return output;
+  }
+
+  void reset()
+  {
+    input = dinput = 0;
+    p = i = d = output = 0;
+  }
+};
+
+bool same(double a, double b)
+{
+  return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+bool sameState(const PIDController& reference, const PIDBank& bank, std::size_t k)
+{
+  return same(reference.input, bank.input[k]) && same(reference.dinput, bank.dinput[k]) &&
+         same(reference.output, bank.output[k]) && same(reference.p, bank.p[k]) && same(reference.i, bank.i[k]) &&
+         same(reference.d, bank.d[k]);
+}
+}
+
+int main(int argc, char** argv)
+{
+  const std::size_t steps = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+  const std::size_t loops = 37;  // not a multiple of any vector width, so every path and remainder runs
+
+  std::mt19937_64 random(42);
+  std::uniform_real_distribution<double> value(-10.0, 10.0);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+  std::vector<PIDController> reference(loops);
+  PIDGains gains;
+  gains.resize(loops);
+  PIDBank bank(loops);
+  for (std::size_t k = 0; k < loops; k++)
+  {
+    PIDController& r = reference[k];
+    r.gain_p = value(random);
+    r.gain_i = value(random);
+    r.gain_d = value(random);
+    // zero and positive filter time constants, negative and zero limits disable the limit
+    r.time_constant = k % 3 == 0 ? 0.0 : 0.1 * unit(random);
+    r.limit = k % 4 == 0 ? -1.0 : (k % 4 == 1 ? 0.0 : 5.0 * unit(random));
+    r.reset();
+    gains.set(k, r.gain_p, r.gain_i, r.gain_d, r.time_constant);
+    gains.limit[k] = r.limit;
+  }
+
+  std::vector<double> new_input(loops), x(loops), dx(loops);
+  for (std::size_t step = 0; step < steps; step++)
+  {
+    // a random range of loops, with dt = 0 now and then (no filter update when time_constant is 0 too)
+    std::size_t begin = random() % loops;
+    std::size_t end = begin + random() % (loops - begin + 1);
+    const double dt = step % 97 == 0 ? 0.0 : 0.001 + 0.01 * unit(random);
+    for (std::size_t k = begin; k < end; k++)
+    {
+      new_input[k] = value(random);
+      x[k] = value(random);
+      dx[k] = value(random);
+    }
+
+    if (step % 5 == 0 && begin < end)
+    {
+      // the single loop overload
+      const double output = bank.update(gains, begin, new_input[begin], x[begin], dx[begin], dt);
+      const double expected = reference[begin].update(new_input[begin], x[begin], dx[begin], dt);
+      if (!same(output, expected))
+      {
+        fprintf(stderr, "step %lu: loop %lu output %.17g != %.17g\n", static_cast<unsigned long>(step),
+                static_cast<unsigned long>(begin), output, expected);
+        return 1;
+      }
+      end = begin + 1;
+    }
+    else
+    {
+      bank.update(gains, begin, end, &new_input[begin], &x[begin], &dx[begin], dt);
+      for (std::size_t k = begin; k < end; k++)
+        reference[k].update(new_input[k], x[k], dx[k], dt);
+    }
+
+    if (step % 1000 == 999)
+    {
+      bank.reset(begin, end);
+      for (std::size_t k = begin; k < end; k++)
+        reference[k].reset();
+    }
+
+    for (std::size_t k = 0; k < loops; k++)
+    {
+      if (!sameState(reference[k], bank, k))
+      {
+        fprintf(stderr, "step %lu: loop %lu differs, output %.17g != %.17g, i %.17g != %.17g\n",
+                static_cast<unsigned long>(step), static_cast<unsigned long>(k), bank.output[k],
+                reference[k].output, bank.i[k], reference[k].i);
+        return 1;
+      }
+    }
+  }
+
+  printf("%lu steps of %lu loops: bit identical to PIDController\n", static_cast<unsigned long>(steps),
+         static_cast<unsigned long>(loops));
+  return 0;
+}
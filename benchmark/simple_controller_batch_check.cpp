@@ -0,0 +1,169 @@
+// Checks that SimpleControllerBatch gives every model bit identical outputs to a SimpleControllerCore
+// fed with the same inputs. The batch duplicates the position and velocity cascades of the core,
+// so run this after changing either (exit code 1 on the first mismatch), no ROS needed.
+//
+// usage: simple_controller_batch_check [ticks]
+#include <simple_controller_batch.h>
+#include <simple_controller_core.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+using namespace prosthesis;
+
+const double dt = 0.001;
+
+// model m at tick k: a slow lissajous figure with a swinging orientation, shifted per model
+ControllerInput makeInput(std::size_t k, std::size_t m)
+{
+  const double t = k * dt + 0.37 * m;
+  ControllerInput in = makeControllerInput();
+  in.position.x = 0.1 * sin(1.3 * t);
+  in.position.y = 0.1 * sin(0.7 * t);
+  in.position.z = 1.0 + 0.05 * sin(2.1 * t);
+  in.velocity.x = 0.13 * cos(1.3 * t);
+  in.velocity.y = 0.07 * cos(0.7 * t);
+  in.velocity.z = 0.105 * cos(2.1 * t);
+  in.acceleration.x = -0.169 * sin(1.3 * t);
+  in.acceleration.y = -0.049 * sin(0.7 * t);
+  in.acceleration.z = -0.2205 * sin(2.1 * t);
+  in.euler.x = 0.2 * sin(0.9 * t);
+  in.euler.y = 0.1 * sin(1.1 * t);
+  in.euler.z = 3.0 * sin(0.5 * t);
+  in.orientation = fromRPY(in.euler.x, in.euler.y, in.euler.z);
+  in.angular_velocity.x = 0.18 * cos(0.9 * t);
+  in.angular_velocity.y = 0.11 * cos(1.1 * t);
+  in.angular_velocity.z = 1.5 * cos(0.5 * t);
+  in.angular_acceleration.x = -0.162 * sin(0.9 * t);
+  in.angular_acceleration.y = -0.121 * sin(1.1 * t);
+  in.angular_acceleration.z = -0.75 * sin(0.5 * t);
+  in.gravity.z = -9.81;
+
+  // large commands now and then so the limits and the saturation quirks are hit
+  const double scale = (k / 500) % 4 == 3 ? 40.0 : 1.0;
+  in.position_command_linear.x = scale * 0.2 * sin(0.3 * t);
+  in.position_command_linear.z = 1.0 + scale * 0.1 * cos(0.4 * t);
+  in.position_command_angular.z = 0.5 * sin(0.2 * t);
+  in.velocity_command_linear.x = scale * 0.3 * sin(0.6 * t);
+  in.velocity_command_linear.y = scale * 0.2 * cos(0.8 * t);
+  in.velocity_command_linear.z = scale * 0.1 * sin(0.5 * t);
+  in.velocity_command_angular.z = 0.4 * cos(0.3 * t);
+  return in;
+}
+
+PIDGains makeGains(std::size_t m)
+{
+  PIDGains gains;
+  gains.resize(SimpleControllerCore::CONTROLLER_COUNT);
+  for (int c = 0; c < SimpleControllerCore::CONTROLLER_COUNT; c++)
+  {
+    gains.set(c, 2.0 + 0.5 * c + 0.1 * m, 0.3 + 0.05 * m, 0.5 + 0.1 * c, 0.01 * (c % 3));
+    gains.limit[c] = c % 4 == 0 ? -1.0 : 2.0 + c;
+  }
+  return gains;
+}
+
+bool same(const Vector3& a, const Vector3& b)
+{
+  return memcmp(&a, &b, sizeof(Vector3)) == 0;
+}
+
+// steps models cores and one batch side by side, toggling running, resetting and removing models on the way
+bool check(SimpleControllerCore::Cascade cascade, std::size_t models, double outer_period, std::size_t ticks)
+{
+  std::vector<SimpleControllerCore> cores(models);
+  std::vector<PIDGains> gains(models);
+  std::vector<std::size_t> ids(models);  // model the core stands for, for the inputs after a removal
+  SimpleControllerBatch batch;
+  batch.cascade = cascade;
+  batch.parallel_threshold = 4;
+  batch.outer_schedule.period = outer_period;
+  for (std::size_t m = 0; m < models; m++)
+  {
+    cores[m].setCascade(cascade);
+    cores[m].parameters.mass = 1.2 + 0.1 * m;
+    cores[m].parameters.inertia.x = cores[m].parameters.inertia.y = 0.01;
+    cores[m].parameters.inertia.z = 0.004;
+    cores[m].parameters.max_force = m % 3 == 0 ? -1.0 : 30.0;
+    cores[m].parameters.max_torque = m % 3 == 1 ? -1.0 : 2.0;
+    cores[m].outer_schedule.period = outer_period;
+    gains[m] = makeGains(m);
+    ids[m] = m;
+    batch.addModel();
+    batch.setGains(m, gains[m]);
+    batch.parameters[m] = cores[m].parameters;
+  }
+
+  for (std::size_t k = 0; k < ticks; k++)
+  {
+    if (k == ticks / 2 && cores.size() > 1)
+    {
+      cores.erase(cores.begin() + 1);
+      gains.erase(gains.begin() + 1);
+      ids.erase(ids.begin() + 1);
+      batch.removeModel(1);
+    }
+    if (k % 700 == 350)
+    {
+      cores[0].reset();
+      batch.reset(0);
+    }
+
+    for (std::size_t m = 0; m < cores.size(); m++)
+    {
+      batch.inputs[m] = makeInput(k, ids[m]);
+      batch.running[m] = (k / 200 + ids[m]) % 5 != 0;
+    }
+    batch.update(dt);
+
+    for (std::size_t m = 0; m < cores.size(); m++)
+    {
+      ControllerOutput output;
+      cores[m].update(gains[m], batch.inputs[m], dt, batch.running[m] != 0, output);
+      const ControllerOutput& batched = batch.outputs[m];
+      if (!same(output.force, batched.force) || !same(output.torque, batched.torque) ||
+          !same(output.velocity_command_linear, batched.velocity_command_linear) ||
+          !same(output.velocity_command_angular, batched.velocity_command_angular))
+      {
+        fprintf(stderr,
+                "%s cascade, outer period %g: model %lu differs at tick %lu: force [%.17g %.17g %.17g] != "
+                "[%.17g %.17g %.17g], torque [%.17g %.17g %.17g] != [%.17g %.17g %.17g]\n",
+                cascadeName(cascade), outer_period, static_cast<unsigned long>(ids[m]),
+                static_cast<unsigned long>(k), batched.force.x, batched.force.y, batched.force.z, output.force.x,
+                output.force.y, output.force.z, batched.torque.x, batched.torque.y, batched.torque.z,
+                output.torque.x, output.torque.y, output.torque.z);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+}
+
+int main(int argc, char** argv)
+{
+  const std::size_t ticks = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+
+  const SimpleControllerCore::Cascade cascades[] = { SimpleControllerCore::POSITION_CASCADE,
+                                                     SimpleControllerCore::VELOCITY_CASCADE };
+  const double outer_periods[] = { 0.0, 5 * dt };
+  const std::size_t model_counts[] = { 1, 7, 70 };
+  for (std::size_t c = 0; c < 2; c++)
+  {
+    for (std::size_t p = 0; p < 2; p++)
+    {
+      for (std::size_t n = 0; n < 3; n++)
+      {
+        if (!check(cascades[c], model_counts[n], outer_periods[p], ticks))
+          return 1;
+      }
+      printf("%s cascade, outer period %g: bit identical\n", cascadeName(cascades[c]), outer_periods[p]);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,193 @@
+// ns/tick of the controller core on synthetic trajectories, no gzserver needed.
+#include <benchmark/benchmark.h>
+
+#include <simple_controller_batch.h>
+#include <simple_controller_core.h>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+using prosthesis::ControllerInput;
+using prosthesis::ControllerOutput;
+using prosthesis::PIDGains;
+using prosthesis::SimpleControllerCore;
+
+const double dt = 0.001;
+
+// a slow lissajous figure with a swinging orientation, sampled at 1 kHz
+std::vector<ControllerInput> makeTrajectory(std::size_t ticks)
+{
+  std::vector<ControllerInput> trajectory(ticks);
+  for (std::size_t k = 0; k < ticks; k++)
+  {
+    const double t = k * dt;
+    ControllerInput& in = trajectory[k];
+    in.position.x = 0.1 * sin(1.3 * t);
+    in.position.y = 0.1 * sin(0.7 * t);
+    in.position.z = 1.0 + 0.05 * sin(2.1 * t);
+    in.velocity.x = 0.13 * cos(1.3 * t);
+    in.velocity.y = 0.07 * cos(0.7 * t);
+    in.velocity.z = 0.105 * cos(2.1 * t);
+    in.acceleration.x = -0.169 * sin(1.3 * t);
+    in.acceleration.y = -0.049 * sin(0.7 * t);
+    in.acceleration.z = -0.2205 * sin(2.1 * t);
+    in.euler.x = 0.2 * sin(0.9 * t);
+    in.euler.y = 0.1 * sin(1.1 * t);
+    in.euler.z = 0.3 * sin(0.5 * t);
+    in.angular_velocity.x = 0.18 * cos(0.9 * t);
+    in.angular_velocity.y = 0.11 * cos(1.1 * t);
+    in.angular_velocity.z = 0.15 * cos(0.5 * t);
+    in.angular_acceleration.x = -0.162 * sin(0.9 * t);
+    in.angular_acceleration.y = -0.121 * sin(1.1 * t);
+    in.angular_acceleration.z = -0.075 * sin(0.5 * t);
+
+    // orientation from roll/pitch/yaw (z-y-x)
+    const double cr = cos(in.euler.x / 2), sr = sin(in.euler.x / 2);
+    const double cp = cos(in.euler.y / 2), sp = sin(in.euler.y / 2);
+    const double cy = cos(in.euler.z / 2), sy = sin(in.euler.z / 2);
+    in.orientation.w = cr * cp * cy + sr * sp * sy;
+    in.orientation.x = sr * cp * cy - cr * sp * sy;
+    in.orientation.y = cr * sp * cy + sr * cp * sy;
+    in.orientation.z = cr * cp * sy - sr * sp * cy;
+
+    in.gravity.x = in.gravity.y = 0.0;
+    in.gravity.z = -9.81;
+    in.position_command_linear.x = in.position_command_linear.y = 0.0;
+    in.position_command_linear.z = 1.0;
+    in.position_command_angular.x = in.position_command_angular.y = in.position_command_angular.z = 0.0;
+    in.velocity_command_linear = in.velocity;
+    in.velocity_command_angular = in.angular_velocity;
+  }
+  return trajectory;
+}
+
+PIDGains makeGains()
+{
+  PIDGains gains;
+  gains.resize(SimpleControllerCore::CONTROLLER_COUNT);
+  for (int k = 0; k < SimpleControllerCore::CONTROLLER_COUNT; k++)
+    gains.set(k, 5.0, 0.5, 1.0, 0.01);
+  return gains;
+}
+
+void runCascade(benchmark::State& state, SimpleControllerCore::Cascade cascade, double outer_period = 0.0)
+{
+  const std::vector<ControllerInput> trajectory = makeTrajectory(4096);
+  const PIDGains gains = makeGains();
+  SimpleControllerCore core;
+  core.setCascade(cascade);
+  core.parameters.mass = 1.2;
+  core.parameters.inertia.x = core.parameters.inertia.y = core.parameters.inertia.z = 0.01;
+  core.parameters.max_force = 100.0;
+  core.parameters.max_torque = 10.0;
+  core.outer_schedule.period = outer_period;
+
+  ControllerOutput output;
+  std::size_t k = 0;
+  for (auto _ : state)
+  {
+    core.update(gains, trajectory[k], dt, true, output);
+    benchmark::DoNotOptimize(output);
+    k = (k + 1) & (trajectory.size() - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_PositionCascade(benchmark::State& state)
+{
+  runCascade(state, SimpleControllerCore::POSITION_CASCADE);
+}
+BENCHMARK(BM_PositionCascade);
+
+void BM_VelocityCascade(benchmark::State& state)
+{
+  runCascade(state, SimpleControllerCore::VELOCITY_CASCADE);
+}
+BENCHMARK(BM_VelocityCascade);
+
+void BM_AttitudeCascade(benchmark::State& state)
+{
+  runCascade(state, SimpleControllerCore::ATTITUDE_CASCADE);
+}
+BENCHMARK(BM_AttitudeCascade);
+
+void BM_HoverCascade(benchmark::State& state)
+{
+  runCascade(state, SimpleControllerCore::HOVER_CASCADE);
+}
+BENCHMARK(BM_HoverCascade);
+
+// outer layer at a fifth of the inner rate
+void BM_PositionCascadeOuterDecimated(benchmark::State& state)
+{
+  runCascade(state, SimpleControllerCore::POSITION_CASCADE, 5 * dt);
+}
+BENCHMARK(BM_PositionCascadeOuterDecimated);
+
+// N models stepped together, items are models so the time per item compares to the single cascades above
+void runBatch(benchmark::State& state, SimpleControllerCore::Cascade cascade)
+{
+  const std::size_t models = state.range(0);
+  const std::vector<ControllerInput> trajectory = makeTrajectory(4096);
+  const PIDGains gains = makeGains();
+  prosthesis::SimpleControllerBatch batch;
+  batch.cascade = cascade;
+  for (std::size_t m = 0; m < models; m++)
+  {
+    batch.addModel();
+    batch.setGains(m, gains);
+    batch.parameters[m].mass = 1.2;
+    batch.parameters[m].inertia.x = batch.parameters[m].inertia.y = batch.parameters[m].inertia.z = 0.01;
+    batch.parameters[m].max_force = 100.0;
+    batch.parameters[m].max_torque = 10.0;
+    batch.running[m] = true;
+  }
+
+  std::size_t k = 0;
+  for (auto _ : state)
+  {
+    for (std::size_t m = 0; m < models; m++)
+      batch.inputs[m] = trajectory[(k + 37 * m) & (trajectory.size() - 1)];
+    batch.update(dt);
+    benchmark::DoNotOptimize(batch.outputs.data());
+    k = (k + 1) & (trajectory.size() - 1);
+  }
+  state.SetItemsProcessed(state.iterations() * models);
+}
+
+void BM_BatchPositionCascade(benchmark::State& state)
+{
+  runBatch(state, SimpleControllerCore::POSITION_CASCADE);
+}
+BENCHMARK(BM_BatchPositionCascade)->Arg(1)->Arg(8)->Arg(32)->Arg(128);
+
+void BM_BatchVelocityCascade(benchmark::State& state)
+{
+  runBatch(state, SimpleControllerCore::VELOCITY_CASCADE);
+}
+BENCHMARK(BM_BatchVelocityCascade)->Arg(1)->Arg(8)->Arg(32)->Arg(128);
+
+// one cascade layer of the PID bank for a growing number of loops
+void BM_PIDBankLayer(benchmark::State& state)
+{
+  const std::size_t loops = state.range(0);
+  PIDGains gains;
+  gains.resize(loops);
+  for (std::size_t k = 0; k < loops; k++)
+    gains.set(k, 5.0, 0.5, 1.0, 0.01);
+  prosthesis::PIDBank bank(loops);
+  std::vector<double> input(loops, 1.0), x(loops, 0.5), dx(loops, 0.1);
+
+  for (auto _ : state)
+  {
+    bank.update(gains, 0, loops, input.data(), x.data(), dx.data(), dt);
+    benchmark::DoNotOptimize(bank.output.data());
+  }
+  state.SetItemsProcessed(state.iterations() * loops);
+}
+BENCHMARK(BM_PIDBankLayer)->Arg(6)->Arg(12)->Arg(64)->Arg(1024);
+}
+
+BENCHMARK_MAIN();
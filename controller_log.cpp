@@ -0,0 +1,234 @@
+#include <controller_log.h>
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace prosthesis
+{
+static const char log_magic[8] = { 'P', 'R', 'O', 'S', 'L', 'O', 'G', '\0' };
+static const uint32_t log_version = 2;
+static const std::size_t log_buffer_size = 1 << 20;
+
+//////////////////////////////////////////////////////////////////////////////
+// Writer
+
+ControllerLogWriter::ControllerLogWriter() : file_(NULL), buffer_(NULL)
+{
+}
+
+ControllerLogWriter::~ControllerLogWriter()
+{
+  close();
+}
+
+bool ControllerLogWriter::open(const std::string& path)
+{
+  close();
+  file_ = fopen(path.c_str(), "wb");
+  if (!file_)
+    return false;
+
+  // records are small, a large buffer keeps the writes out of the control tick most of the time
+  buffer_ = new char[log_buffer_size];
+  setvbuf(file_, buffer_, _IOFBF, log_buffer_size);
+
+  LogFileHeader header;
+  memcpy(header.magic, log_magic, sizeof(header.magic));
+  header.version = log_version;
+  header.reserved = 0;
+  fwrite(&header, sizeof(header), 1, file_);
+  return true;
+}
+
+bool ControllerLogWriter::isOpen() const
+{
+  return file_ != NULL;
+}
+
+void ControllerLogWriter::close()
+{
+  if (file_)
+    fclose(file_);
+  file_ = NULL;
+  delete[] buffer_;
+  buffer_ = NULL;
+}
+
+void ControllerLogWriter::write(LogRecordType type, double time, const void* payload, uint32_t size)
+{
+  if (!file_)
+    return;
+  LogRecordHeader header;
+  header.type = type;
+  header.size = size;
+  header.time = time;
+  fwrite(&header, sizeof(header), 1, file_);
+  if (size)
+    fwrite(payload, size, 1, file_);
+}
+
+void ControllerLogWriter::writeGains(double time, const PIDGains& gains)
+{
+  if (!file_)
+    return;
+  const double count = gains.size();
+  const uint32_t bytes = (1 + 5 * gains.size()) * sizeof(double);
+  LogRecordHeader header;
+  header.type = LOG_GAINS;
+  header.size = bytes;
+  header.time = time;
+  fwrite(&header, sizeof(header), 1, file_);
+  fwrite(&count, sizeof(count), 1, file_);
+  fwrite(gains.gain_p.data(), sizeof(double), gains.size(), file_);
+  fwrite(gains.gain_i.data(), sizeof(double), gains.size(), file_);
+  fwrite(gains.gain_d.data(), sizeof(double), gains.size(), file_);
+  fwrite(gains.time_constant.data(), sizeof(double), gains.size(), file_);
+  fwrite(gains.limit.data(), sizeof(double), gains.size(), file_);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Reader
+
+// the payload size a record of this type must have, or -1 if it varies (gains) or the type is unknown
+static long payloadSize(uint32_t type)
+{
+  switch (type)
+  {
+    case LOG_PARAMETERS:
+      return sizeof(LogParameters);
+    case LOG_POSITION_COMMAND:
+    case LOG_VELOCITY_COMMAND:
+      return sizeof(LogCommand);
+    case LOG_IMU:
+      return sizeof(ImuSample);
+    case LOG_STATE:
+      return sizeof(StateSample);
+    case LOG_TICK:
+      return sizeof(LogTick);
+    case LOG_RESET:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+// number of loops of a LOG_GAINS record if it is the loop count of SimpleControllerCore and its size
+// matches it, -1 otherwise
+static long gainCount(const LogRecordHeader* record)
+{
+  if (record->size < sizeof(double) || record->size % sizeof(double) != 0)
+    return -1;
+  const double count = *reinterpret_cast<const double*>(record + 1);
+  const std::size_t doubles = record->size / sizeof(double);
+  // compared as doubles first, so a NaN or huge count is never converted
+  if (count != static_cast<double>(SimpleControllerCore::CONTROLLER_COUNT) ||
+      1 + 5 * static_cast<std::size_t>(SimpleControllerCore::CONTROLLER_COUNT) != doubles)
+    return -1;
+  return static_cast<long>(count);
+}
+
+// the cascade of LOG_PARAMETERS selects a tick by index
+static bool validCascade(double cascade)
+{
+  return cascade >= 0.0 && cascade < SimpleControllerCore::CASCADE_COUNT &&
+         cascade == static_cast<double>(static_cast<int>(cascade));
+}
+
+ControllerLogReader::ControllerLogReader() : data_(NULL), size_(0), offset_(0), corrupt_(false)
+{
+}
+
+ControllerLogReader::~ControllerLogReader()
+{
+  unmap();
+}
+
+void ControllerLogReader::unmap()
+{
+  if (data_)
+    munmap(const_cast<char*>(data_), size_);
+  data_ = NULL;
+  size_ = 0;
+}
+
+bool ControllerLogReader::corrupt() const
+{
+  return corrupt_;
+}
+
+bool ControllerLogReader::open(const std::string& path)
+{
+  unmap();
+  offset_ = 0;
+  corrupt_ = false;
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(LogFileHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  data_ = static_cast<const char*>(data);
+  size_ = st.st_size;
+  const LogFileHeader* header = reinterpret_cast<const LogFileHeader*>(data_);
+  if (memcmp(header->magic, log_magic, sizeof(log_magic)) != 0 || header->version != log_version)
+  {
+    unmap();
+    return false;
+  }
+  offset_ = sizeof(LogFileHeader);
+  return true;
+}
+
+const LogRecordHeader* ControllerLogReader::next()
+{
+  if (offset_ + sizeof(LogRecordHeader) > size_)
+    return NULL;
+  const LogRecordHeader* record = reinterpret_cast<const LogRecordHeader*>(data_ + offset_);
+  // a truncated last record, e.g. from a crashed simulation, ends the log
+  if (offset_ + sizeof(LogRecordHeader) + record->size > size_)
+    return NULL;
+
+  // the readers take the payloads as their structs, a size that does not fit is a corrupt log
+  const long expected = payloadSize(record->type);
+  if ((expected >= 0 && record->size != static_cast<std::size_t>(expected)) ||
+      (record->type == LOG_GAINS && gainCount(record) < 0) ||
+      (record->type == LOG_PARAMETERS && !validCascade(payload<LogParameters>(record).cascade)))
+  {
+    corrupt_ = true;
+    offset_ = size_;
+    return NULL;
+  }
+  offset_ += sizeof(LogRecordHeader) + record->size;
+  return record;
+}
+
+bool ControllerLogReader::readGains(const LogRecordHeader* record, PIDGains& gains)
+{
+  if (record->type != LOG_GAINS || gainCount(record) < 0)
+    return false;
+  const double* data = &payload<double>(record);
+  const std::size_t count = static_cast<std::size_t>(data[0]);
+  gains.resize(count);
+  data++;
+  for (std::size_t k = 0; k < count; k++)
+  {
+    gains.gain_p[k] = data[k];
+    gains.gain_i[k] = data[count + k];
+    gains.gain_d[k] = data[2 * count + k];
+    gains.time_constant[k] = data[3 * count + k];
+    gains.limit[k] = data[4 * count + k];
+  }
+  return true;
+}
+}
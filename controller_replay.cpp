@@ -0,0 +1,177 @@
+// Replays a log recorded by GazeboSimpleController (recordFile) through SimpleControllerCore
+// at full speed and compares every tick's wrench against the recorded one.
+//
+// With --check-allocations the replayed ticks are recorded again (to /dev/null) like the
+// plugin does, and any heap call made by the tick after the given number of warm-up ticks
+// is an error.
+//
+// usage: controller_replay [--check-allocations <warm-up ticks>] <log file> [tolerance]
+#include <allocation_counter.h>
+#include <controller_log.h>
+#include <simple_controller_core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace prosthesis;
+
+static double maxDifference(const Vector3& a, const Vector3& b)
+{
+  return std::max(std::fabs(a.x - b.x), std::max(std::fabs(a.y - b.y), std::fabs(a.z - b.z)));
+}
+
+int main(int argc, char** argv)
+{
+  long warm_up = -1;
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "--check-allocations") == 0)
+  {
+    warm_up = atol(argv[arg + 1]);
+    arg += 2;
+  }
+  if (arg >= argc)
+  {
+    fprintf(stderr, "usage: %s [--check-allocations <warm-up ticks>] <log file> [tolerance]\n", argv[0]);
+    return 2;
+  }
+  const char* path = argv[arg];
+  const double tolerance = arg + 1 < argc ? atof(argv[arg + 1]) : 0.0;
+
+  ControllerLogReader log;
+  if (!log.open(path))
+  {
+    fprintf(stderr, "could not open controller log %s\n", path);
+    return 2;
+  }
+
+  ControllerLogWriter recorder;
+  if (warm_up >= 0 && !recorder.open("/dev/null"))
+  {
+    fprintf(stderr, "could not open /dev/null for recording\n");
+    return 2;
+  }
+  uint64_t allocations = 0;
+
+  // same state as the plugin keeps between two Update() calls
+  SimpleControllerCore core;
+  PIDGains gains;
+  bool has_gains = false;
+  ControllerInput input = makeControllerInput();
+  bool has_imu = false;
+  bool has_state = false;
+
+  unsigned long ticks = 0;
+  unsigned long mismatches = 0;
+  double max_difference = 0.0;
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  const LogRecordHeader* record;
+  while ((record = log.next()) != NULL)
+  {
+    switch (record->type)
+    {
+      case LOG_PARAMETERS:
+      {
+        const LogParameters& parameters = ControllerLogReader::payload<LogParameters>(record);
+        core.parameters = parameters.parameters;
+        core.setCascade(static_cast<SimpleControllerCore::Cascade>(static_cast<int>(parameters.cascade)));
+        has_imu = parameters.has_imu != 0.0;
+        has_state = parameters.has_state != 0.0;
+        core.outer_schedule.period = parameters.outer_period;
+        break;
+      }
+      case LOG_GAINS:
+        has_gains = ControllerLogReader::readGains(record, gains) || has_gains;
+        break;
+      case LOG_POSITION_COMMAND:
+      {
+        const LogCommand& command = ControllerLogReader::payload<LogCommand>(record);
+        input.position_command_linear = command.linear;
+        input.position_command_angular = command.angular;
+        break;
+      }
+      case LOG_VELOCITY_COMMAND:
+      {
+        const LogCommand& command = ControllerLogReader::payload<LogCommand>(record);
+        input.velocity_command_linear = command.linear;
+        input.velocity_command_angular = command.angular;
+        break;
+      }
+      case LOG_IMU:
+        applyImu(ControllerLogReader::payload<ImuSample>(record), input);
+        break;
+      case LOG_STATE:
+        applyState(ControllerLogReader::payload<StateSample>(record), has_imu, input);
+        break;
+      case LOG_RESET:
+        core.reset();
+        resetState(input);
+        break;
+      case LOG_TICK:
+      {
+        // the core indexes the gain table by loop, without one there is nothing to replay with
+        if (!has_gains)
+        {
+          fprintf(stderr, "tick at t = %f before the first gains record, the log is not replayable\n", record->time);
+          return 2;
+        }
+        if (warm_up >= 0 && ticks == static_cast<unsigned long>(warm_up))
+          AllocationCounter::start();
+
+        const LogTick& tick = ControllerLogReader::payload<LogTick>(record);
+        input.gravity = tick.gravity;
+        applyLink(tick.link, has_imu, has_state, tick.dt, input);
+
+        ControllerOutput output;
+        core.update(gains, input, tick.dt, tick.running != 0.0, output);
+        input.velocity_command_linear = output.velocity_command_linear;
+        input.velocity_command_angular = output.velocity_command_angular;
+
+        const double difference =
+            std::max(maxDifference(output.force, tick.force), maxDifference(output.torque, tick.torque));
+        if (!(difference <= tolerance))
+        {
+          if (mismatches == 0)
+            fprintf(stderr,
+                    "first mismatch at t = %f (tick %lu): force [%g %g %g] != [%g %g %g], "
+                    "torque [%g %g %g] != [%g %g %g]\n",
+                    record->time, ticks, output.force.x, output.force.y, output.force.z, tick.force.x,
+                    tick.force.y, tick.force.z, output.torque.x, output.torque.y, output.torque.z, tick.torque.x,
+                    tick.torque.y, tick.torque.z);
+          mismatches++;
+        }
+        if (difference > max_difference)
+          max_difference = difference;
+        if (recorder.isOpen())
+          recorder.write(LOG_TICK, record->time, tick);
+        ticks++;
+        break;
+      }
+      default:
+        fprintf(stderr, "skipping unknown record type %u at t = %f\n", record->type, record->time);
+        break;
+    }
+  }
+  if (warm_up >= 0)
+    allocations = AllocationCounter::stop();
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("ticks: %lu\nmismatches: %lu\nmax difference: %g\nwall time: %f s\nticks/s: %.0f\n", ticks, mismatches,
+         max_difference, seconds, seconds > 0.0 ? ticks / seconds : 0.0);
+  if (warm_up >= 0)
+  {
+    printf("heap calls after %ld warm-up ticks: %lu\n", warm_up, static_cast<unsigned long>(allocations));
+    if (allocations)
+      return 3;
+  }
+  if (log.corrupt())
+  {
+    fprintf(stderr, "corrupt record after %lu ticks, the rest of the log was not replayed\n", ticks);
+    return 2;
+  }
+  return mismatches ? 1 : 0;
+}
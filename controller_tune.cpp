@@ -0,0 +1,213 @@
+// Tunes the PID gains of GazeboSimpleController offline: the controller core runs
+// against a rigid body model of the link through steps on every axis, and a
+// cross-entropy search evaluates thousands of gain sets per generation on all cores.
+// The best set is written as sdf parameters for the plugin element.
+//
+// The starting gains (and their time constants and limits) come from the plugin
+// element of a model sdf or from a log recorded by the plugin (recordFile), which
+// also provides mass, inertia, force limits, cascade and outer update period.
+// Only gains that are positive in the starting set are tuned.
+//
+// usage: controller_tune (--log <file> | --sdf <file> --mass <kg> --inertia <x> <y> <z>)
+//                        [--cascade position|velocity] [--generations n] [--candidates n]
+//                        [--threads n] [--effort-weight w] [--seed s] [--output <file>]
+#include <controller_log.h>
+#include <gain_tuner.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace prosthesis;
+
+static bool readLog(const char* path, ControllerParameters& parameters, SimpleControllerCore::Cascade& cascade,
+                    double& outer_period, PIDGains& gains)
+{
+  ControllerLogReader log;
+  if (!log.open(path))
+    return false;
+
+  bool has_parameters = false;
+  bool has_gains = false;
+  const LogRecordHeader* record;
+  while ((!has_parameters || !has_gains) && (record = log.next()) != NULL)
+  {
+    if (record->type == LOG_PARAMETERS && !has_parameters)
+    {
+      const LogParameters& logged = ControllerLogReader::payload<LogParameters>(record);
+      parameters = logged.parameters;
+      cascade = static_cast<SimpleControllerCore::Cascade>(static_cast<int>(logged.cascade));
+      outer_period = logged.outer_period;
+      has_parameters = true;
+    }
+    else if (record->type == LOG_GAINS && !has_gains)
+    {
+      has_gains = ControllerLogReader::readGains(record, gains);
+    }
+  }
+  return has_parameters && has_gains;
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr,
+          "usage: %s (--log <file> | --sdf <file> --mass <kg> --inertia <x> <y> <z>)\n"
+          "       [--cascade position|velocity] [--generations n] [--candidates n]\n"
+          "       [--threads n] [--effort-weight w] [--seed s] [--output <file>]\n",
+          name);
+}
+
+int main(int argc, char** argv)
+{
+  const char* log_path = NULL;
+  const char* sdf_path = NULL;
+  const char* output_path = NULL;
+  const char* cascade_name = NULL;
+  std::size_t generations = 30;
+  std::size_t threads = 0;
+  double effort_weight = -1.0;
+
+  ControllerParameters parameters;
+  parameters.mass = 0.0;
+  parameters.inertia.x = parameters.inertia.y = parameters.inertia.z = 0.0;
+  parameters.max_force = -1.0;
+  parameters.max_torque = -1.0;
+  SimpleControllerCore::Cascade cascade = SimpleControllerCore::POSITION_CASCADE;
+  double outer_period = 0.0;
+  GainSearchOptions options = makeGainSearchOptions();
+
+  for (int arg = 1; arg < argc; arg++)
+  {
+    const bool has_value = arg + 1 < argc;
+    if (strcmp(argv[arg], "--log") == 0 && has_value)
+      log_path = argv[++arg];
+    else if (strcmp(argv[arg], "--sdf") == 0 && has_value)
+      sdf_path = argv[++arg];
+    else if (strcmp(argv[arg], "--mass") == 0 && has_value)
+      parameters.mass = atof(argv[++arg]);
+    else if (strcmp(argv[arg], "--inertia") == 0 && arg + 3 < argc)
+    {
+      parameters.inertia.x = atof(argv[++arg]);
+      parameters.inertia.y = atof(argv[++arg]);
+      parameters.inertia.z = atof(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "--cascade") == 0 && has_value)
+      cascade_name = argv[++arg];
+    else if (strcmp(argv[arg], "--generations") == 0 && has_value)
+      generations = atol(argv[++arg]);
+    else if (strcmp(argv[arg], "--candidates") == 0 && has_value)
+      options.candidates = atol(argv[++arg]);
+    else if (strcmp(argv[arg], "--threads") == 0 && has_value)
+      threads = atol(argv[++arg]);
+    else if (strcmp(argv[arg], "--effort-weight") == 0 && has_value)
+      effort_weight = atof(argv[++arg]);
+    else if (strcmp(argv[arg], "--seed") == 0 && has_value)
+      options.seed = strtoul(argv[++arg], NULL, 10);
+    else if (strcmp(argv[arg], "--output") == 0 && has_value)
+      output_path = argv[++arg];
+    else
+    {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  PIDGains gains;
+  gains.resize(SimpleControllerCore::CONTROLLER_COUNT);
+  if (log_path)
+  {
+    if (!readLog(log_path, parameters, cascade, outer_period, gains))
+    {
+      fprintf(stderr, "could not read parameters and gains from controller log %s\n", log_path);
+      return 2;
+    }
+  }
+  else if (sdf_path)
+  {
+    std::ifstream file(sdf_path);
+    std::stringstream sdf;
+    sdf << file.rdbuf();
+    if (!file || readSdfGains(sdf.str(), gains) == 0)
+    {
+      fprintf(stderr, "no controller gains found in %s\n", sdf_path);
+      return 2;
+    }
+  }
+  else
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (cascade_name)
+  {
+    if (strcmp(cascade_name, "position") == 0)
+      cascade = SimpleControllerCore::POSITION_CASCADE;
+    else if (strcmp(cascade_name, "velocity") == 0)
+      cascade = SimpleControllerCore::VELOCITY_CASCADE;
+    else
+    {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!(parameters.mass > 0.0 && parameters.inertia.x > 0.0 && parameters.inertia.y > 0.0 &&
+        parameters.inertia.z > 0.0))
+  {
+    fprintf(stderr, "mass and inertia have to be positive\n");
+    return 2;
+  }
+
+  if (cascade != SimpleControllerCore::POSITION_CASCADE && cascade != SimpleControllerCore::VELOCITY_CASCADE)
+  {
+    fprintf(stderr, "the %s cascade cannot be tuned, only position and velocity\n", cascadeName(cascade));
+    return 2;
+  }
+
+  TuningProblem problem = makeStepProblem(cascade, parameters);
+  problem.outer_period = outer_period;
+  if (effort_weight >= 0.0)
+    problem.effort_weight = effort_weight;
+
+  WorkStealingPool pool(threads);
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  GainSearch search(problem, gains, options);
+  if (search.dimensions() == 0)
+  {
+    fprintf(stderr, "no positive gains to tune\n");
+    return 2;
+  }
+  fprintf(stderr, "tuning %lu gains on %lu threads, initial cost %g%s\n",
+          static_cast<unsigned long>(search.dimensions()), static_cast<unsigned long>(pool.size()),
+          search.initialScore().cost, search.initialScore().diverged ? " (diverged)" : "");
+
+  for (std::size_t g = 0; g < generations; g++)
+  {
+    const TuningScore& best = search.step(pool);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "generation %lu: cost %g (tracking %g, effort %g), %.1f s\n",
+            static_cast<unsigned long>(search.generation()), best.cost, best.tracking, best.effort, seconds);
+  }
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const std::size_t evaluations = generations * options.candidates;
+  fprintf(stderr, "%lu evaluations in %.1f s (%.0f/s)\n", static_cast<unsigned long>(evaluations), seconds,
+          seconds > 0.0 ? evaluations / seconds : 0.0);
+
+  FILE* output = output_path ? fopen(output_path, "w") : stdout;
+  if (!output)
+  {
+    fprintf(stderr, "could not open %s\n", output_path);
+    return 2;
+  }
+  fprintf(output, "<!-- controller_tune: cost %g -> %g, %lu generations of %lu candidates -->\n",
+          search.initialScore().cost, search.bestScore().cost, static_cast<unsigned long>(generations),
+          static_cast<unsigned long>(options.candidates));
+  writeSdfGains(output, search.best());
+  if (output != stdout)
+    fclose(output);
+  return 0;
+}
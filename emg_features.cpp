@@ -0,0 +1,258 @@
+#include <emg_features.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace prosthesis
+{
+//////////////////////////////////////////////////////////////////////////////
+// Window
+
+const std::size_t EmgWindow::max_length;
+
+EmgWindow::EmgWindow(std::size_t length) : threshold(2)
+{
+  resize(length);
+}
+
+void EmgWindow::resize(std::size_t length)
+{
+  length_ = length < 1 ? 1 : (length > max_length ? max_length : length);
+  samples_.assign(length_ * emg_channels, 0);
+  crossings_.assign(length_ * emg_channels, 0);
+  head_ = 0;
+  size_ = 0;
+  for (int c = 0; c < emg_channels; c++)
+    sum_square_[c] = sum_abs_[c] = sum_crossings_[c] = previous_[c] = 0;
+}
+
+std::size_t EmgWindow::length() const
+{
+  return length_;
+}
+
+std::size_t EmgWindow::size() const
+{
+  return size_;
+}
+
+#if !defined(__AVX2__) && defined(__SSE2__)
+// 32 bit squares of 8 int16 lanes, lanes 0-3 in low and 4-7 in high
+static inline void squares(__m128i v, __m128i& low, __m128i& high)
+{
+  const __m128i product_low = _mm_mullo_epi16(v, v);
+  const __m128i product_high = _mm_mulhi_epi16(v, v);
+  low = _mm_unpacklo_epi16(product_low, product_high);
+  high = _mm_unpackhi_epi16(product_low, product_high);
+}
+
+static inline __m128i abs32(__m128i v)
+{
+  const __m128i sign = _mm_srai_epi32(v, 31);
+  return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+}
+
+// the running sums of 4 channels, SSE2 has no 32 bit multiply or abs so the squares come in precomputed
+static inline void pushQuarter(const __m128i x, const __m128i square, const __m128i old_square, int32_t* slot,
+                               int32_t* crossing_slot, int32_t* sum_square, int32_t* sum_abs, int32_t* sum_crossings,
+                               int32_t* previous, const __m128i threshold_1)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slot));
+  const __m128i old_crossing = _mm_loadu_si128(reinterpret_cast<const __m128i*>(crossing_slot));
+  const __m128i before = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous));
+
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum_square));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(sum_square), _mm_sub_epi32(_mm_add_epi32(v, square), old_square));
+  v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum_abs));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(sum_abs), _mm_sub_epi32(_mm_add_epi32(v, abs32(x)), abs32(old)));
+
+  const __m128i sign_change = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi32(before, zero), _mm_cmplt_epi32(x, zero)),
+                                           _mm_and_si128(_mm_cmplt_epi32(before, zero), _mm_cmpgt_epi32(x, zero)));
+  const __m128i large = _mm_cmpgt_epi32(abs32(_mm_sub_epi32(x, before)), threshold_1);
+  const __m128i crossing = _mm_srli_epi32(_mm_and_si128(sign_change, large), 31);
+  v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum_crossings));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(sum_crossings),
+                   _mm_sub_epi32(_mm_add_epi32(v, crossing), old_crossing));
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(slot), x);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(crossing_slot), crossing);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(previous), x);
+}
+#endif
+
+void EmgWindow::push(const int16_t* sample)
+{
+  // the slot of the oldest sample, it holds zeros (which add nothing) until the window is full
+  int32_t* slot = &samples_[head_ * emg_channels];
+  int32_t* crossing_slot = &crossings_[head_ * emg_channels];
+
+#if defined(__AVX2__)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m128i x16 = _mm_max_epi16(_mm_min_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sample)),
+                                                    _mm_set1_epi16(emg_max)),
+                                      _mm_set1_epi16(emg_min));
+    const __m256i x = _mm256_cvtepi16_epi32(x16);
+    const __m256i old = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slot));
+    const __m256i old_crossing = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(crossing_slot));
+    const __m256i before = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous_));
+
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum_square_));
+    v = _mm256_sub_epi32(_mm256_add_epi32(v, _mm256_mullo_epi32(x, x)), _mm256_mullo_epi32(old, old));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum_square_), v);
+    v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum_abs_));
+    v = _mm256_sub_epi32(_mm256_add_epi32(v, _mm256_abs_epi32(x)), _mm256_abs_epi32(old));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum_abs_), v);
+
+    // a crossing is a sign change (zero has no sign) with a step of at least threshold
+    const __m256i sign_change =
+        _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi32(before, zero), _mm256_cmpgt_epi32(zero, x)),
+                        _mm256_and_si256(_mm256_cmpgt_epi32(zero, before), _mm256_cmpgt_epi32(x, zero)));
+    const __m256i large = _mm256_cmpgt_epi32(_mm256_abs_epi32(_mm256_sub_epi32(x, before)),
+                                             _mm256_set1_epi32(threshold - 1));
+    const __m256i crossing = _mm256_srli_epi32(_mm256_and_si256(sign_change, large), 31);
+    v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum_crossings_));
+    v = _mm256_sub_epi32(_mm256_add_epi32(v, crossing), old_crossing);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum_crossings_), v);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(slot), x);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(crossing_slot), crossing);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(previous_), x);
+  }
+#elif defined(__SSE2__)
+  {
+    // all 8 channels as int16 for the squares, then two halves of 4 channels as int32
+    const __m128i x16 = _mm_max_epi16(_mm_min_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sample)),
+                                                    _mm_set1_epi16(emg_max)),
+                                      _mm_set1_epi16(emg_min));
+    const __m128i old16 = _mm_packs_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(slot)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(slot + 4)));
+    __m128i square_low, square_high, old_square_low, old_square_high;
+    squares(x16, square_low, square_high);
+    squares(old16, old_square_low, old_square_high);
+    const __m128i x_low = _mm_srai_epi32(_mm_unpacklo_epi16(x16, x16), 16);
+    const __m128i x_high = _mm_srai_epi32(_mm_unpackhi_epi16(x16, x16), 16);
+    const __m128i threshold_1 = _mm_set1_epi32(threshold - 1);
+    pushQuarter(x_low, square_low, old_square_low, slot, crossing_slot, sum_square_, sum_abs_, sum_crossings_,
+                previous_, threshold_1);
+    pushQuarter(x_high, square_high, old_square_high, slot + 4, crossing_slot + 4, sum_square_ + 4, sum_abs_ + 4,
+                sum_crossings_ + 4, previous_ + 4, threshold_1);
+  }
+#else
+  for (int c = 0; c < emg_channels; c++)
+  {
+    const int32_t x = sample[c] < emg_min ? emg_min : (sample[c] > emg_max ? emg_max : sample[c]);
+    const int32_t old = slot[c];
+    const int32_t before = previous_[c];
+    sum_square_[c] += x * x - old * old;
+    sum_abs_[c] += std::abs(x) - std::abs(old);
+    const int32_t crossing = ((before > 0 && x < 0) || (before < 0 && x > 0)) && std::abs(x - before) >= threshold;
+    sum_crossings_[c] += crossing - crossing_slot[c];
+    slot[c] = x;
+    crossing_slot[c] = crossing;
+    previous_[c] = x;
+  }
+#endif
+
+  head_ = head_ + 1 < length_ ? head_ + 1 : 0;
+  if (size_ < length_)
+    size_++;
+}
+
+void EmgWindow::features(EmgFeatures& features) const
+{
+  const float scale = size_ > 0 ? 1.0f / size_ : 0.0f;
+  for (int c = 0; c < emg_channels; c++)
+  {
+    features.rms[c] = std::sqrt(sum_square_[c] * scale);
+    features.mav[c] = sum_abs_[c] * scale;
+    features.zero_crossings[c] = sum_crossings_[c] * scale;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Force map
+
+GripForceMap::GripForceMap()
+  : use_mav(false), rest(5.0), full(60.0), time_constant(0.05), open_force(-30.0), grasp_force(30.0), activation(0.0)
+{
+  for (int c = 0; c < emg_channels; c++)
+    weights[c] = 1.0f;
+}
+
+double GripForceMap::update(const EmgFeatures& features, double dt)
+{
+  const float* feature = use_mav ? features.mav : features.rms;
+  double sum = 0.0, weight = 0.0;
+  for (int c = 0; c < emg_channels; c++)
+  {
+    sum += weights[c] * feature[c];
+    weight += weights[c];
+  }
+  double scaled = weight > 0.0 && full > rest ? (sum / weight - rest) / (full - rest) : 0.0;
+  scaled = scaled < 0.0 ? 0.0 : (scaled > 1.0 ? 1.0 : scaled);
+
+  // first order low pass, the same discretization as the command filter of the PID loops
+  if (time_constant > 0.0)
+    activation = (dt * scaled + time_constant * activation) / (dt + time_constant);
+  else
+    activation = scaled;
+  return open_force + activation * (grasp_force - open_force);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Recordings
+
+bool readEmgRecording(const std::string& path, std::vector<EmgRecordSample>& samples)
+{
+  std::ifstream file(path.c_str());
+  if (!file)
+    return false;
+
+  samples.clear();
+  std::string line;
+  while (std::getline(file, line))
+  {
+    for (std::size_t k = 0; k < line.size(); k++)
+      if (line[k] == ',')
+        line[k] = ' ';
+    std::istringstream fields(line);
+    double values[emg_channels + 1];
+    int count = 0;
+    while (count < emg_channels + 1 && fields >> values[count])
+      count++;
+    if (count < emg_channels)
+      continue;
+    bool finite = true;
+    for (int k = 0; k < count; k++)
+      finite = finite && std::isfinite(values[k]);
+    if (!finite)
+      continue;
+
+    EmgRecordSample sample;
+    const double* channels = values;
+    if (count == emg_channels + 1)
+    {
+      sample.time = values[0];
+      channels = values + 1;
+    }
+    else
+    {
+      sample.time = 0.005 * samples.size();
+    }
+    // clamped as a double, converting an out of range value to int16_t is undefined
+    for (int c = 0; c < emg_channels; c++)
+      sample.channels[c] =
+          static_cast<int16_t>(channels[c] < emg_min ? emg_min : (channels[c] > emg_max ? emg_max : channels[c]));
+    samples.push_back(sample);
+  }
+  return true;
+}
+}
@@ -0,0 +1,160 @@
+// Runs a recorded EMG stream through the feature extraction and grip force map of
+// myo_emg_control_node at full speed, without ROS.
+//
+// The recording (see readEmgRecording: "time c0 .. c7" or "c0 .. c7" per row) is fed to
+// --devices windows at once, like a node serving that many armbands. Prints the throughput
+// and the time per tick (one sample of every device) as percentiles, and with --output the
+// features and force of the first device after every force update as CSV, e.g. to tune
+// rest/full against a recorded session.
+//
+// usage: emg_replay [--devices n] [--window n] [--decimation n] [--threshold n] [--mav]
+//                   [--rest x] [--full x] [--time-constant s] [--repeat n] [--output file] <recording>
+#include <emg_features.h>
+#include <latency_histogram.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace prosthesis;
+
+static void usage(const char* name)
+{
+  fprintf(stderr,
+          "usage: %s [--devices n] [--window n] [--decimation n] [--threshold n] [--mav]\n"
+          "       [--rest x] [--full x] [--time-constant s] [--repeat n] [--output file] <recording>\n",
+          name);
+}
+
+int main(int argc, char** argv)
+{
+  int devices = 1;
+  int window = 40;
+  int decimation = 4;
+  int threshold = 2;
+  int repeat = 1;
+  const char* output_path = NULL;
+  const char* path = NULL;
+  GripForceMap map;
+  // like myo_emg_control_node the samples are taken as 5 ms apart, the time column is only copied to the output
+  const double sample_period = 0.005;
+
+  for (int arg = 1; arg < argc; arg++)
+  {
+    const bool has_value = arg + 1 < argc;
+    if (strcmp(argv[arg], "--devices") == 0 && has_value)
+      devices = atoi(argv[++arg]);
+    else if (strcmp(argv[arg], "--window") == 0 && has_value)
+      window = atoi(argv[++arg]);
+    else if (strcmp(argv[arg], "--decimation") == 0 && has_value)
+      decimation = atoi(argv[++arg]);
+    else if (strcmp(argv[arg], "--threshold") == 0 && has_value)
+      threshold = atoi(argv[++arg]);
+    else if (strcmp(argv[arg], "--mav") == 0)
+      map.use_mav = true;
+    else if (strcmp(argv[arg], "--rest") == 0 && has_value)
+      map.rest = atof(argv[++arg]);
+    else if (strcmp(argv[arg], "--full") == 0 && has_value)
+      map.full = atof(argv[++arg]);
+    else if (strcmp(argv[arg], "--time-constant") == 0 && has_value)
+      map.time_constant = atof(argv[++arg]);
+    else if (strcmp(argv[arg], "--repeat") == 0 && has_value)
+      repeat = atoi(argv[++arg]);
+    else if (strcmp(argv[arg], "--output") == 0 && has_value)
+      output_path = argv[++arg];
+    else if (argv[arg][0] != '-' && !path)
+      path = argv[arg];
+    else
+    {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!path || devices < 1 || window < 1 || decimation < 1 || repeat < 1)
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::vector<EmgRecordSample> samples;
+  if (!readEmgRecording(path, samples) || samples.empty())
+  {
+    fprintf(stderr, "could not read EMG samples from %s\n", path);
+    return 2;
+  }
+
+  FILE* output = NULL;
+  if (output_path)
+  {
+    output = fopen(output_path, "w");
+    if (!output)
+    {
+      fprintf(stderr, "could not open %s\n", output_path);
+      return 2;
+    }
+    fprintf(output, "time,force,activation");
+    for (int c = 0; c < emg_channels; c++)
+      fprintf(output, ",rms%d", c);
+    for (int c = 0; c < emg_channels; c++)
+      fprintf(output, ",mav%d", c);
+    for (int c = 0; c < emg_channels; c++)
+      fprintf(output, ",zc%d", c);
+    fprintf(output, "\n");
+  }
+
+  std::vector<EmgWindow> windows(devices, EmgWindow(window));
+  std::vector<GripForceMap> maps(devices, map);
+  for (int d = 0; d < devices; d++)
+    windows[d].threshold = threshold;
+
+  LatencyHistogram tick_time;
+  EmgFeatures features;
+  double force_sum = 0.0;
+  uint64_t ticks = 0;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < repeat; pass++)
+  {
+    for (std::size_t k = 0; k < samples.size(); k++, ticks++)
+    {
+      const std::chrono::steady_clock::time_point tick_start = std::chrono::steady_clock::now();
+      const bool update = (ticks + 1) % decimation == 0;
+      for (int d = 0; d < devices; d++)
+      {
+        windows[d].push(samples[k].channels);
+        if (!update)
+          continue;
+        windows[d].features(features);
+        const double force = maps[d].update(features, decimation * sample_period);
+        force_sum += force;
+        if (d == 0 && output && pass == 0)
+        {
+          fprintf(output, "%.6f,%.3f,%.4f", samples[k].time, force, maps[d].activation);
+          for (int c = 0; c < emg_channels; c++)
+            fprintf(output, ",%.3f", features.rms[c]);
+          for (int c = 0; c < emg_channels; c++)
+            fprintf(output, ",%.3f", features.mav[c]);
+          for (int c = 0; c < emg_channels; c++)
+            fprintf(output, ",%.4f", features.zero_crossings[c]);
+          fprintf(output, "\n");
+        }
+      }
+      tick_time.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                             tick_start).count());
+    }
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (output)
+    fclose(output);
+
+  // the sum keeps the loop from being optimized away and changes whenever the results do
+  const double device_samples = static_cast<double>(ticks) * devices;
+  printf("samples: %lu\ndevices: %d\nwall time: %f s\nsamples/s: %.0f\n", static_cast<unsigned long>(ticks), devices,
+         seconds, seconds > 0.0 ? device_samples / seconds : 0.0);
+  printf("tick time: p50 %.0f ns, p99 %.0f ns, max %.0f ns\n", static_cast<double>(tick_time.percentile(0.5)),
+         static_cast<double>(tick_time.percentile(0.99)), static_cast<double>(tick_time.max()));
+  printf("200 Hz devices per core: %.0f\nmean force: %.3f\n", seconds > 0.0 ? device_samples / seconds / 200.0 : 0.0,
+         force_sum / (device_samples / decimation));
+  return 0;
+}
@@ -0,0 +1,414 @@
+#include <gain_tuner.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace prosthesis
+{
+typedef SimpleControllerCore Core;
+
+const SdfGainGroup sdf_gain_groups[] = { { "roll_vel", Core::ROLL_VEL, -1 },
+                                         { "pitch_vel", Core::PITCH_VEL, -1 },
+                                         { "yaw_vel", Core::YAW_VEL, -1 },
+                                         { "roll", Core::ROLL, -1 },
+                                         { "pitch", Core::PITCH, -1 },
+                                         { "yaw", Core::YAW, -1 },
+                                         { "velocityXY", Core::VELOCITY_X, Core::VELOCITY_Y },
+                                         { "velocityZ", Core::VELOCITY_Z, -1 },
+                                         { "positionx", Core::POSITION_X, Core::POSITION_Y },
+                                         { "positionz", Core::POSITION_Z, -1 } };
+const std::size_t sdf_gain_group_count = sizeof(sdf_gain_groups) / sizeof(sdf_gain_groups[0]);
+
+static const char* const sdf_gain_suffixes[] = { "ProportionalGain", "IntegralGain", "DifferentialGain",
+                                                 "TimeConstant", "Limit" };
+
+static std::vector<double>& gainTerm(PIDGains& gains, int term)
+{
+  switch (term)
+  {
+    case 0:
+      return gains.gain_p;
+    case 1:
+      return gains.gain_i;
+    case 2:
+      return gains.gain_d;
+    case 3:
+      return gains.time_constant;
+    default:
+      return gains.limit;
+  }
+}
+
+static const std::vector<double>& gainTerm(const PIDGains& gains, int term)
+{
+  return gainTerm(const_cast<PIDGains&>(gains), term);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// sdf
+
+std::size_t readSdfGains(const std::string& sdf, PIDGains& gains)
+{
+  if (gains.size() < Core::CONTROLLER_COUNT)
+    gains.resize(Core::CONTROLLER_COUNT);
+
+  std::size_t found = 0;
+  for (std::size_t g = 0; g < sdf_gain_group_count; g++)
+  {
+    const SdfGainGroup& group = sdf_gain_groups[g];
+    for (int term = 0; term < 5; term++)
+    {
+      const std::string tag = std::string("<") + group.prefix + sdf_gain_suffixes[term] + ">";
+      const std::size_t position = sdf.find(tag);
+      if (position == std::string::npos)
+        continue;
+      const double value = strtod(sdf.c_str() + position + tag.size(), NULL);
+      gainTerm(gains, term)[group.first] = value;
+      if (group.second >= 0)
+        gainTerm(gains, term)[group.second] = value;
+      found++;
+    }
+  }
+  return found;
+}
+
+void writeSdfGains(FILE* file, const PIDGains& gains)
+{
+  for (std::size_t g = 0; g < sdf_gain_group_count; g++)
+  {
+    const SdfGainGroup& group = sdf_gain_groups[g];
+    for (int term = 0; term < 5; term++)
+    {
+      const double value = gainTerm(gains, term)[group.first];
+      fprintf(file, "<%s%s>%.9g</%s%s>\n", group.prefix, sdf_gain_suffixes[term], value, group.prefix,
+              sdf_gain_suffixes[term]);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Problem
+
+static TuningSegment makeSegment(double duration, double x, double y, double z, double roll, double pitch,
+                                 double yaw)
+{
+  TuningSegment segment = { duration, { x, y, z }, { roll, pitch, yaw } };
+  return segment;
+}
+
+TuningProblem makeStepProblem(Core::Cascade cascade, const ControllerParameters& parameters)
+{
+  TuningProblem problem;
+  problem.cascade = cascade;
+  problem.parameters = parameters;
+  problem.outer_period = 0.0;
+  problem.plant.mass = parameters.mass;
+  problem.plant.inertia = parameters.inertia;
+  problem.plant.gravity.x = problem.plant.gravity.y = 0.0;
+  problem.plant.gravity.z = -9.81;
+  problem.plant.linear_damping = 0.0;
+  problem.plant.angular_damping = 0.0;
+  problem.dt = 0.001;
+  problem.start_position.x = problem.start_position.y = 0.0;
+  problem.start_position.z = 1.0;
+  problem.attitude_weight = 1.0;
+  problem.effort_weight = 1e-3;
+  problem.divergence_bound = 10.0;
+
+  std::vector<TuningSegment>& s = problem.segments;
+  if (cascade == Core::POSITION_CASCADE)
+  {
+    // position steps of 20 cm, attitude steps of about 10 and 30 degrees
+    s.push_back(makeSegment(1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(2.0, 0.2, 0.0, 1.0, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(2.0, 0.2, 0.2, 1.0, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(2.0, 0.2, 0.2, 1.2, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(1.5, 0.2, 0.2, 1.2, 0.2, 0.0, 0.0));
+    s.push_back(makeSegment(1.5, 0.2, 0.2, 1.2, 0.2, 0.2, 0.0));
+    s.push_back(makeSegment(2.0, 0.2, 0.2, 1.2, 0.2, 0.2, 0.5));
+    s.push_back(makeSegment(3.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0));
+  }
+  else
+  {
+    // velocity steps of 0.5 m/s and a yaw rate step of 0.5 rad/s
+    s.push_back(makeSegment(1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(2.0, 0.0, 0.0, 0.5, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(2.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(2.0, 0.5, 0.0, 0.0, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(2.0, 0.0, 0.5, 0.0, 0.0, 0.0, 0.0));
+    s.push_back(makeSegment(2.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.5));
+    s.push_back(makeSegment(2.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0));
+  }
+  return problem;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Evaluation
+
+static double wrapAngle(double angle)
+{
+  return std::remainder(angle, 2.0 * M_PI);
+}
+
+TuningScore evaluateGains(const TuningProblem& problem, const PIDGains& gains)
+{
+  Core core;
+  core.setCascade(problem.cascade);
+  core.parameters = problem.parameters;
+  core.outer_schedule.period = problem.outer_period;
+
+  RigidBodyPlant plant(problem.plant);
+  const Quaternion identity = { 1.0, 0.0, 0.0, 0.0 };
+  plant.reset(problem.start_position, identity);
+
+  ControllerInput input = makeControllerInput();
+  input.gravity = problem.plant.gravity;
+  const double gravity = std::sqrt(input.gravity.x * input.gravity.x + input.gravity.y * input.gravity.y +
+                                   input.gravity.z * input.gravity.z);
+
+  const Vector3 inverse_inertia = { problem.plant.inertia.x > 0.0 ? 1.0 / problem.plant.inertia.x : 0.0,
+                                    problem.plant.inertia.y > 0.0 ? 1.0 / problem.plant.inertia.y : 0.0,
+                                    problem.plant.inertia.z > 0.0 ? 1.0 / problem.plant.inertia.z : 0.0 };
+  const double bound = problem.divergence_bound * problem.divergence_bound;
+  const double dt = problem.dt;
+
+  std::size_t total = 0;
+  for (std::size_t s = 0; s < problem.segments.size(); s++)
+    total += static_cast<std::size_t>(problem.segments[s].duration / dt + 0.5);
+
+  TuningScore score = { 0.0, 0.0, 0.0, false };
+  std::size_t ticks = 0;
+  for (std::size_t s = 0; s < problem.segments.size(); s++)
+  {
+    const TuningSegment& segment = problem.segments[s];
+    if (problem.cascade == Core::POSITION_CASCADE)
+    {
+      input.position_command_linear = segment.linear;
+      input.position_command_angular = segment.angular;
+    }
+    else
+    {
+      input.velocity_command_linear = segment.linear;
+      input.velocity_command_angular = segment.angular;
+    }
+
+    const std::size_t end = ticks + static_cast<std::size_t>(segment.duration / dt + 0.5);
+    for (; ticks < end; ticks++)
+    {
+      // the same order as the plugin: read the link, run the core, apply the wrench
+      applyLink(plant.sample(), false, false, dt, input);
+
+      Vector3 linear, angular;
+      if (problem.cascade == Core::POSITION_CASCADE)
+      {
+        linear.x = segment.linear.x - input.position.x;
+        linear.y = segment.linear.y - input.position.y;
+        linear.z = segment.linear.z - input.position.z;
+        angular.x = wrapAngle(segment.angular.x - input.euler.x);
+        angular.y = wrapAngle(segment.angular.y - input.euler.y);
+        angular.z = wrapAngle(segment.angular.z - input.euler.z);
+      }
+      else
+      {
+        // attitude against the commands of the horizontal velocity loops, held from the previous tick
+        linear.x = segment.linear.x - input.velocity.x;
+        linear.y = segment.linear.y - input.velocity.y;
+        linear.z = segment.linear.z - input.velocity.z;
+        angular.x = -core.controllers.output[Core::VELOCITY_Y] / gravity - input.euler.x;
+        angular.y = core.controllers.output[Core::VELOCITY_X] / gravity - input.euler.y;
+        angular.z = segment.angular.z - input.angular_velocity.z;
+      }
+      const double linear_error = linear.x * linear.x + linear.y * linear.y + linear.z * linear.z;
+      const double angular_error = angular.x * angular.x + angular.y * angular.y + angular.z * angular.z;
+      // written so that NaN counts as diverged
+      if (!(linear_error < bound && angular_error < bound))
+      {
+        score.diverged = true;
+        break;
+      }
+
+      ControllerOutput output;
+      core.update(gains, input, dt, true, output);
+      plant.step(output.force, output.torque, dt);
+
+      const Vector3 acceleration = { output.force.x / problem.plant.mass + input.gravity.x,
+                                     output.force.y / problem.plant.mass + input.gravity.y,
+                                     output.force.z / problem.plant.mass + input.gravity.z };
+      const Vector3 angular_acceleration = { output.torque.x * inverse_inertia.x, output.torque.y * inverse_inertia.y,
+                                             output.torque.z * inverse_inertia.z };
+      score.tracking += linear_error + problem.attitude_weight * angular_error;
+      score.effort += acceleration.x * acceleration.x + acceleration.y * acceleration.y +
+                      acceleration.z * acceleration.z + angular_acceleration.x * angular_acceleration.x +
+                      angular_acceleration.y * angular_acceleration.y +
+                      angular_acceleration.z * angular_acceleration.z;
+    }
+    if (score.diverged)
+      break;
+  }
+
+  if (ticks > 0)
+  {
+    score.tracking /= ticks;
+    score.effort /= ticks;
+  }
+  if (score.diverged)
+    score.cost = divergence_cost * (2.0 - static_cast<double>(ticks) / total);
+  else
+    score.cost = score.tracking + problem.effort_weight * score.effort;
+  return score;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Search
+
+GainSearchOptions makeGainSearchOptions()
+{
+  GainSearchOptions options;
+  options.candidates = 2000;
+  options.elite_fraction = 0.05;
+  options.range = 100.0;
+  options.smoothing = 0.7;
+  options.seed = 1;
+  return options;
+}
+
+static bool usesLoop(Core::Cascade cascade, int controller)
+{
+  if (cascade == Core::POSITION_CASCADE)
+    return true;
+  return controller == Core::VELOCITY_X || controller == Core::VELOCITY_Y || controller == Core::VELOCITY_Z ||
+         controller == Core::ROLL || controller == Core::PITCH || controller == Core::YAW;
+}
+
+GainSearch::GainSearch(const TuningProblem& problem, const PIDGains& initial, const GainSearchOptions& options)
+  : problem_(problem), options_(options), random_(options.seed), generation_(0), best_(initial)
+{
+  for (std::size_t g = 0; g < sdf_gain_group_count; g++)
+  {
+    const SdfGainGroup& group = sdf_gain_groups[g];
+    if (!usesLoop(problem.cascade, group.first))
+      continue;
+    for (int term = 0; term < 3; term++)
+    {
+      const double gain = gainTerm(best_, term)[group.first];
+      if (!(gain > 0.0))
+        continue;
+      Dimension dimension = { static_cast<int>(g), term, std::log(gain), std::log(gain),
+                              std::log(options.range) / 3.0 };
+      dimensions_.push_back(dimension);
+    }
+  }
+
+  initial_score_ = evaluateGains(problem_, best_);
+  best_score_ = initial_score_;
+
+  samples_.resize(options_.candidates * dimensions_.size());
+  candidates_.resize(options_.candidates, initial);
+  scores_.resize(options_.candidates);
+}
+
+std::size_t GainSearch::dimensions() const
+{
+  return dimensions_.size();
+}
+
+std::size_t GainSearch::generation() const
+{
+  return generation_;
+}
+
+const TuningScore& GainSearch::initialScore() const
+{
+  return initial_score_;
+}
+
+const TuningScore& GainSearch::bestScore() const
+{
+  return best_score_;
+}
+
+const PIDGains& GainSearch::best() const
+{
+  return best_;
+}
+
+void GainSearch::apply(const double* x, PIDGains& gains) const
+{
+  for (std::size_t j = 0; j < dimensions_.size(); j++)
+  {
+    const SdfGainGroup& group = sdf_gain_groups[dimensions_[j].group];
+    std::vector<double>& term = gainTerm(gains, dimensions_[j].term);
+    term[group.first] = std::exp(x[j]);
+    if (group.second >= 0)
+      term[group.second] = term[group.first];
+  }
+}
+
+const TuningScore& GainSearch::step(WorkStealingPool& pool)
+{
+  const std::size_t n = options_.candidates;
+  const std::size_t m = dimensions_.size();
+  if (n == 0 || m == 0)
+    return best_score_;
+
+  // candidate 0 is the current mean, the others are drawn around it within the search range
+  const double range = std::log(options_.range);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  for (std::size_t c = 0; c < n; c++)
+  {
+    double* x = &samples_[c * m];
+    for (std::size_t j = 0; j < m; j++)
+    {
+      const Dimension& d = dimensions_[j];
+      const double value = c == 0 ? d.mean : d.mean + d.deviation * normal(random_);
+      x[j] = std::min(std::max(value, d.initial - range), d.initial + range);
+    }
+    apply(x, candidates_[c]);
+  }
+
+  // runs that diverge end early, the pool balances the uneven chunks by stealing
+  pool.parallelFor(n, 8, [this](std::size_t begin, std::size_t end) {
+    for (std::size_t c = begin; c < end; c++)
+      scores_[c] = evaluateGains(problem_, candidates_[c]);
+  });
+
+  std::vector<std::size_t> order(n);
+  for (std::size_t c = 0; c < n; c++)
+    order[c] = c;
+  const std::size_t elite = std::max<std::size_t>(2, static_cast<std::size_t>(options_.elite_fraction * n));
+  const std::size_t count = std::min(elite, n);
+  std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                    [this](std::size_t a, std::size_t b) { return scores_[a].cost < scores_[b].cost; });
+
+  if (scores_[order[0]].cost < best_score_.cost)
+  {
+    best_score_ = scores_[order[0]];
+    best_ = candidates_[order[0]];
+  }
+
+  // refit to the elite
+  const double a = options_.smoothing;
+  for (std::size_t j = 0; j < m; j++)
+  {
+    double mean = 0.0;
+    for (std::size_t k = 0; k < count; k++)
+      mean += samples_[order[k] * m + j];
+    mean /= count;
+    double variance = 0.0;
+    for (std::size_t k = 0; k < count; k++)
+    {
+      const double difference = samples_[order[k] * m + j] - mean;
+      variance += difference * difference;
+    }
+    variance /= count;
+
+    Dimension& d = dimensions_[j];
+    d.mean = a * mean + (1.0 - a) * d.mean;
+    d.deviation = a * std::sqrt(variance) + (1.0 - a) * d.deviation;
+  }
+
+  generation_++;
+  return best_score_;
+}
+}
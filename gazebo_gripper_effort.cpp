@@ -0,0 +1,124 @@
+#include <gazebo_gripper_effort.h>
+#include <gazebo/common/Events.hh>
+#include <gazebo/physics/physics.hh>
+
+#include <sstream>
+
+namespace gazebo
+{
+GazeboGripperEffort::GazeboGripperEffort() : node_handle_(NULL), effort_(0.0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Destructor
+GazeboGripperEffort::~GazeboGripperEffort()
+{
+#if (GAZEBO_MAJOR_VERSION < 8)
+  event::Events::DisconnectWorldUpdateBegin(updateConnection);
+#endif
+  updateConnection.reset();
+
+  if (node_handle_)
+  {
+    node_handle_->shutdown();
+    delete node_handle_;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Load the plugin
+void GazeboGripperEffort::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
+{
+  // default parameters, same joints gripper_forces used to address via /gazebo/apply_joint_effort
+  namespace_.clear();
+  force_topic_ = "/gripperforce";
+  joint_names_ = "gripper1_gripper2 gripperpart1_gripperpart2 gripperpart2_gripperpart_3";
+
+  // load parameters from sdf
+  if (_sdf->HasElement("robotNamespace"))
+    namespace_ = _sdf->GetElement("robotNamespace")->Get<std::string>();
+  if (_sdf->HasElement("topicName"))
+    force_topic_ = _sdf->GetElement("topicName")->Get<std::string>();
+  if (_sdf->HasElement("jointNames"))
+    joint_names_ = _sdf->GetElement("jointNames")->Get<std::string>();
+
+  // resolve the whitespace separated joint list once, Update() only touches the pointers
+  std::istringstream names(joint_names_);
+  std::string name;
+  while (names >> name)
+  {
+    physics::JointPtr joint = _model->GetJoint(name);
+    if (!joint)
+    {
+      ROS_FATAL("gazebo plugin error: jointName: %s does not exist\n", name.c_str());
+      return;
+    }
+    joints_.push_back(joint);
+  }
+
+  // Make sure the ROS node for Gazebo has already been initialized
+  if (!ros::isInitialized())
+  {
+    ROS_FATAL_STREAM("A ROS node for Gazebo has not been initialized, unable to load plugin. "
+                     << "Load the Gazebo system plugin 'libgazebo_ros_api_plugin.so' in the gazebo_ros package)");
+    return;
+  }
+
+  node_handle_ = new ros::NodeHandle(namespace_);
+  ros::NodeHandle param_handle(*node_handle_, "gripper");
+
+  // subscribe force command
+  param_handle.getParam("force_topic", force_topic_);
+  if (!force_topic_.empty())
+  {
+    ros::SubscribeOptions ops = ros::SubscribeOptions::create<std_msgs::Int16>(
+        force_topic_, 10, boost::bind(&GazeboGripperEffort::ForceCallback, this, _1), ros::VoidPtr(),
+        &callback_queue_);
+    force_subscriber_ = node_handle_->subscribe(ops);
+
+    ROS_INFO_NAMED("gripper_effort", "Applying effort from topic %s to %lu gripper joints.", force_topic_.c_str(),
+                   joints_.size());
+  }
+
+  Reset();
+
+  // Listen to the update event. This event is broadcast every
+  // simulation iteration.
+  updateConnection = event::Events::ConnectWorldUpdateBegin(boost::bind(&GazeboGripperEffort::Update, this));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Callbacks
+
+void GazeboGripperEffort::ForceCallback(const std_msgs::Int16ConstPtr &force)
+{
+  effort_ = force->data;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Update the plugin
+void GazeboGripperEffort::Update()
+{
+  // Get new commands
+  callback_queue_.callAvailable();
+
+  // joint forces are cleared by the physics engine after every step, so the effort
+  // is re-applied here instead of keeping a clear/apply pair of service calls around
+  for (size_t i = 0; i < joints_.size(); i++)
+  {
+    joints_[i]->SetForce(0, effort_);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Reset the plugin
+void GazeboGripperEffort::Reset()
+{
+  effort_ = 0.0;
+}
+
+// Register this plugin with the simulator
+GZ_REGISTER_MODEL_PLUGIN(GazeboGripperEffort)
+
+}  // namespace gazebo
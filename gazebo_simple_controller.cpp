@@ -1,13 +1,71 @@
 #include <gazebo_simple_controller.h>
+#include <gazebo_simple_controller_manager.h>
 #include <gazebo/common/Events.hh>
 #include <gazebo/physics/physics.hh>
 
 #include <geometry_msgs/Wrench.h>
+#include <trace_buffer.h>
 #include <cmath>
 
 namespace gazebo
 {
+typedef prosthesis::SimpleControllerCore Core;
+
+// names of the PID loops in the gain service, indexed by prosthesis::SimpleControllerCore::Controller
+static const char *const controller_names[] = { "position_x", "position_y", "position_z", "roll",
+                                                "pitch",      "yaw",        "velocity_x", "velocity_y",
+                                                "velocity_z", "roll_vel",   "pitch_vel",  "yaw_vel" };
+
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+// names of the timed phases in the profile, indexed by GazeboSimpleController::ProfilePhase
+static const char *const profile_names[] = { "update",      "read_inputs",  "prepare_tick", "cascade",
+                                             "finish_tick", "apply_wrench", "callbacks",    "publish" };
+#endif
+
+#if (GAZEBO_MAJOR_VERSION >= 8)
+static prosthesis::Vector3 toCore(const ignition::math::Vector3d &v)
+{
+  prosthesis::Vector3 r = { v.X(), v.Y(), v.Z() };
+  return r;
+}
+
+static prosthesis::Quaternion toCore(const ignition::math::Quaterniond &q)
+{
+  prosthesis::Quaternion r = { q.W(), q.X(), q.Y(), q.Z() };
+  return r;
+}
+#else
+static prosthesis::Vector3 toCore(const math::Vector3 &v)
+{
+  prosthesis::Vector3 r = { v.x, v.y, v.z };
+  return r;
+}
+
+static prosthesis::Quaternion toCore(const math::Quaternion &q)
+{
+  prosthesis::Quaternion r = { q.w, q.x, q.y, q.z };
+  return r;
+}
+#endif
+
+static prosthesis::Vector3 toCore(const geometry_msgs::Vector3 &v)
+{
+  prosthesis::Vector3 r = { v.x, v.y, v.z };
+  return r;
+}
+
+static void logCommand(prosthesis::ControllerLogWriter &log, prosthesis::LogRecordType type, double time,
+                       const prosthesis::Vector3 &linear, const prosthesis::Vector3 &angular)
+{
+  prosthesis::LogCommand command;
+  command.linear = linear;
+  command.angular = angular;
+  log.write(type, time, command);
+}
+
 GazeboSimpleController::GazeboSimpleController()
+  : node_handle_(NULL), telemetry_dropped_(0), owns_trace_(false), applied_trace_(0), wrench_trace_(0), running_(false),
+    auto_engaged_(false), tick_running_(false)
 {
 }
 
@@ -15,13 +73,29 @@ GazeboSimpleController::GazeboSimpleController()
 // Destructor
 GazeboSimpleController::~GazeboSimpleController()
 {
+  // the manager must not step this instance anymore before anything is torn down
+  if (manager_)
+    manager_->Unregister(this);
+
 #if (GAZEBO_MAJOR_VERSION < 8)
   event::Events::DisconnectWorldUpdateBegin(updateConnection);
 #endif
   updateConnection.reset();
 
-  node_handle_->shutdown();
-  delete node_handle_;
+  if (node_handle_)
+  {
+    node_handle_->shutdown();
+    callback_queue_.clear();
+    callback_queue_.disable();
+    if (callback_queue_thread_.joinable())
+      callback_queue_thread_.join();
+    if (telemetry_thread_.joinable())
+      telemetry_thread_.join();
+    delete node_handle_;
+  }
+
+  if (owns_trace_)
+    prosthesis::closeTrace();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -36,15 +110,28 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   namespace_.clear();
   velocity_topic_ = "cmd_vel";
   position_topic_ = "cmd_pos";
-  reconfigure_topic_ = "reconfigure_node";
+  gains_service_ = "set_gains";
   link_velocity_topic_ = "link_velocity_topic";
   desired_velocity_topic_ = "desired_velocity_topic";
   imu_topic_.clear();
   state_topic_.clear();
   wrench_topic_ = "wrench_out";
+  telemetry_topic_ = "telemetry";
+  telemetry_decimation_ = 1;
+  telemetry_buffer_size_ = 1024;
   max_force_ = -1;
   max_torque_ = -1;
+  outer_update_period_ = 0.0;
   auto_engage_ = true;
+  batched_ = false;
+  record_file_.clear();
+  shared_command_name_.clear();
+  shared_command_timeout_ = 0.5;
+  shared_command_stamp_ = 0.0;
+  trace_file_.clear();
+  traced_position_topic_ = "cmd_pos_traced";
+  setpoint_predictor_.horizon = 0.0;
+  setpoint_predictor_.max_interval = 0.5;
 
   // load parameters from sdf
   if (_sdf->HasElement("robotNamespace"))
@@ -59,12 +146,41 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
     state_topic_ = _sdf->GetElement("stateTopic")->Get<std::string>();
   if (_sdf->HasElement("wrenchTopic"))
     wrench_topic_ = _sdf->GetElement("wrenchTopic")->Get<std::string>();
+  if (_sdf->HasElement("telemetryTopic"))
+    telemetry_topic_ = _sdf->GetElement("telemetryTopic")->Get<std::string>();
+  if (_sdf->HasElement("telemetryDecimation"))
+    telemetry_decimation_ = _sdf->GetElement("telemetryDecimation")->Get<int>();
+  if (_sdf->HasElement("telemetryBufferSize"))
+    telemetry_buffer_size_ = _sdf->GetElement("telemetryBufferSize")->Get<int>();
   if (_sdf->HasElement("maxForce"))
     max_force_ = _sdf->GetElement("maxForce")->Get<double>();
   if (_sdf->HasElement("maxTorque"))
     max_torque_ = _sdf->GetElement("maxTorque")->Get<double>();
+  if (_sdf->HasElement("outerUpdateRate"))
+  {
+    double outer_update_rate = _sdf->GetElement("outerUpdateRate")->Get<double>();
+    outer_update_period_ = outer_update_rate > 0.0 ? 1.0 / outer_update_rate : 0.0;
+  }
+  if (_sdf->HasElement("outerUpdatePeriod"))
+    outer_update_period_ = _sdf->GetElement("outerUpdatePeriod")->Get<double>();
   if (_sdf->HasElement("autoEngage"))
     auto_engage_ = _sdf->GetElement("autoEngage")->Get<bool>();
+  if (_sdf->HasElement("batched"))
+    batched_ = _sdf->GetElement("batched")->Get<bool>();
+  if (_sdf->HasElement("recordFile"))
+    record_file_ = _sdf->GetElement("recordFile")->Get<std::string>();
+  if (_sdf->HasElement("sharedCommand"))
+    shared_command_name_ = _sdf->GetElement("sharedCommand")->Get<std::string>();
+  if (_sdf->HasElement("sharedCommandTimeout"))
+    shared_command_timeout_ = _sdf->GetElement("sharedCommandTimeout")->Get<double>();
+  if (_sdf->HasElement("traceFile"))
+    trace_file_ = _sdf->GetElement("traceFile")->Get<std::string>();
+  if (_sdf->HasElement("tracedPositionTopic"))
+    traced_position_topic_ = _sdf->GetElement("tracedPositionTopic")->Get<std::string>();
+  if (_sdf->HasElement("setpointHorizon"))
+    setpoint_predictor_.horizon = _sdf->GetElement("setpointHorizon")->Get<double>();
+  if (_sdf->HasElement("setpointMaxInterval"))
+    setpoint_predictor_.max_interval = _sdf->GetElement("setpointMaxInterval")->Get<double>();
 
   if (_sdf->HasElement("bodyName") && _sdf->GetElement("bodyName")->GetValue())
   {
@@ -79,27 +195,39 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   }
 
   // configure controllers
-  controllers_.roll_vel.Load(_sdf, "roll_vel");
-  controllers_.pitch_vel.Load(_sdf, "pitch_vel");
-  controllers_.yaw_vel.Load(_sdf, "yaw_vel");
-  controllers_.roll.Load(_sdf, "roll");
-  controllers_.pitch.Load(_sdf, "pitch");
-  controllers_.yaw.Load(_sdf, "yaw");
-  controllers_.velocity_x.Load(_sdf, "velocityXY");
-  controllers_.velocity_y.Load(_sdf, "velocityXY");
-  controllers_.velocity_z.Load(_sdf, "velocityZ");
-  controllers_.position_x.Load(_sdf, "positionx");
-  controllers_.position_y.Load(_sdf, "positionx");
-  controllers_.position_z.Load(_sdf, "positionz");
+  shadow_gains_.resize(Core::CONTROLLER_COUNT);
+  LoadController(_sdf, Core::ROLL_VEL, "roll_vel");
+  LoadController(_sdf, Core::PITCH_VEL, "pitch_vel");
+  LoadController(_sdf, Core::YAW_VEL, "yaw_vel");
+  LoadController(_sdf, Core::ROLL, "roll");
+  LoadController(_sdf, Core::PITCH, "pitch");
+  LoadController(_sdf, Core::YAW, "yaw");
+  LoadController(_sdf, Core::VELOCITY_X, "velocityXY");
+  LoadController(_sdf, Core::VELOCITY_Y, "velocityXY");
+  LoadController(_sdf, Core::VELOCITY_Z, "velocityZ");
+  LoadController(_sdf, Core::POSITION_X, "positionx");
+  LoadController(_sdf, Core::POSITION_Y, "positionx");
+  LoadController(_sdf, Core::POSITION_Z, "positionz");
+  gains_mailbox_.write(shadow_gains_);
+  gains_mailbox_.update();
 
 // Get inertia and mass of body
 #if (GAZEBO_MAJOR_VERSION >= 8)
-  inertia = link->GetInertial()->PrincipalMoments();
-  mass = link->GetInertial()->Mass();
+  std::string cascade = prosthesis::cascadeName(Core::VELOCITY_CASCADE);
+  core_.parameters.inertia = toCore(link->GetInertial()->PrincipalMoments());
+  core_.parameters.mass = link->GetInertial()->Mass();
 #else
-  inertia = link->GetInertial()->GetPrincipalMoments();
-  mass = link->GetInertial()->GetMass();
+  std::string cascade = prosthesis::cascadeName(Core::POSITION_CASCADE);
+  core_.parameters.inertia = toCore(link->GetInertial()->GetPrincipalMoments());
+  core_.parameters.mass = link->GetInertial()->GetMass();
 #endif
+  if (_sdf->HasElement("cascade"))
+    cascade = _sdf->GetElement("cascade")->Get<std::string>();
+  core_.parameters.max_force = max_force_;
+  core_.parameters.max_torque = max_torque_;
+  // the inner layer runs at the rate of controlTimer, the outer one at its own (slower) rate
+  core_.outer_schedule.period = outer_update_period_;
+  input_ = prosthesis::makeControllerInput();
 
   // Make sure the ROS node for Gazebo has already been initialized
   if (!ros::isInitialized())
@@ -112,13 +240,39 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   node_handle_ = new ros::NodeHandle(namespace_);
   ros::NodeHandle param_handle(*node_handle_, "controller");
 
+  param_handle.getParam("outer_update_period", outer_update_period_);
+  core_.outer_schedule.period = outer_update_period_;
+
+  // the cascade topology is chosen once here, every tick then runs the code compiled for it
+  param_handle.getParam("cascade", cascade);
+  Core::Cascade selected_cascade;
+  if (!prosthesis::cascadeFromName(cascade, selected_cascade))
+  {
+    ROS_FATAL_NAMED("simple_controller", "Unknown cascade %s, use position, velocity, attitude or hover.",
+                    cascade.c_str());
+    return;
+  }
+  core_.setCascade(selected_cascade);
+
+  // batched instances share the callback queue, threads and world update of their world's controller manager
+  param_handle.getParam("batched", batched_);
+  if (batched_ && selected_cascade != Core::POSITION_CASCADE && selected_cascade != Core::VELOCITY_CASCADE)
+  {
+    ROS_WARN_NAMED("simple_controller",
+                   "Only the position and velocity cascades can be batched, stepping the %s cascade of %s alone.",
+                   cascade.c_str(), link_name_.c_str());
+    batched_ = false;
+  }
+  if (batched_)
+    manager_ = SimpleControllerManager::Get(world, selected_cascade);
+  ros::CallbackQueue *queue = manager_ ? manager_->GetCallbackQueue() : &callback_queue_;
+
   // subscribe command
   param_handle.getParam("velocity_topic", velocity_topic_);
   if (!velocity_topic_.empty())
   {
     ros::SubscribeOptions ops = ros::SubscribeOptions::create<geometry_msgs::Twist>(
-        velocity_topic_, 1, boost::bind(&GazeboSimpleController::VelocityCallback, this, _1), ros::VoidPtr(),
-        &callback_queue_);
+        velocity_topic_, 1, boost::bind(&GazeboSimpleController::VelocityCallback, this, _1), ros::VoidPtr(), queue);
     velocity_subscriber_ = node_handle_->subscribe(ops);
   }
 
@@ -127,17 +281,53 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   if (!position_topic_.empty())
   {
     ros::SubscribeOptions ops = ros::SubscribeOptions::create<geometry_msgs::Twist>(
-        position_topic_, 1, boost::bind(&GazeboSimpleController::PositionCallback, this, _1), ros::VoidPtr(),
-        &callback_queue_);
+        position_topic_, 1, boost::bind(&GazeboSimpleController::PositionCallback, this, _1), ros::VoidPtr(), queue);
     position_subscriber_ = node_handle_->subscribe(ops);
   }
 
+  // trace the stages of the commands published with their trace by myo_control_node (trace_file there),
+  // they replace the plain position commands while they arrive
+  param_handle.getParam("trace_file", trace_file_);
+  param_handle.getParam("traced_position_topic", traced_position_topic_);
+  if (!trace_file_.empty())
+  {
+    owns_trace_ = prosthesis::openTrace(trace_file_, "gazebo " + node_handle_->getNamespace());
+    if (owns_trace_)
+      ROS_INFO_NAMED("simple_controller", "Tracing command stages to %s.", trace_file_.c_str());
+    else if (!prosthesis::traceEnabled())
+      ROS_ERROR_NAMED("simple_controller", "Could not open trace file %s.", trace_file_.c_str());
+
+    ros::SubscribeOptions ops = ros::SubscribeOptions::create<prosthesis_v7::TracedTwist>(
+        traced_position_topic_, 1, boost::bind(&GazeboSimpleController::TracedPositionCallback, this, _1),
+        ros::VoidPtr(), queue);
+    traced_position_subscriber_ = node_handle_->subscribe(ops);
+  }
+
+  // position commands through shared memory, the topic stays as the fallback
+  param_handle.getParam("shared_command", shared_command_name_);
+  param_handle.getParam("shared_command_timeout", shared_command_timeout_);
+  if (!shared_command_name_.empty())
+  {
+    if (shared_command_.open(shared_command_name_))
+      ROS_INFO_NAMED("simple_controller", "Reading position commands from shared memory %s.",
+                     shared_command_name_.c_str());
+    else
+      ROS_ERROR_NAMED("simple_controller", "Could not open shared memory %s.", shared_command_name_.c_str());
+  }
+
+  // orientation setpoints predicted between the position commands, at most setpoint_horizon seconds ahead
+  param_handle.getParam("setpoint_horizon", setpoint_predictor_.horizon);
+  param_handle.getParam("setpoint_max_interval", setpoint_predictor_.max_interval);
+  if (setpoint_predictor_.horizon > 0.0)
+    ROS_INFO_NAMED("simple_controller", "Predicting orientation setpoints up to %.3f s ahead.",
+                   setpoint_predictor_.horizon);
+
   // subscribe imu
   param_handle.getParam("imu_topic", imu_topic_);
   if (!imu_topic_.empty())
   {
     ros::SubscribeOptions ops = ros::SubscribeOptions::create<sensor_msgs::Imu>(
-        imu_topic_, 1, boost::bind(&GazeboSimpleController::ImuCallback, this, _1), ros::VoidPtr(), &callback_queue_);
+        imu_topic_, 1, boost::bind(&GazeboSimpleController::ImuCallback, this, _1), ros::VoidPtr(), queue);
     imu_subscriber_ = node_handle_->subscribe(ops);
 
     ROS_INFO_NAMED("simple_controller",
@@ -150,33 +340,20 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   if (!state_topic_.empty())
   {
     ros::SubscribeOptions ops = ros::SubscribeOptions::create<nav_msgs::Odometry>(
-        state_topic_, 1, boost::bind(&GazeboSimpleController::StateCallback, this, _1), ros::VoidPtr(),
-        &callback_queue_);
+        state_topic_, 1, boost::bind(&GazeboSimpleController::StateCallback, this, _1), ros::VoidPtr(), queue);
     state_subscriber_ = node_handle_->subscribe(ops);
 
     ROS_INFO_NAMED("simple_controller", "Using state information on topic %s as source of state information.",
                    state_topic_.c_str());
   }
 
-  // subscribe reconfigure_node
-  param_handle.getParam("reconfigure_topic", reconfigure_topic_);
-  if (!reconfigure_topic_.empty())
-  {
-    ros::SubscribeOptions ops = ros::SubscribeOptions::create<geometry_msgs::Twist>(
-        reconfigure_topic_, 1, boost::bind(&GazeboSimpleController::ControllerCallback, this, _1), ros::VoidPtr(),
-        &callback_queue_);
-    _reconfigure_subscriber = node_handle_->subscribe(ops);
-
-    ROS_INFO_NAMED("simple_controller", "Using %s as source for reconfigure information", state_topic_.c_str());
-  }
-
   // advertise wrench
   param_handle.getParam("wrench_topic", wrench_topic_);
   if (!wrench_topic_.empty())
   {
     ros::AdvertiseOptions ops = ros::AdvertiseOptions::create<geometry_msgs::Wrench>(
         wrench_topic_, 10, ros::SubscriberStatusCallback(), ros::SubscriberStatusCallback(), ros::VoidConstPtr(),
-        &callback_queue_);
+        queue);
     wrench_publisher_ = node_handle_->advertise(ops);
   }
 
@@ -185,7 +362,7 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   {
     ros::AdvertiseOptions ops = ros::AdvertiseOptions::create<geometry_msgs::Twist>(
         link_velocity_topic_, 10, ros::SubscriberStatusCallback(), ros::SubscriberStatusCallback(), ros::VoidConstPtr(),
-        &callback_queue_);
+        queue);
     link_velocity_publisher_ = node_handle_->advertise(ops);
   }
 
@@ -194,23 +371,104 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   {
     ros::AdvertiseOptions ops = ros::AdvertiseOptions::create<geometry_msgs::Twist>(
         desired_velocity_topic_, 10, ros::SubscriberStatusCallback(), ros::SubscriberStatusCallback(),
-        ros::VoidConstPtr(), &callback_queue_);
+        ros::VoidConstPtr(), queue);
     desired_velocity_publisher_ = node_handle_->advertise(ops);
   }
 
+  // advertise telemetry, one message every telemetry_decimation ticks carrying all of them
+  param_handle.getParam("telemetry_topic", telemetry_topic_);
+  param_handle.getParam("telemetry_decimation", telemetry_decimation_);
+  if (telemetry_decimation_ < 1)
+    telemetry_decimation_ = 1;
+  if (telemetry_buffer_size_ < 1)
+    telemetry_buffer_size_ = 1;
+  if (!telemetry_topic_.empty())
+  {
+    ros::AdvertiseOptions ops = ros::AdvertiseOptions::create<prosthesis_v7::ControllerTelemetry>(
+        telemetry_topic_, 10, ros::SubscriberStatusCallback(), ros::SubscriberStatusCallback(), ros::VoidConstPtr(),
+        queue);
+    telemetry_publisher_ = node_handle_->advertise(ops);
+  }
+  telemetry_ring_.resize(telemetry_buffer_size_);
+  telemetry_.samples.reserve(telemetry_decimation_);
+
+  // gain service, replaces gain sets of single or all loops atomically
+  param_handle.getParam("gains_service", gains_service_);
+  if (!gains_service_.empty())
+  {
+    ros::AdvertiseServiceOptions ops = ros::AdvertiseServiceOptions::create<prosthesis_v7::SetGains>(
+        gains_service_, boost::bind(&GazeboSimpleController::GainsCallback, this, _1, _2), ros::VoidConstPtr(), queue);
+    gains_service_server_ = node_handle_->advertiseService(ops);
+  }
+
   // engage/shutdown service servers
   {
     ros::AdvertiseServiceOptions ops = ros::AdvertiseServiceOptions::create<std_srvs::Empty>(
-        "engage", boost::bind(&GazeboSimpleController::EngageCallback, this, _1, _2), ros::VoidConstPtr(),
-        &callback_queue_);
+        "engage", boost::bind(&GazeboSimpleController::EngageCallback, this, _1, _2), ros::VoidConstPtr(), queue);
     engage_service_server_ = node_handle_->advertiseService(ops);
 
     ops = ros::AdvertiseServiceOptions::create<std_srvs::Empty>(
-        "shutdown", boost::bind(&GazeboSimpleController::ShutdownCallback, this, _1, _2), ros::VoidConstPtr(),
-        &callback_queue_);
+        "shutdown", boost::bind(&GazeboSimpleController::ShutdownCallback, this, _1, _2), ros::VoidConstPtr(), queue);
     shutdown_service_server_ = node_handle_->advertiseService(ops);
   }
 
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+  // timing histograms, published at a low rate by the telemetry thread and served on request
+  profile_topic_ = "controller_profile";
+  profile_period_ = 1.0;
+  if (_sdf->HasElement("profileTopic"))
+    profile_topic_ = _sdf->GetElement("profileTopic")->Get<std::string>();
+  if (_sdf->HasElement("profileRate"))
+  {
+    double profile_rate = _sdf->GetElement("profileRate")->Get<double>();
+    profile_period_ = profile_rate > 0.0 ? 1.0 / profile_rate : 0.0;
+  }
+  param_handle.getParam("profile_topic", profile_topic_);
+  if (!profile_topic_.empty() && profile_period_ > 0.0)
+  {
+    ros::AdvertiseOptions ops = ros::AdvertiseOptions::create<prosthesis_v7::ControllerProfile>(
+        profile_topic_, 1, ros::SubscriberStatusCallback(), ros::SubscriberStatusCallback(), ros::VoidConstPtr(),
+        queue);
+    profile_publisher_ = node_handle_->advertise(ops);
+  }
+  {
+    ros::AdvertiseServiceOptions ops = ros::AdvertiseServiceOptions::create<prosthesis_v7::GetControllerProfile>(
+        "get_profile", boost::bind(&GazeboSimpleController::ProfileCallback, this, _1, _2), ros::VoidConstPtr(),
+        queue);
+    profile_service_server_ = node_handle_->advertiseService(ops);
+  }
+  ROS_INFO_NAMED("simple_controller", "Profiling enabled, see service get_profile.");
+#endif
+
+  // record every input of the control law for offline replay (see controller_replay)
+  param_handle.getParam("record_file", record_file_);
+  if (!record_file_.empty())
+  {
+    if (log_.open(record_file_))
+    {
+      prosthesis::LogParameters parameters;
+      parameters.parameters = core_.parameters;
+      parameters.cascade = core_.cascade();
+      parameters.has_imu = !imu_topic_.empty();
+      parameters.has_state = !state_topic_.empty();
+      parameters.outer_period = core_.outer_schedule.period;
+      log_.write(prosthesis::LOG_PARAMETERS, 0.0, parameters);
+      log_.writeGains(0.0, gains_mailbox_.read());
+      ROS_INFO_NAMED("simple_controller", "Recording controller inputs to %s.", record_file_.c_str());
+    }
+    else
+    {
+      ROS_ERROR_NAMED("simple_controller", "Could not open record file %s.", record_file_.c_str());
+    }
+  }
+
+  if (manager_)
+  {
+    manager_->Register(this, _sdf);
+    Reset();
+    return;
+  }
+
   Reset();
 
   // New Mechanism for Updating every World Cycle
@@ -218,117 +476,260 @@ void GazeboSimpleController::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf
   // simulation iteration.
   controlTimer.Load(world, _sdf);
   updateConnection = event::Events::ConnectWorldUpdateBegin(boost::bind(&GazeboSimpleController::Update, this));
+
+  // all subscriptions and services are served from their own thread
+  callback_queue_thread_ = boost::thread(boost::bind(&GazeboSimpleController::CallbackQueueThread, this));
+  telemetry_thread_ = boost::thread(boost::bind(&GazeboSimpleController::TelemetryThread, this));
 }
 
 //////////////////////////////////////////////////////////////////////////////
-// Callbacks
+// Serve the callback queue until the node handle is shut down
+void GazeboSimpleController::CallbackQueueThread()
+{
+  static const double timeout = 0.01;
+  while (node_handle_->ok())
+  {
+    callback_queue_.callAvailable(ros::WallDuration(timeout));
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Publish the queued telemetry until the node handle is shut down
+void GazeboSimpleController::TelemetryThread()
+{
+  static const double period = 0.001;
+  while (node_handle_->ok())
+  {
+    PublishTelemetry();
+    ros::WallDuration(period).sleep();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Drain the telemetry ring and publish its samples
+void GazeboSimpleController::PublishTelemetry()
+{
+  if (auto_engaged_.exchange(false))
+    ROS_INFO_NAMED("simple_controller", "Engaging motors!");
+
+  const prosthesis_v7::ControllerSample *sample;
+  while ((sample = telemetry_ring_.front()) != NULL)
+  {
+    PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_PUBLISH]);
+    if (wrench_publisher_)
+      wrench_publisher_.publish(sample->wrench);
+    if (link_velocity_publisher_)
+      link_velocity_publisher_.publish(sample->link_velocity);
+    if (desired_velocity_publisher_)
+      desired_velocity_publisher_.publish(sample->desired_velocity);
+
+    telemetry_.samples.push_back(*sample);
+    telemetry_ring_.pop();
+
+    if (static_cast<int>(telemetry_.samples.size()) >= telemetry_decimation_)
+    {
+      telemetry_.header.stamp = telemetry_.samples.back().stamp;
+      telemetry_.dropped = telemetry_dropped_.load(std::memory_order_relaxed);
+      if (telemetry_publisher_)
+        telemetry_publisher_.publish(telemetry_);
+      telemetry_.samples.clear();
+    }
+  }
+
+  if (owns_trace_)
+  {
+    const ros::WallTime now = ros::WallTime::now();
+    if ((now - trace_last_flush_).toSec() >= 1.0)
+    {
+      trace_last_flush_ = now;
+      prosthesis::flushTrace();
+    }
+  }
+
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+  if (profile_publisher_)
+  {
+    const ros::WallTime now = ros::WallTime::now();
+    if ((now - profile_last_publish_).toSec() >= profile_period_)
+    {
+      profile_last_publish_ = now;
+      prosthesis_v7::ControllerProfile profile;
+      FillProfile(profile);
+      profile_publisher_.publish(profile);
+    }
+  }
+#endif
+}
+
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+//////////////////////////////////////////////////////////////////////////////
+// Timing histograms
+void GazeboSimpleController::FillProfile(prosthesis_v7::ControllerProfile &profile)
+{
+  static const double ns = 1e-9;
+  profile.header.stamp = ros::Time::now();
+  profile.histograms.resize(PROFILE_PHASE_COUNT);
+  for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++)
+  {
+    const prosthesis::LatencyHistogram &histogram = profile_[phase];
+    prosthesis_v7::TimingHistogram &out = profile.histograms[phase];
+    out.name = profile_names[phase];
+    out.count = histogram.count();
+    out.mean = out.count ? ns * histogram.sum() / out.count : 0.0;
+    out.p50 = ns * histogram.percentile(0.5);
+    out.p90 = ns * histogram.percentile(0.9);
+    out.p99 = ns * histogram.percentile(0.99);
+    out.max = ns * histogram.max();
+    out.bucket_upper_bounds.clear();
+    out.bucket_counts.clear();
+    for (std::size_t k = 0; k < prosthesis::LatencyHistogram::bucket_count; k++)
+    {
+      const uint64_t count = histogram.bucket(k);
+      if (count == 0)
+        continue;
+      out.bucket_upper_bounds.push_back(ns * prosthesis::LatencyHistogram::bucketUpperBound(k));
+      out.bucket_counts.push_back(count);
+    }
+  }
+}
 
-void GazeboSimpleController::ControllerCallback(const geometry_msgs::TwistConstPtr &controller_setting)
+bool GazeboSimpleController::ProfileCallback(prosthesis_v7::GetControllerProfile::Request &,
+                                             prosthesis_v7::GetControllerProfile::Response &response)
 {
-  controller_callback_ = *controller_setting;
-  // ROS_INFO_NAMED("simple_controller", "Reconfigure Request: %f, proportional: %f, differntial %f, integral: %f,
-  // time_constant: %f", controller_callback_.linear.x, controller_callback_.linear.y, controller_callback_.linear.z,
-  // controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 1)
-    controllers_.velocity_x.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                        controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 2)
-    controllers_.position_x.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                        controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 3)
-    controllers_.velocity_y.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                        controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 4)
-    controllers_.position_y.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                        controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 5)
-    controllers_.velocity_z.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                        controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 6)
-    controllers_.position_z.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                        controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 7)
-    controllers_.roll_vel.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                      controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 8)
-    controllers_.roll.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                  controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 9)
-    controllers_.pitch_vel.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                       controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 10)
-    controllers_.pitch.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                   controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 11)
-    controllers_.yaw_vel.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                     controller_callback_.angular.x, controller_callback_.angular.y);
-  if (controller_callback_.linear.x == 12)
-    controllers_.yaw.updateGains(controller_callback_.linear.y, controller_callback_.linear.z,
-                                 controller_callback_.angular.x, controller_callback_.angular.y);
+  FillProfile(response.profile);
+  return true;
 }
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// Callbacks, run on the callback queue thread and hand their results to Update() through the mailboxes
 
 void GazeboSimpleController::PositionCallback(const geometry_msgs::TwistConstPtr &position)
 {
-  position_command_ = *position;
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_CALLBACKS]);
+  // the same command arrives with its trace as well
+  static const double traced_position_timeout = 0.5;
+  if (!traced_position_stamp_.isZero() &&
+      (ros::WallTime::now() - traced_position_stamp_).toSec() < traced_position_timeout)
+    return;
+
+  prosthesis_v7::TracedTwist &command = position_mailbox_.back();
+  command.trace.id = 0;
+  command.twist = *position;
+  position_mailbox_.publish();
+}
+
+void GazeboSimpleController::TracedPositionCallback(const prosthesis_v7::TracedTwistConstPtr &position)
+{
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_CALLBACKS]);
+  prosthesis::ScopedTrace trace("controller receive", position->trace.id, prosthesis::TRACE_FLOW_THROUGH);
+  traced_position_stamp_ = ros::WallTime::now();
+  position_mailbox_.write(*position);
 }
 
 void GazeboSimpleController::VelocityCallback(const geometry_msgs::TwistConstPtr &velocity)
 {
-  velocity_command_ = *velocity;
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_CALLBACKS]);
+  velocity_mailbox_.write(*velocity);
 }
 
 void GazeboSimpleController::ImuCallback(const sensor_msgs::ImuConstPtr &imu)
 {
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_CALLBACKS]);
+  prosthesis::ImuSample &sample = imu_mailbox_.back();
 #if (GAZEBO_MAJOR_VERSION >= 8)
-  pose.Rot().Set(imu->orientation.w, imu->orientation.x, imu->orientation.y, imu->orientation.z);
-  euler = pose.Rot().Euler();
-  angular_velocity = pose.Rot().RotateVector(
-      ignition::math::Vector3d(imu->angular_velocity.x, imu->angular_velocity.y, imu->angular_velocity.z));
+  ignition::math::Quaterniond rot(imu->orientation.w, imu->orientation.x, imu->orientation.y, imu->orientation.z);
+  sample.orientation = toCore(rot);
+  sample.euler = toCore(rot.Euler());
+  sample.angular_velocity = toCore(rot.RotateVector(
+      ignition::math::Vector3d(imu->angular_velocity.x, imu->angular_velocity.y, imu->angular_velocity.z)));
 #else
-  pose.rot.Set(imu->orientation.w, imu->orientation.x, imu->orientation.y, imu->orientation.z);
-  euler = pose.rot.GetAsEuler();
-  angular_velocity =
-      pose.rot.RotateVector(math::Vector3(imu->angular_velocity.x, imu->angular_velocity.y, imu->angular_velocity.z));
+  math::Quaternion rot(imu->orientation.w, imu->orientation.x, imu->orientation.y, imu->orientation.z);
+  sample.orientation = toCore(rot);
+  sample.euler = toCore(rot.GetAsEuler());
+  sample.angular_velocity = toCore(
+      rot.RotateVector(math::Vector3(imu->angular_velocity.x, imu->angular_velocity.y, imu->angular_velocity.z)));
 #endif
+  imu_mailbox_.publish();
 }
 
 void GazeboSimpleController::StateCallback(const nav_msgs::OdometryConstPtr &state)
 {
-#if (GAZEBO_MAJOR_VERSION >= 8)
-  ignition::math::Vector3d velocity1(velocity);
-#else
-  math::Vector3 velocity1(velocity);
-#endif
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_CALLBACKS]);
+  prosthesis::Vector3 velocity1 = state_.velocity;
 
   if (imu_topic_.empty())
   {
 #if (GAZEBO_MAJOR_VERSION >= 8)
-    pose.Pos().Set(state->pose.pose.position.x, state->pose.pose.position.y, state->pose.pose.position.z);
-    pose.Rot().Set(state->pose.pose.orientation.w, state->pose.pose.orientation.x, state->pose.pose.orientation.y,
-                   state->pose.pose.orientation.z);
-    euler = pose.Rot().Euler();
+    ignition::math::Quaterniond rot(state->pose.pose.orientation.w, state->pose.pose.orientation.x,
+                                    state->pose.pose.orientation.y, state->pose.pose.orientation.z);
+    state_.euler = toCore(rot.Euler());
 #else
-    pose.pos.Set(state->pose.pose.position.x, state->pose.pose.position.y, state->pose.pose.position.z);
-    pose.rot.Set(state->pose.pose.orientation.w, state->pose.pose.orientation.x, state->pose.pose.orientation.y,
-                 state->pose.pose.orientation.z);
-    euler = pose.rot.GetAsEuler();
+    math::Quaternion rot(state->pose.pose.orientation.w, state->pose.pose.orientation.x, state->pose.pose.orientation.y,
+                         state->pose.pose.orientation.z);
+    state_.euler = toCore(rot.GetAsEuler());
 #endif
-    angular_velocity.Set(state->twist.twist.angular.x, state->twist.twist.angular.y, state->twist.twist.angular.z);
+    state_.orientation = toCore(rot);
+    state_.position.x = state->pose.pose.position.x;
+    state_.position.y = state->pose.pose.position.y;
+    state_.position.z = state->pose.pose.position.z;
+    state_.angular_velocity = toCore(state->twist.twist.angular);
   }
 
-  velocity.Set(state->twist.twist.linear.x, state->twist.twist.linear.y, state->twist.twist.linear.z);
+  state_.velocity = toCore(state->twist.twist.linear);
 
   // calculate acceleration
   double dt = !state_stamp.isZero() ? (state->header.stamp - state_stamp).toSec() : 0.0;
   state_stamp = state->header.stamp;
   if (dt > 0.0)
   {
-    acceleration = (velocity - velocity1) / dt;
+    state_.acceleration.x = (state_.velocity.x - velocity1.x) / dt;
+    state_.acceleration.y = (state_.velocity.y - velocity1.y) / dt;
+    state_.acceleration.z = (state_.velocity.z - velocity1.z) / dt;
   }
   else
   {
-    acceleration.Set();
+    state_.acceleration.x = state_.acceleration.y = state_.acceleration.z = 0.0;
+  }
+
+  state_mailbox_.write(state_);
+}
+
+bool GazeboSimpleController::GainsCallback(prosthesis_v7::SetGains::Request &request,
+                                           prosthesis_v7::SetGains::Response &response)
+{
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_CALLBACKS]);
+  // edit a copy, so an invalid entry leaves the table untouched
+  prosthesis::PIDGains gains = shadow_gains_;
+  for (size_t k = 0; k < request.gains.size(); k++)
+  {
+    const prosthesis_v7::GainSet &set = request.gains[k];
+    int begin = 0;
+    int end = Core::CONTROLLER_COUNT;
+    if (!set.controller.empty())
+    {
+      for (begin = 0; begin < Core::CONTROLLER_COUNT && set.controller != controller_names[begin]; begin++)
+        ;
+      if (begin == Core::CONTROLLER_COUNT)
+      {
+        response.success = false;
+        response.message = "unknown controller " + set.controller;
+        return true;
+      }
+      end = begin + 1;
+    }
+    for (int controller = begin; controller < end; controller++)
+    {
+      gains.set(controller, set.proportional, set.integral, set.differential, set.time_constant);
+      gains.limit[controller] = set.limit;
+    }
   }
+
+  // the control thread picks the new table up at its next tick
+  shadow_gains_ = gains;
+  gains_mailbox_.write(shadow_gains_);
+  response.success = true;
+  return true;
 }
 
 bool GazeboSimpleController::EngageCallback(std_srvs::Empty::Request &, std_srvs::Empty::Response &)
@@ -349,248 +750,225 @@ bool GazeboSimpleController::ShutdownCallback(std_srvs::Empty::Request &, std_sr
 // Update the controller
 void GazeboSimpleController::Update()
 {
-  // Get new commands/state
-  callback_queue_.callAvailable();
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_UPDATE]);
+#if (GAZEBO_MAJOR_VERSION >= 8)
+  const common::Time sim_time = world->SimTime();
+#else
+  const common::Time sim_time = world->GetSimTime();
+#endif
+  ReadInputs(sim_time.Double());
 
   double dt;
   if (controlTimer.update(dt) && dt > 0.0)
   {
-// Get Pose/Orientation from Gazebo (if no state subscriber is active)
-#if (GAZEBO_MAJOR_VERSION >= 8)
-    if (imu_topic_.empty())
-    {
-      pose = link->WorldPose();
-      angular_velocity = link->WorldAngularVel();
-      euler = pose.Rot().Euler();
-    }
-    if (state_topic_.empty())
-    {
-      acceleration = (link->WorldLinearVel() - velocity) / dt;
-      velocity = link->WorldLinearVel();
-    }
-#else
-    if (imu_topic_.empty())
-    {
-      pose = link->GetWorldPose();
-      angular_velocity = link->GetWorldAngularVel();
-      angular_accelaration = link->GetWorldAngularAccel();
-      euler = pose.rot.GetAsEuler();
-      real_velocity_.angular.x = angular_velocity.x;
-      real_velocity_.angular.y = angular_velocity.y;
-      real_velocity_.angular.z = angular_velocity.z;
-    }
-    if (state_topic_.empty())
+    PrepareTick(dt);
+
+    // update controllers
+    prosthesis::ControllerOutput output;
     {
-      acceleration = (link->GetWorldLinearVel() - velocity) / dt;
-      velocity = link->GetWorldLinearVel();
-      real_velocity_.linear.x = velocity.x;
-      real_velocity_.linear.y = velocity.y;
-      real_velocity_.linear.z = velocity.z;
+      PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_CASCADE]);
+      core_.update(gains_mailbox_.read(), input_, dt, tick_running_, output);
     }
-#endif
 
-    // Auto engage/shutdown
-    if (auto_engage_)
+    FinishTick(sim_time, dt, output);
+  }
+
+  ApplyWrench();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Take over new commands/state published by the callback queue thread, returns true if the gains changed
+bool GazeboSimpleController::ReadInputs(double time)
+{
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_READ_INPUTS]);
+  prosthesis::SharedCommand shared;
+  if (shared_command_.isOpen() && shared_command_.read(shared) &&
+      prosthesis::sharedCommandClock() - shared.stamp < shared_command_timeout_)
+  {
+    shared_command_stamp_ = shared.stamp;
+    input_.position_command_linear = shared.linear;
+    input_.position_command_angular = shared.angular;
+    setpoint_predictor_.command(shared.angular, time);
+    if (log_.isOpen())
+      logCommand(log_, prosthesis::LOG_POSITION_COMMAND, time, input_.position_command_linear,
+                 input_.position_command_angular);
+  }
+  // the topic carries the same commands later, it only counts once the shared memory went quiet
+  if (position_mailbox_.update() &&
+      !(shared_command_.isOpen() && prosthesis::sharedCommandClock() - shared_command_stamp_ < shared_command_timeout_))
+  {
+    const prosthesis_v7::TracedTwist &command = position_mailbox_.read();
+    input_.position_command_linear = toCore(command.twist.linear);
+    input_.position_command_angular = toCore(command.twist.angular);
+    if (command.trace.id != 0)
     {
-      if (!running_ && position_command_.linear.z > 0.1)
-      {
-        running_ = true;
-        ROS_INFO_NAMED("simple_controller", "Engaging motors!");
-      }
+      prosthesis::recordTrace("controller apply", prosthesis::traceClock(), 0, command.trace.id,
+                              prosthesis::TRACE_FLOW_THROUGH);
+      applied_trace_ = command.trace.id;
     }
+    setpoint_predictor_.command(input_.position_command_angular, time);
+    if (log_.isOpen())
+      logCommand(log_, prosthesis::LOG_POSITION_COMMAND, time, input_.position_command_linear,
+                 input_.position_command_angular);
+  }
+  // between two commands the orientation setpoint follows their rotation instead of standing still,
+  // recorded like a command so a replay sees the same setpoints
+  if (setpoint_predictor_.horizon > 0.0 && setpoint_predictor_.hasCommand())
+  {
+    input_.position_command_angular = setpoint_predictor_.predict(time);
+    if (log_.isOpen())
+      logCommand(log_, prosthesis::LOG_POSITION_COMMAND, time, input_.position_command_linear,
+                 input_.position_command_angular);
+  }
+  if (velocity_mailbox_.update())
+  {
+    const geometry_msgs::Twist &command = velocity_mailbox_.read();
+    input_.velocity_command_linear = toCore(command.linear);
+    input_.velocity_command_angular = toCore(command.angular);
+    if (log_.isOpen())
+      logCommand(log_, prosthesis::LOG_VELOCITY_COMMAND, time, input_.velocity_command_linear,
+                 input_.velocity_command_angular);
+  }
+  if (imu_mailbox_.update())
+  {
+    prosthesis::applyImu(imu_mailbox_.read(), input_);
+    if (log_.isOpen())
+      log_.write(prosthesis::LOG_IMU, time, imu_mailbox_.read());
+  }
+  if (state_mailbox_.update())
+  {
+    prosthesis::applyState(state_mailbox_.read(), !imu_topic_.empty(), input_);
+    if (log_.isOpen())
+      log_.write(prosthesis::LOG_STATE, time, state_mailbox_.read());
+  }
 
-//  static Time lastDebug;
-//  if ((world->GetSimTime() - lastDebug).Double() > 0.5) {
-//    ROS_DEBUG_STREAM_NAMED("simple_controller", "Velocity:         gazebo = [" << link->GetWorldLinearVel()   << "],
-//    state = [" << velocity << "]");
-//    ROS_DEBUG_STREAM_NAMED("simple_controller", "Acceleration:     gazebo = [" << link->GetWorldLinearAccel() << "],
-//    state = [" << acceleration << "]");
-//    ROS_DEBUG_STREAM_NAMED("simple_controller", "Angular Velocity: gazebo = [" << link->GetWorldAngularVel() << "],
-//    state = [" << angular_velocity << "]");
-//    lastDebug = world->GetSimTime();
-//  }
-
-// Get gravity
-#if (GAZEBO_MAJOR_VERSION >= 8)
-    ignition::math::Vector3d gravity_body = pose.Rot().RotateVector(world->Gravity());
-    double gravity = gravity_body.Length();
-    double load_factor = gravity * gravity / world->Gravity().Dot(gravity_body);  // Get gravity
-#else
-    math::Vector3 gravity_body = pose.rot.RotateVector(world->GetPhysicsEngine()->GetGravity());
-    double gravity = gravity_body.GetLength();
-    double load_factor = gravity * gravity / world->GetPhysicsEngine()->GetGravity().Dot(gravity_body);  // Get gravity
-#endif
+  // swap in a gain table published by GainsCallback, only ever between two ticks
+  if (!gains_mailbox_.update())
+    return false;
+  if (log_.isOpen())
+    log_.writeGains(time, gains_mailbox_.read());
+  return true;
+}
 
-// Rotate vectors to coordinate frames relevant for control
+//////////////////////////////////////////////////////////////////////////////
+// Complete input_ from the link and decide whether the controller runs this tick
+void GazeboSimpleController::PrepareTick(double dt)
+{
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_PREPARE_TICK]);
+  // Get Pose/Orientation from Gazebo (used for everything no imu/state subscriber provides)
 #if (GAZEBO_MAJOR_VERSION >= 8)
-    ignition::math::Quaterniond heading_quaternion(cos(euler.Z() / 2), 0, 0, sin(euler.Z() / 2));
-    ignition::math::Vector3d velocity_xy = heading_quaternion.RotateVectorReverse(velocity);
-    ignition::math::Vector3d acceleration_xy = heading_quaternion.RotateVectorReverse(acceleration);
-    ignition::math::Vector3d angular_velocity_body = pose.Rot().RotateVectorReverse(angular_velocity);
+  const ignition::math::Pose3d pose = link->WorldPose();
+  link_state_.position = toCore(pose.Pos());
+  link_state_.orientation = toCore(pose.Rot());
+  link_state_.euler = toCore(pose.Rot().Euler());
+  link_state_.velocity = toCore(link->WorldLinearVel());
+  link_state_.angular_velocity = toCore(link->WorldAngularVel());
+  link_state_.angular_acceleration = toCore(link->WorldAngularAccel());
+  input_.gravity = toCore(world->Gravity());
 #else
-    math::Quaternion heading_quaternion(cos(euler.z / 2), 0, 0, sin(euler.z / 2));
-    math::Vector3 velocity_xy = heading_quaternion.RotateVectorReverse(velocity);
-    math::Vector3 acceleration_xy = heading_quaternion.RotateVectorReverse(acceleration);
-    math::Vector3 angular_velocity_body = pose.rot.RotateVectorReverse(angular_velocity);
+  const math::Pose pose = link->GetWorldPose();
+  link_state_.position = toCore(pose.pos);
+  link_state_.orientation = toCore(pose.rot);
+  link_state_.euler = toCore(pose.rot.GetAsEuler());
+  link_state_.velocity = toCore(link->GetWorldLinearVel());
+  link_state_.angular_velocity = toCore(link->GetWorldAngularVel());
+  link_state_.angular_acceleration = toCore(link->GetWorldAngularAccel());
+  input_.gravity = toCore(world->GetPhysicsEngine()->GetGravity());
 #endif
+  prosthesis::applyLink(link_state_, !imu_topic_.empty(), !state_topic_.empty(), dt, input_);
 
-    // update controllers
-    force.Set(0.0, 0.0, 0.0);
-    torque.Set(0.0, 0.0, 0.0);
-    if (running_)
-    {
-#if (GAZEBO_MAJOR_VERSION >= 8)
-      double pitch_command =
-          controllers_.velocity_x.update(velocity_command_.linear.x, velocity_xy.X(), acceleration_xy.X(), dt) /
-          gravity;
-      double roll_command =
-          -controllers_.velocity_y.update(velocity_command_.linear.y, velocity_xy.Y(), acceleration_xy.Y(), dt) /
-          gravity;
-      torque.X() = inertia.X() * controllers_.roll.update(roll_command, euler.X(), angular_velocity_body.X(), dt);
-      torque.Y() = inertia.Y() * controllers_.pitch.update(pitch_command, euler.Y(), angular_velocity_body.Y(), dt);
-      torque.Z() = inertia.Z() * controllers_.yaw.update(velocity_command_.angular.z, angular_velocity.Z(), 0, dt);
-      force.Z() =
-          mass * (controllers_.velocity_z.update(velocity_command_.linear.z, velocity.Z(), acceleration.Z(), dt) +
-                  load_factor * gravity);
-      if (max_force_ > 0.0 && force.Z() > max_force_)
-        force.Z() = max_force_;
-      if (force.Z() < 0.0)
-        force.Z() = 0.0;
-#else
-      // changed paramaters
-      // ROS_INFO_NAMED("simple_controller", "timestep: %f, world coordinates: x: %f y: %f z: %f r: %f p %f y %f", dt,
-      // pose.pos.x, pose.pos.y, pose.pos.z, euler.x, euler.y, euler.z);
-      velocity_command_.linear.x =
-          controllers_.position_x.update(position_command_.linear.x, pose.pos.x, velocity.x, dt);
-      velocity_command_.linear.y =
-          controllers_.position_y.update(position_command_.linear.y, pose.pos.y, velocity.y, dt);
-      velocity_command_.linear.z =
-          controllers_.position_z.update(position_command_.linear.z, pose.pos.z, velocity.z, dt);
-      force.x = mass * controllers_.velocity_x.update(velocity_command_.linear.x, velocity.x, acceleration.x, dt);
-      force.y = mass * controllers_.velocity_y.update(velocity_command_.linear.y, velocity.y, acceleration.y, dt);
-      force.z = mass * (controllers_.velocity_z.update(velocity_command_.linear.z, velocity.z, acceleration.z, dt) +
-                        load_factor * gravity);
-      velocity_command_.angular.x =
-          controllers_.roll.update(position_command_.angular.x, euler.x, angular_velocity.x, dt);
-      velocity_command_.angular.y =
-          controllers_.pitch.update(position_command_.angular.y, euler.y, angular_velocity.y, dt);
-      velocity_command_.angular.z =
-          controllers_.yaw.update(position_command_.angular.z, euler.z, angular_velocity.z, dt);
-      torque.x =
-          inertia.x *
-          controllers_.roll_vel.update(velocity_command_.angular.x, angular_velocity.x, angular_accelaration.x, dt);
-      torque.y =
-          inertia.y *
-          controllers_.pitch_vel.update(velocity_command_.angular.y, angular_velocity.y, angular_accelaration.y, dt);
-      torque.z =
-          inertia.z *
-          controllers_.yaw_vel.update(velocity_command_.angular.z, angular_velocity.z, angular_accelaration.z, dt);
-
-      // double pitch_command = controllers_.velocity_x.update(velocity_command_.linear.x, velocity_xy.x,
-      // acceleration_xy.x, dt) / gravity;
-      // double roll_command = -controllers_.velocity_y.update(velocity_command_.linear.y, velocity_xy.y,
-      // acceleration_xy.y, dt) / gravity;
-
-      // torque.x = inertia.x *  controllers_.roll.update(-velocity_command_.linear.y/gravity, euler.x,
-      // angular_velocity_body.x, dt);
-      // torque.y = inertia.y *  controllers_.pitch.update(velocity_command_.linear.x/gravity, euler.y,
-      // angular_velocity_body.y, dt);
-      if (max_force_ > 0.0 && fabs(force.z) + 10 > max_force_)
-        force.z = (force.z > max_force_) ? max_force_ + 10 : -max_force_ - 10;
-      if (max_force_ > 0.0 && fabs(force.x) > max_force_)
-        force.x = (force.x > max_force_) ? max_force_ : -max_force_;
-      if (max_force_ > 0.0 && fabs(force.y) > max_force_)
-        force.y = (force.y > max_force_) ? max_force_ : -max_force_;
-      if (max_torque_ > 0.0 && fabs(torque.x) > max_torque_)
-        torque.x = (torque.x > max_force_) ? max_torque_ : -max_torque_;
-      if (max_torque_ > 0.0 && fabs(torque.y) > max_torque_)
-        torque.y = (torque.y > max_force_) ? max_torque_ : -max_torque_;
-      if (max_torque_ > 0.0 && fabs(torque.z) > max_torque_)
-        torque.z = (torque.z > max_force_) ? max_torque_ : -max_torque_;
-
-// ROS_INFO_NAMED("simple_controller", "Forces applied: x: %f y: %f z: %f r: %f p %f y %f", force.x, force.y, force.z,
-// torque.x, torque.y, torque.z);
-
-// old parameters
-// double pitch_command = controllers_.velocity_x.update(velocity_command_.linear.x, velocity_xy.x, acceleration_xy.x,
-// dt) / gravity;
-// double roll_command = -controllers_.velocity_y.update(velocity_command_.linear.y, velocity_xy.y, acceleration_xy.y,
-// dt) / gravity;
-// torque.x = inertia.x * controllers_.roll.update(roll_command, euler.x, angular_velocity_body.x, dt);
-// torque.y = inertia.y * controllers_.pitch.update(pitch_command, euler.y, angular_velocity_body.y, dt);
-// // torque.x = inertia.x *  controllers_.roll.update(-velocity_command_.linear.y/gravity, euler.x,
-// angular_velocity_body.x, dt);
-// // torque.y = inertia.y *  controllers_.pitch.update(velocity_command_.linear.x/gravity, euler.y,
-// angular_velocity_body.y, dt);
-// torque.z = inertia.z * controllers_.yaw.update(velocity_command_.angular.z, angular_velocity.z, 0, dt);
-// force.z = mass * (controllers_.velocity_z.update(velocity_command_.linear.z, velocity.z, acceleration.z, dt) +
-// load_factor * gravity);
-// if (max_force_ > 0.0 && force.z > max_force_)
-//   force.z = max_force_;
-// if (force.z < 0.0)
-//   force.z = 0.0;
-#endif
-    }
-    else
-    {
-      controllers_.roll.reset();
-      controllers_.pitch.reset();
-      controllers_.yaw.reset();
-      controllers_.roll_vel.reset();
-      controllers_.pitch_vel.reset();
-      controllers_.yaw_vel.reset();
-      controllers_.velocity_x.reset();
-      controllers_.velocity_y.reset();
-      controllers_.velocity_z.reset();
-    }
+  real_velocity_.linear.x = link_state_.velocity.x;
+  real_velocity_.linear.y = link_state_.velocity.y;
+  real_velocity_.linear.z = link_state_.velocity.z;
+  real_velocity_.angular.x = link_state_.angular_velocity.x;
+  real_velocity_.angular.y = link_state_.angular_velocity.y;
+  real_velocity_.angular.z = link_state_.angular_velocity.z;
 
-    //  static double lastDebugOutput = 0.0;
-    //  if (last_time.Double() - lastDebugOutput > 0.1) {
-    //    ROS_DEBUG_NAMED("simple_controller", "Velocity = [%g %g %g], Acceleration = [%g %g %g]", velocity.x,
-    //    velocity.y, velocity.z, acceleration.x, acceleration.y, acceleration.z);
-    //    ROS_DEBUG_NAMED("simple_controller", "Command: linear = [%g %g %g], angular = [%g %g %g], roll/pitch = [%g
-    //    %g]", velocity_command_.linear.x, velocity_command_.linear.y, velocity_command_.linear.z,
-    //    velocity_command_.angular.x*180/M_PI, velocity_command_.angular.y*180/M_PI,
-    //    velocity_command_.angular.z*180/M_PI, roll_command*180/M_PI, pitch_command*180/M_PI);
-    //    ROS_DEBUG_NAMED("simple_controller", "Mass: %g kg, Inertia: [%g %g %g], Load: %g g", mass, inertia.x,
-    //    inertia.y, inertia.z, load_factor);
-    //    ROS_DEBUG_NAMED("simple_controller", "Force: [%g %g %g], Torque: [%g %g %g]", force.x, force.y, force.z,
-    //    torque.x, torque.y, torque.z);
-    //    lastDebugOutput = last_time.Double();
-    //  }
-
-    // Publish wrench
-    if (wrench_publisher_)
+  // Auto engage/shutdown
+  if (auto_engage_)
+  {
+    if (!running_ && input_.position_command_linear.z > 0.1)
     {
-      geometry_msgs::Wrench wrench;
-#if (GAZEBO_MAJOR_VERSION >= 8)
-      wrench.force.x = force.X();
-      wrench.force.y = force.Y();
-      wrench.force.z = force.Z();
-      wrench.torque.x = torque.X();
-      wrench.torque.y = torque.Y();
-      wrench.torque.z = torque.Z();
-#else
-      wrench.force.x = force.x;
-      wrench.force.y = force.y;
-      wrench.force.z = force.z;
-      wrench.torque.x = torque.x;
-      wrench.torque.y = torque.y;
-      wrench.torque.z = torque.z;
-#endif
-      wrench_publisher_.publish(wrench);
+      running_ = true;
+      // logged by the telemetry thread, logging may allocate
+      auto_engaged_ = true;
     }
-    link_velocity_publisher_.publish(real_velocity_);
-    desired_velocity_publisher_.publish(velocity_command_);
   }
+  tick_running_ = running_;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Take over the result of the control law, record it and queue it for publishing
+void GazeboSimpleController::FinishTick(const common::Time &sim_time, double dt,
+                                        const prosthesis::ControllerOutput &output)
+{
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_FINISH_TICK]);
+  // the position cascade replaces the velocity command by the one it computed
+  input_.velocity_command_linear = output.velocity_command_linear;
+  input_.velocity_command_angular = output.velocity_command_angular;
 
-  // set force and torque in gazebo
+  force.Set(output.force.x, output.force.y, output.force.z);
+  torque.Set(output.torque.x, output.torque.y, output.torque.z);
+
+  if (log_.isOpen())
+  {
+    prosthesis::LogTick tick;
+    tick.dt = dt;
+    tick.running = tick_running_;
+    tick.gravity = input_.gravity;
+    tick.link = link_state_;
+    tick.force = output.force;
+    tick.torque = output.torque;
+    log_.write(prosthesis::LOG_TICK, sim_time.Double(), tick);
+  }
+
+  // Queue the outputs of this tick, they are published by the telemetry thread
+  prosthesis_v7::ControllerSample sample;
+  sample.stamp = ros::Time(sim_time.sec, sim_time.nsec);
+  sample.wrench.force.x = output.force.x;
+  sample.wrench.force.y = output.force.y;
+  sample.wrench.force.z = output.force.z;
+  sample.wrench.torque.x = output.torque.x;
+  sample.wrench.torque.y = output.torque.y;
+  sample.wrench.torque.z = output.torque.z;
+  sample.link_velocity = real_velocity_;
+  sample.desired_velocity.linear.x = output.velocity_command_linear.x;
+  sample.desired_velocity.linear.y = output.velocity_command_linear.y;
+  sample.desired_velocity.linear.z = output.velocity_command_linear.z;
+  sample.desired_velocity.angular.x = output.velocity_command_angular.x;
+  sample.desired_velocity.angular.y = output.velocity_command_angular.y;
+  sample.desired_velocity.angular.z = output.velocity_command_angular.z;
+  if (!telemetry_ring_.push(sample))
+    telemetry_dropped_.fetch_add(1, std::memory_order_relaxed);
+
+  if (applied_trace_ != 0)
+  {
+    prosthesis::recordTrace("controller tick", prosthesis::traceClock(), 0, applied_trace_,
+                            prosthesis::TRACE_FLOW_THROUGH);
+    wrench_trace_ = applied_trace_;
+    applied_trace_ = 0;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Set force and torque in gazebo, every world step
+void GazeboSimpleController::ApplyWrench()
+{
+  PROSTHESIS_PROFILE_SCOPE(profile_[PROFILE_APPLY_WRENCH]);
   link->AddForce(force);
 #if (GAZEBO_MAJOR_VERSION >= 8)
   link->AddRelativeTorque(torque - link->GetInertial()->CoG().Cross(force));
 #else
   link->AddRelativeTorque(torque - link->GetInertial()->GetCoG().Cross(force));
 #endif
+
+  // the first wrench computed from a traced command ends its trace
+  if (wrench_trace_ != 0)
+  {
+    prosthesis::recordTrace("controller wrench", prosthesis::traceClock(), 0, wrench_trace_,
+                            prosthesis::TRACE_FLOW_IN);
+    wrench_trace_ = 0;
+  }
 }
 
 //     // set force and torque in gazebo
@@ -606,96 +984,51 @@ void GazeboSimpleController::Update()
 // Reset the controller
 void GazeboSimpleController::Reset()
 {
-  controllers_.roll.reset();
-  controllers_.pitch.reset();
-  controllers_.yaw.reset();
-  controllers_.velocity_x.reset();
-  controllers_.velocity_y.reset();
-  controllers_.velocity_z.reset();
+  if (manager_)
+    manager_->Reset(this);
+  else
+    core_.reset();
 
   force.Set();
   torque.Set();
 
   // reset state
-  pose.Reset();
-  velocity.Set();
-  angular_velocity.Set();
-  acceleration.Set();
-  euler.Set();
-  state_stamp = ros::Time();
+  prosthesis::resetState(input_);
+  setpoint_predictor_.reset();
+  applied_trace_ = 0;
+  wrench_trace_ = 0;
+  if (log_.isOpen())
+    log_.write(prosthesis::LOG_RESET, 0.0, NULL, 0);
 
   running_ = false;
 }
 
 //////////////////////////////////////////////////////////////////////////////
-// PID controller implementation
-GazeboSimpleController::PIDController::PIDController()
+// Load the gains of a single PID loop from sdf
+void GazeboSimpleController::LoadController(sdf::ElementPtr _sdf, int controller, const std::string &prefix)
 {
-}
-
-GazeboSimpleController::PIDController::~PIDController()
-{
-}
+  double gain_p = 0.0;
+  double gain_d = 0.0;
+  double gain_i = 0.0;
+  double time_constant = 0.0;
+  double limit = -1.0;
 
-void GazeboSimpleController::PIDController::Load(sdf::ElementPtr _sdf, const std::string &prefix)
-{
-  gain_p = 0.0;
-  gain_d = 0.0;
-  gain_i = 0.0;
-  time_constant = 0.0;
-  limit = -1.0;
-
-  if (!_sdf)
-    return;
-  // _sdf->PrintDescription(_sdf->GetName());
-  if (_sdf->HasElement(prefix + "ProportionalGain"))
-    gain_p = _sdf->GetElement(prefix + "ProportionalGain")->Get<double>();
-  if (_sdf->HasElement(prefix + "DifferentialGain"))
-    gain_d = _sdf->GetElement(prefix + "DifferentialGain")->Get<double>();
-  if (_sdf->HasElement(prefix + "IntegralGain"))
-    gain_i = _sdf->GetElement(prefix + "IntegralGain")->Get<double>();
-  if (_sdf->HasElement(prefix + "TimeConstant"))
-    time_constant = _sdf->GetElement(prefix + "TimeConstant")->Get<double>();
-  if (_sdf->HasElement(prefix + "Limit"))
-    limit = _sdf->GetElement(prefix + "Limit")->Get<double>();
-}
-
-void GazeboSimpleController::PIDController::updateGains(double gain_p_new, double gain_d_new, double gain_i_new,
-                                                        double time_constant_new)
-{
-  gain_p = gain_p_new;
-  gain_d = gain_d_new;
-  gain_i = gain_i_new;
-  time_constant = time_constant_new;
-}
-
-double GazeboSimpleController::PIDController::update(double new_input, double x, double dx, double dt)
-{
-  // limit command
-  if (limit > 0.0 && fabs(new_input) > limit)
-    new_input = (new_input < 0 ? -1.0 : 1.0) * limit;
-
-  // filter command
-  if (dt + time_constant > 0.0)
+  if (_sdf)
   {
-    dinput = (new_input - input) / (dt + time_constant);
-    input = (dt * new_input + time_constant * input) / (dt + time_constant);
+    if (_sdf->HasElement(prefix + "ProportionalGain"))
+      gain_p = _sdf->GetElement(prefix + "ProportionalGain")->Get<double>();
+    if (_sdf->HasElement(prefix + "DifferentialGain"))
+      gain_d = _sdf->GetElement(prefix + "DifferentialGain")->Get<double>();
+    if (_sdf->HasElement(prefix + "IntegralGain"))
+      gain_i = _sdf->GetElement(prefix + "IntegralGain")->Get<double>();
+    if (_sdf->HasElement(prefix + "TimeConstant"))
+      time_constant = _sdf->GetElement(prefix + "TimeConstant")->Get<double>();
+    if (_sdf->HasElement(prefix + "Limit"))
+      limit = _sdf->GetElement(prefix + "Limit")->Get<double>();
   }
 
-  // update proportional, differential and integral errors
-  p = input - x;
-  d = dinput - dx;
-  i = i + dt * p;
-
-  // update control output
-  output = gain_p * p + gain_d * d + gain_i * i;
-  return output;
-}
-
-void GazeboSimpleController::PIDController::reset()
-{
-  input = dinput = 0;
-  p = i = d = output = 0;
+  shadow_gains_.set(controller, gain_p, gain_i, gain_d, time_constant);
+  shadow_gains_.limit[controller] = limit;
 }
 
 // Register this plugin with the simulator
@@ -0,0 +1,220 @@
+#include <gazebo_simple_controller_manager.h>
+#include <gazebo_simple_controller.h>
+#include <gazebo/common/Events.hh>
+#include <gazebo/physics/physics.hh>
+
+#include <boost/weak_ptr.hpp>
+#include <map>
+
+namespace gazebo
+{
+// one manager per world and cascade, kept alive by its instances
+static boost::mutex managers_mutex;
+static std::map<std::string, boost::weak_ptr<SimpleControllerManager> > managers;
+
+boost::shared_ptr<SimpleControllerManager> SimpleControllerManager::Get(
+    physics::WorldPtr world, prosthesis::SimpleControllerCore::Cascade cascade)
+{
+#if (GAZEBO_MAJOR_VERSION >= 8)
+  const std::string name = world->Name() + "/" + prosthesis::cascadeName(cascade);
+#else
+  const std::string name = world->GetName() + "/" + prosthesis::cascadeName(cascade);
+#endif
+  boost::mutex::scoped_lock lock(managers_mutex);
+  boost::shared_ptr<SimpleControllerManager> manager = managers[name].lock();
+  if (!manager)
+  {
+    manager.reset(new SimpleControllerManager(world, cascade));
+    managers[name] = manager;
+  }
+  return manager;
+}
+
+SimpleControllerManager::SimpleControllerManager(physics::WorldPtr _world,
+                                                 prosthesis::SimpleControllerCore::Cascade cascade)
+  : world(_world), stop_(false)
+{
+  batch_.cascade = cascade;
+
+  callback_queue_thread_ = boost::thread(boost::bind(&SimpleControllerManager::CallbackQueueThread, this));
+  telemetry_thread_ = boost::thread(boost::bind(&SimpleControllerManager::TelemetryThread, this));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Destructor, runs when the last instance is gone
+SimpleControllerManager::~SimpleControllerManager()
+{
+#if (GAZEBO_MAJOR_VERSION < 8)
+  event::Events::DisconnectWorldUpdateBegin(updateConnection);
+#endif
+  updateConnection.reset();
+
+  stop_ = true;
+  callback_queue_.clear();
+  callback_queue_.disable();
+  if (callback_queue_thread_.joinable())
+    callback_queue_thread_.join();
+  if (telemetry_thread_.joinable())
+    telemetry_thread_.join();
+}
+
+ros::CallbackQueue *SimpleControllerManager::GetCallbackQueue()
+{
+  return &callback_queue_;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Add and remove instances
+void SimpleControllerManager::Register(GazeboSimpleController *controller, sdf::ElementPtr sdf)
+{
+  boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+  const std::size_t model = batch_.addModel();
+  controllers_.push_back(controller);
+  batch_.parameters[model] = controller->core_.parameters;
+  batch_.setGains(model, controller->gains_mailbox_.read());
+  batch_.inputs[model] = controller->input_;
+
+  // all instances are stepped at the rates of the first one, later ones asking for others get a warning
+  if (!updateConnection)
+  {
+    controlTimer.Load(world, sdf);
+    batch_.outer_schedule.period = controller->core_.outer_schedule.period;
+    if (sdf->HasElement("batchParallelThreshold"))
+      batch_.parallel_threshold = sdf->GetElement("batchParallelThreshold")->Get<int>();
+    updateConnection = event::Events::ConnectWorldUpdateBegin(boost::bind(&SimpleControllerManager::Update, this));
+  }
+  else
+  {
+    UpdateTimer timer;
+    timer.Load(world, sdf);
+    if (timer.getUpdatePeriod() != controlTimer.getUpdatePeriod() ||
+        controller->core_.outer_schedule.period != batch_.outer_schedule.period)
+      ROS_WARN_NAMED("simple_controller",
+                     "%s asks for an update period of %g s and an outer period of %g s, batched it runs with the "
+                     "%g s and %g s of the first instance.",
+                     controller->link_name_.c_str(), timer.getUpdatePeriod(), controller->core_.outer_schedule.period,
+                     controlTimer.getUpdatePeriod(), batch_.outer_schedule.period);
+  }
+
+  ROS_INFO_NAMED("simple_controller", "Stepping %s with %lu batched controllers.", controller->link_name_.c_str(),
+                 static_cast<unsigned long>(controllers_.size()));
+}
+
+void SimpleControllerManager::Unregister(GazeboSimpleController *controller)
+{
+  boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+  const std::size_t model = Find(controller);
+  if (model == controllers_.size())
+    return;
+  controllers_.erase(controllers_.begin() + model);
+  batch_.removeModel(model);
+}
+
+void SimpleControllerManager::Reset(GazeboSimpleController *controller)
+{
+  boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+  const std::size_t model = Find(controller);
+  if (model < controllers_.size())
+    batch_.reset(model);
+}
+
+std::size_t SimpleControllerManager::Find(GazeboSimpleController *controller) const
+{
+  std::size_t model = 0;
+  while (model < controllers_.size() && controllers_[model] != controller)
+    model++;
+  return model;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Threads shared by all instances
+void SimpleControllerManager::CallbackQueueThread()
+{
+  static const double timeout = 0.01;
+  while (!stop_)
+  {
+    callback_queue_.callAvailable(ros::WallDuration(timeout));
+  }
+}
+
+void SimpleControllerManager::TelemetryThread()
+{
+  static const double period = 0.001;
+  while (!stop_)
+  {
+    {
+      boost::shared_lock<boost::shared_mutex> lock(mutex_);
+      for (std::size_t model = 0; model < controllers_.size(); model++)
+        controllers_[model]->PublishTelemetry();
+    }
+    ros::WallDuration(period).sleep();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Update all controllers, the same steps as GazeboSimpleController::Update() with one batched control law
+void SimpleControllerManager::Update()
+{
+  boost::shared_lock<boost::shared_mutex> lock(mutex_);
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+  const uint64_t update_start = prosthesis::profileClock();
+#endif
+
+#if (GAZEBO_MAJOR_VERSION >= 8)
+  const common::Time sim_time = world->SimTime();
+#else
+  const common::Time sim_time = world->GetSimTime();
+#endif
+  const double time = sim_time.Double();
+
+  for (std::size_t model = 0; model < controllers_.size(); model++)
+  {
+    if (controllers_[model]->ReadInputs(time))
+      batch_.setGains(model, controllers_[model]->gains_mailbox_.read());
+  }
+
+  double dt;
+  if (controlTimer.update(dt) && dt > 0.0)
+  {
+    for (std::size_t model = 0; model < controllers_.size(); model++)
+    {
+      GazeboSimpleController *controller = controllers_[model];
+      controller->PrepareTick(dt);
+      batch_.inputs[model] = controller->input_;
+      batch_.running[model] = controller->tick_running_;
+    }
+
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+    const uint64_t cascade_start = prosthesis::profileClock();
+#endif
+    batch_.update(dt);
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+    // every instance gets its share of the batched step
+    if (!controllers_.empty())
+    {
+      const uint64_t share = (prosthesis::profileClock() - cascade_start) / controllers_.size();
+      for (std::size_t model = 0; model < controllers_.size(); model++)
+        controllers_[model]->profile_[GazeboSimpleController::PROFILE_CASCADE].record(share);
+    }
+#endif
+
+    for (std::size_t model = 0; model < controllers_.size(); model++)
+      controllers_[model]->FinishTick(sim_time, dt, batch_.outputs[model]);
+  }
+
+  for (std::size_t model = 0; model < controllers_.size(); model++)
+    controllers_[model]->ApplyWrench();
+
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+  if (!controllers_.empty())
+  {
+    const uint64_t share = (prosthesis::profileClock() - update_start) / controllers_.size();
+    for (std::size_t model = 0; model < controllers_.size(); model++)
+      controllers_[model]->profile_[GazeboSimpleController::PROFILE_UPDATE].record(share);
+  }
+#endif
+}
+}
@@ -0,0 +1,128 @@
+#include <gripper_force_control.h>
+
+namespace prosthesis
+{
+GripperForceControl::GripperForceControl(ros::NodeHandle node_handle, ros::NodeHandle private_handle)
+  : force_(0), old_force_(0), pending_(false), event_driven_(false), min_interval_(0.0), interval_armed_(false)
+{
+  double stats_rate = 1.0;
+  private_handle.getParam("event_driven", event_driven_);
+  private_handle.getParam("min_interval", min_interval_);
+  private_handle.getParam("stats_rate", stats_rate);
+
+  // Set up clients for applying/clearing the efforts
+  apply_force_client_ = node_handle.serviceClient<gazebo_msgs::ApplyJointEffort>("/gazebo/apply_joint_effort");
+  clear_force_client_ = node_handle.serviceClient<gazebo_msgs::JointRequest>("/gazebo/clear_joint_forces");
+
+  clear_joint_forces_[0].request.joint_name = (std::string) "gripper1_gripper2";
+  clear_joint_forces_[1].request.joint_name = (std::string) "gripperpart1_gripperpart2";
+  clear_joint_forces_[2].request.joint_name = (std::string) "gripperpart2_gripperpart_3";
+
+  apply_joint_effort_[0].request.joint_name = (std::string) "gripper1_gripper2";
+  apply_joint_effort_[1].request.joint_name = (std::string) "gripperpart1_gripperpart2";
+  apply_joint_effort_[2].request.joint_name = (std::string) "gripperpart2_gripperpart_3";
+
+  // setting jointforces duration to -1 leads to a constant and neverending output of the desired force
+  for (int i = 0; i < joints; i++)
+  {
+    apply_joint_effort_[i].request.duration = ros::Duration(-1, 0);
+  }
+
+  // subscriber to input commmands --> keyboard or myo
+  command_subscriber_ = node_handle.subscribe("/gripperforce", 10, &GripperForceControl::commandCallback, this);
+  stats_publisher_ = private_handle.advertise<prosthesis_v7::CommandStats>("stats", 10);
+
+  if (event_driven_)
+    interval_timer_ = node_handle.createTimer(ros::Duration(min_interval_ > 0.0 ? min_interval_ : 0.1),
+                                              &GripperForceControl::intervalCallback, this, true /* oneshot */, false);
+  else
+    poll_timer_ = node_handle.createTimer(ros::Duration(0.1), &GripperForceControl::pollCallback, this);
+  if (stats_rate > 0.0)
+    stats_timer_ = node_handle.createTimer(ros::Duration(1.0 / stats_rate), &GripperForceControl::statsCallback, this);
+
+  ROS_INFO("Inititalized");
+}
+
+void GripperForceControl::commandCallback(const std_msgs::Int16::ConstPtr &msg)
+{
+  // apply new force
+  if (pending_)
+    stats_.coalesced++;
+  force_ = msg->data;
+  force_stamp_ = ros::Time::now();
+  pending_ = true;
+  stats_.received++;
+
+  if (!event_driven_ || interval_armed_)
+    return;
+
+  // hold back until min_interval has passed, commands arriving meanwhile replace the pending one
+  const double wait = min_interval_ - (ros::Time::now() - last_applied_).toSec();
+  if (wait > 0.0)
+  {
+    interval_timer_.stop();
+    interval_timer_.setPeriod(ros::Duration(wait));
+    interval_timer_.start();
+    interval_armed_ = true;
+    return;
+  }
+  applyPending();
+}
+
+void GripperForceControl::pollCallback(const ros::TimerEvent &)
+{
+  applyPending();
+}
+
+void GripperForceControl::intervalCallback(const ros::TimerEvent &)
+{
+  interval_armed_ = false;
+  applyPending();
+}
+
+void GripperForceControl::statsCallback(const ros::TimerEvent &)
+{
+  prosthesis_v7::CommandStatsPtr stats(new prosthesis_v7::CommandStats(stats_));
+  stats->stamp = ros::Time::now();
+  stats_publisher_.publish(stats);
+}
+
+void GripperForceControl::applyPending()
+{
+  if (pending_ && force_ != old_force_)
+  {
+    if (applyForce())
+    {
+      stats_.applied++;
+      stats_.last_latency = (ros::Time::now() - force_stamp_).toSec();
+    }
+    else
+    {
+      stats_.dropped++;
+    }
+
+    ROS_INFO("Currently you apply: %i", force_);
+    old_force_ = force_;
+    last_applied_ = ros::Time::now();
+  }
+  pending_ = false;
+}
+
+bool GripperForceControl::applyForce()
+{
+  bool ok = true;
+  for (int i = 0; i < joints; i++)
+  {
+    ok &= clear_force_client_.call(clear_joint_forces_[i]);
+  }
+
+  // after this, set new forces to the joints
+  for (int i = 0; i < joints; i++)
+  {
+    apply_joint_effort_[i].request.start_time = ros::Time::now();
+    apply_joint_effort_[i].request.effort = force_;
+    ok &= apply_force_client_.call(apply_joint_effort_[i]);
+  }
+  return ok;
+}
+}
@@ -0,0 +1,25 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <gripper_force_control.h>
+
+#include <boost/shared_ptr.hpp>
+
+namespace prosthesis
+{
+/// \brief gripper_forces as a nodelet, takes /gripperforce from MyoControlNodelet in the same manager
+/// without serialization
+class GripperForcesNodelet : public nodelet::Nodelet
+{
+private:
+  virtual void onInit()
+  {
+    // the single threaded node handles never run two callbacks of this nodelet at once
+    control_.reset(new GripperForceControl(getNodeHandle(), getPrivateNodeHandle()));
+  }
+
+  boost::shared_ptr<GripperForceControl> control_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(prosthesis::GripperForcesNodelet, nodelet::Nodelet)
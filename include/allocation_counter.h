@@ -0,0 +1,24 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <stdint.h>
+
+namespace prosthesis
+{
+/// \brief Counts the heap calls (malloc, calloc, realloc, free and the aligned variants) of
+/// the calling thread between start() and stop().
+///
+/// Only binaries linking allocation_counter.cpp count anything: it replaces the
+/// glibc allocator entry points with ones forwarding to glibc. new/delete are
+/// covered because they end up in malloc/free.
+class AllocationCounter
+{
+public:
+  static void start();
+
+  /// \brief stop counting, returns the number of calls since start()
+  static uint64_t stop();
+};
+}
+
+#endif  // ALLOCATION_COUNTER_H
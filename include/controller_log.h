@@ -0,0 +1,137 @@
+#ifndef CONTROLLER_LOG_H
+#define CONTROLLER_LOG_H
+
+#include <pid_bank.h>
+#include <simple_controller_core.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+
+// Binary log of every input GazeboSimpleController consumes, replayable through
+// SimpleControllerCore without Gazebo or ROS. The file is a LogFileHeader followed
+// by records, each a LogRecordHeader and a payload of the struct matching its type.
+// All payloads are plain doubles, so a mapped file can be read in place.
+namespace prosthesis
+{
+enum LogRecordType
+{
+  LOG_PARAMETERS = 1,
+  LOG_GAINS,
+  LOG_POSITION_COMMAND,
+  LOG_VELOCITY_COMMAND,
+  LOG_IMU,
+  LOG_STATE,
+  LOG_TICK,
+  LOG_RESET
+};
+
+struct LogFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct LogRecordHeader
+{
+  uint32_t type;
+  uint32_t size;  // payload bytes following this header
+  double time;    // simulation time
+};
+
+/// \brief LOG_PARAMETERS payload
+struct LogParameters
+{
+  ControllerParameters parameters;
+  double cascade;
+  double has_imu;
+  double has_state;
+  double outer_period;
+};
+
+/// \brief LOG_POSITION_COMMAND and LOG_VELOCITY_COMMAND payload
+struct LogCommand
+{
+  Vector3 linear;
+  Vector3 angular;
+};
+
+/// \brief LOG_TICK payload: the link state read by Update(), the tick's inputs and the resulting wrench
+struct LogTick
+{
+  double dt;
+  double running;
+  Vector3 gravity;
+  LinkSample link;
+  Vector3 force;
+  Vector3 torque;
+};
+
+// LOG_GAINS payload: the number of loops followed by gain_p, gain_i, gain_d, time_constant and limit arrays
+// LOG_IMU payload: ImuSample, LOG_STATE payload: StateSample, LOG_RESET: no payload
+
+class ControllerLogWriter
+{
+public:
+  ControllerLogWriter();
+  ~ControllerLogWriter();
+
+  bool open(const std::string& path);
+  bool isOpen() const;
+  void close();
+
+  void write(LogRecordType type, double time, const void* payload, uint32_t size);
+  void writeGains(double time, const PIDGains& gains);
+
+  template <typename T>
+  void write(LogRecordType type, double time, const T& payload)
+  {
+    write(type, time, &payload, sizeof(payload));
+  }
+
+private:
+  FILE* file_;
+  char* buffer_;
+};
+
+/// \brief Read only memory mapping of a log file
+class ControllerLogReader
+{
+public:
+  ControllerLogReader();
+  ~ControllerLogReader();
+
+  bool open(const std::string& path);
+
+  /// \brief next record or NULL at the end of the log, the payload follows the header. A record
+  /// of a known type whose size does not match its payload ends the log as corrupt, so the
+  /// payload of every record returned can be read as the struct of its type. So does a gain
+  /// table with another number of loops than SimpleControllerCore::CONTROLLER_COUNT.
+  const LogRecordHeader* next();
+
+  /// \brief whether next() stopped at a corrupt record instead of the end of the file
+  bool corrupt() const;
+
+  /// \brief the gain table of a LOG_GAINS record, false (and gains untouched) if it is malformed
+  static bool readGains(const LogRecordHeader* record, PIDGains& gains);
+
+  /// \brief the payload of a record returned by next(), T has to be the struct of its type
+  template <typename T>
+  static const T& payload(const LogRecordHeader* record)
+  {
+    return *reinterpret_cast<const T*>(record + 1);
+  }
+
+private:
+  void unmap();
+
+  const char* data_;
+  std::size_t size_;
+  std::size_t offset_;
+  bool corrupt_;
+};
+}
+
+#endif  // CONTROLLER_LOG_H
@@ -0,0 +1,112 @@
+#ifndef EMG_FEATURES_H
+#define EMG_FEATURES_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Sliding window features of the raw Myo EMG and their mapping to a grip force, free of ROS
+// so recordings can be replayed offline (see emg_replay).
+namespace prosthesis
+{
+/// \brief The Myo armband has 8 EMG electrodes, sampled with 200 Hz
+static const int emg_channels = 8;
+
+/// \brief Range of the Myo's 8 bit EMG samples
+static const int16_t emg_min = -128;
+static const int16_t emg_max = 127;
+
+/// \brief Features of every channel over the current window
+struct EmgFeatures
+{
+  float rms[emg_channels];             // root mean square
+  float mav[emg_channels];             // mean absolute value
+  float zero_crossings[emg_channels];  // sign changes larger than the threshold, per sample of the window
+};
+
+/// \brief Sliding window over the 8 channels of one device.
+///
+/// Samples are kept in a ring, interleaved by channel, so one sample is one SIMD vector of the
+/// 8 channels. push() adds the new sample to the running sums (squares, absolute values, zero
+/// crossings) and removes the one that drops out of the window. The sums are integers, so they
+/// are exact however long the stream runs, and a push costs the same for any window length.
+/// push() clamps the samples to the 8 bit range of the Myo (emg_min..emg_max), the ROS EmgArray
+/// does not enforce it. The sums of squares then hold for windows of up to max_length samples.
+/// Every SIMD path gives the features of sums over the whole window bit for bit,
+/// benchmark/emg_window_check verifies that after changing push().
+class EmgWindow
+{
+public:
+  /// \brief longest window whose int32 sum of squares cannot overflow
+  static const std::size_t max_length = (std::size_t(1) << 17) - 1;
+
+  /// \brief window of length samples (default 200 ms at 200 Hz)
+  explicit EmgWindow(std::size_t length = 40);
+
+  /// \brief empty the window and change its length, 1..max_length
+  void resize(std::size_t length);
+
+  /// \brief add one sample of all channels, clamped to emg_min..emg_max, the oldest one leaves the
+  /// window once it is full
+  void push(const int16_t* sample);
+
+  /// \brief features over the samples in the window, zero while it is empty
+  void features(EmgFeatures& features) const;
+
+  std::size_t length() const;
+  std::size_t size() const;
+
+  /// \brief a sign change only counts as zero crossing if the samples differ by at least this much
+  int32_t threshold;
+
+private:
+  std::vector<int32_t> samples_;    // ring of length * channels, zero where there is no sample yet
+  std::vector<int32_t> crossings_;  // ring of the crossing flags (0/1) each sample added
+  std::size_t length_;
+  std::size_t head_;
+  std::size_t size_;
+
+  // running sums of the window, per channel
+  int32_t sum_square_[emg_channels];
+  int32_t sum_abs_[emg_channels];
+  int32_t sum_crossings_[emg_channels];
+  int32_t previous_[emg_channels];
+};
+
+/// \brief Maps the window features of one device to a grip force.
+///
+/// The activation is the weighted mean of the per channel RMS (or MAV), scaled from rest..full
+/// to 0..1, smoothed and mapped linearly onto open_force..grasp_force.
+struct GripForceMap
+{
+  GripForceMap();
+
+  /// \brief force for the given features, smoothing assumes one call per dt seconds
+  double update(const EmgFeatures& features, double dt);
+
+  bool use_mav;                  // activation from the MAV instead of the RMS
+  float weights[emg_channels];   // channel weights of the activation, normalized by their sum
+  double rest;                   // activation at rest, maps to 0
+  double full;                   // activation of a full grasp, maps to 1
+  double time_constant;          // low pass of the scaled activation [s], 0 disables it
+  double open_force, grasp_force;
+
+  double activation;  // scaled and smoothed activation of the last update
+};
+
+/// \brief One row of an EMG recording
+struct EmgRecordSample
+{
+  double time;
+  int16_t channels[emg_channels];
+};
+
+/// \brief Read a recording with one sample per row, "time c0 .. c7" or "c0 .. c7" separated by
+/// blanks or commas (the Myo Connect export). Without a time column the samples are 5 ms apart.
+/// Channel values are clamped to emg_min..emg_max. Rows that do not parse, like a header, or with a
+/// value that is not finite are skipped. False if the file cannot be read.
+bool readEmgRecording(const std::string& path, std::vector<EmgRecordSample>& samples);
+}
+
+#endif  // EMG_FEATURES_H
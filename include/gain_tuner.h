@@ -0,0 +1,138 @@
+#ifndef GAIN_TUNER_H
+#define GAIN_TUNER_H
+
+#include <rigid_body_plant.h>
+#include <simple_controller_core.h>
+#include <work_stealing_pool.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Offline tuning of the PID gains of SimpleControllerCore against RigidBodyPlant,
+// used by controller_tune.
+namespace prosthesis
+{
+/// \brief Gain set prefix of the plugin's sdf parameters and the loops it configures,
+/// the same grouping as GazeboSimpleController::Load
+struct SdfGainGroup
+{
+  const char* prefix;
+  int first;
+  int second;  // -1 for groups of one loop
+};
+
+extern const SdfGainGroup sdf_gain_groups[];
+extern const std::size_t sdf_gain_group_count;
+
+/// \brief read the <prefix>ProportionalGain ... <prefix>Limit elements of every group from sdf text,
+/// elements missing in the text keep their value in gains. Returns the number of elements found.
+std::size_t readSdfGains(const std::string& sdf, PIDGains& gains);
+
+/// \brief write every group as sdf elements, ready to paste into the plugin element
+void writeSdfGains(FILE* file, const PIDGains& gains);
+
+/// \brief Commands held for a while, position/attitude commands for the position cascade and
+/// velocity/yaw rate commands for the velocity cascade
+struct TuningSegment
+{
+  double duration;
+  Vector3 linear;
+  Vector3 angular;
+};
+
+struct TuningProblem
+{
+  SimpleControllerCore::Cascade cascade;
+  ControllerParameters parameters;
+  double outer_period;
+  PlantParameters plant;
+  double dt;
+
+  Vector3 start_position;
+  std::vector<TuningSegment> segments;
+
+  double attitude_weight;   // weight of squared angle (rate) errors against squared position (velocity) errors
+  double effort_weight;     // weight of the squared accelerations the wrench commands
+  double divergence_bound;  // an error beyond this ends the run as diverged
+};
+
+/// \brief steps on every axis from a hover at start_position, then back, for the given cascade
+TuningProblem makeStepProblem(SimpleControllerCore::Cascade cascade, const ControllerParameters& parameters);
+
+struct TuningScore
+{
+  double cost;      // tracking + effort_weight * effort, or above divergence_cost if diverged
+  double tracking;  // mean squared tracking error
+  double effort;    // mean squared commanded acceleration
+  bool diverged;
+};
+
+/// \brief cost of every diverged run, runs diverging earlier cost up to twice as much
+static const double divergence_cost = 1e6;
+
+/// \brief run the controller with gains against the plant through all segments of the problem
+TuningScore evaluateGains(const TuningProblem& problem, const PIDGains& gains);
+
+struct GainSearchOptions
+{
+  std::size_t candidates;  // gain sets evaluated per generation
+  double elite_fraction;   // share of a generation the distribution is refit to
+  double range;            // every gain is searched within [initial / range, initial * range]
+  double smoothing;        // weight of the refit distribution against the previous one
+  unsigned long seed;
+};
+
+GainSearchOptions makeGainSearchOptions();
+
+/// \brief Cross-entropy search over the logarithms of the P/I/D gains.
+///
+/// Each generation samples candidates from a normal distribution per gain,
+/// evaluates all of them on the pool and refits the distribution to the best
+/// ones. Only gains of loops the cascade uses and that are positive in the
+/// initial set are searched, time constants and limits are kept. The
+/// candidates are drawn on the calling thread, so the result does not depend
+/// on the number of threads.
+class GainSearch
+{
+public:
+  GainSearch(const TuningProblem& problem, const PIDGains& initial, const GainSearchOptions& options);
+
+  /// \brief evaluate one generation, returns the best score so far
+  const TuningScore& step(WorkStealingPool& pool);
+
+  std::size_t dimensions() const;
+  std::size_t generation() const;
+  const TuningScore& initialScore() const;
+  const TuningScore& bestScore() const;
+  const PIDGains& best() const;
+
+private:
+  struct Dimension
+  {
+    int group;
+    int term;  // 0 = P, 1 = I, 2 = D
+    double initial, mean, deviation;
+  };
+
+  void apply(const double* x, PIDGains& gains) const;
+
+  TuningProblem problem_;
+  GainSearchOptions options_;
+  std::vector<Dimension> dimensions_;
+  std::mt19937_64 random_;
+  std::size_t generation_;
+
+  std::vector<double> samples_;  // candidates x dimensions
+  std::vector<PIDGains> candidates_;
+  std::vector<TuningScore> scores_;
+
+  PIDGains best_;
+  TuningScore initial_score_;
+  TuningScore best_score_;
+};
+}
+
+#endif  // GAIN_TUNER_H
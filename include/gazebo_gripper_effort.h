@@ -0,0 +1,48 @@
+#ifndef GAZEBO_GRIPPER_EFFORT_H
+#define GAZEBO_GRIPPER_EFFORT_H
+
+#include <gazebo/common/Plugin.hh>
+
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+
+#include <std_msgs/Int16.h>
+
+#include <string>
+#include <vector>
+
+namespace gazebo
+{
+class GazeboGripperEffort : public ModelPlugin
+{
+public:
+  GazeboGripperEffort();
+  virtual ~GazeboGripperEffort();
+
+protected:
+  virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+  virtual void Update();
+  virtual void Reset();
+
+private:
+  /// \brief The gripper joints the effort is applied to
+  std::vector<physics::JointPtr> joints_;
+
+  ros::NodeHandle* node_handle_;
+  ros::CallbackQueue callback_queue_;
+  ros::Subscriber force_subscriber_;
+
+  void ForceCallback(const std_msgs::Int16ConstPtr&);
+
+  std::string namespace_;
+  std::string force_topic_;
+  std::string joint_names_;
+
+  /// \brief Effort currently applied to every gripper joint
+  double effort_;
+
+  event::ConnectionPtr updateConnection;
+};
+}
+
+#endif  // GAZEBO_GRIPPER_EFFORT_H
@@ -10,11 +10,31 @@
 #include <nav_msgs/Odometry.h>
 #include <sensor_msgs/Imu.h>
 #include <std_srvs/Empty.h>
+#include <prosthesis_v7/ControllerTelemetry.h>
+#include <prosthesis_v7/GetControllerProfile.h>
+#include <prosthesis_v7/SetGains.h>
+#include <prosthesis_v7/TracedTwist.h>
 
 #include <update_timer.h>
 
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <mailbox.h>
+#include <controller_log.h>
+#include <pid_bank.h>
+#include <profiling.h>
+#include <setpoint_predictor.h>
+#include <shared_command.h>
+#include <simple_controller_core.h>
+#include <spsc_ring.h>
+
+#include <atomic>
+
 namespace gazebo
 {
+class SimpleControllerManager;
+
 class GazeboSimpleController : public ModelPlugin
 {
 public:
@@ -27,6 +47,20 @@ protected:
   virtual void Reset();
 
 private:
+  friend class SimpleControllerManager;
+
+  // the steps of Update(), also run by the SimpleControllerManager for batched instances. They are
+  // written not to make heap calls once the first ticks are done: messages, gains and the telemetry
+  // ring are preallocated and reused, everything that may allocate (publishing, logging) happens on
+  // the callback queue and telemetry threads. tick_allocation_check runs these steps but the
+  // Gazebo link calls (mailboxes incl. TracedTwist, setpoint prediction, core, log, ControllerSample
+  // push and trace stages) on synthetic inputs and fails on any heap call after its warm-up,
+  // controller_replay --check-allocations does the same for the core on a recorded log.
+  bool ReadInputs(double time);
+  void PrepareTick(double dt);
+  void FinishTick(const common::Time& sim_time, double dt, const prosthesis::ControllerOutput& output);
+  void ApplyWrench();
+
   /// \brief The parent World
   physics::WorldPtr world;
 
@@ -37,42 +71,79 @@ private:
   ros::CallbackQueue callback_queue_;
   ros::Subscriber velocity_subscriber_;
   ros::Subscriber position_subscriber_;
+  ros::Subscriber traced_position_subscriber_;
   ros::Subscriber imu_subscriber_;
   ros::Subscriber state_subscriber_;
   ros::Publisher wrench_publisher_;
   ros::Publisher link_velocity_publisher_;
   ros::Publisher desired_velocity_publisher_;
+  ros::Publisher telemetry_publisher_;
 
-  ros::Subscriber _reconfigure_subscriber;
-
+  ros::ServiceServer gains_service_server_;
   ros::ServiceServer engage_service_server_;
   ros::ServiceServer shutdown_service_server_;
 
-  // void CallbackQueueThread();
-  // boost::mutex lock_;
-  // boost::thread callback_queue_thread_;
+  /// \brief Runs all ROS callbacks, so the physics thread spends no time on ROS I/O
+  void CallbackQueueThread();
+  boost::thread callback_queue_thread_;
+
+  /// \brief Publishes the samples queued by Update(), so no message is built or serialized on the physics thread
+  void TelemetryThread();
+  void PublishTelemetry();
+  boost::thread telemetry_thread_;
+  prosthesis_v7::ControllerTelemetry telemetry_;
+  prosthesis::SpscRing<prosthesis_v7::ControllerSample> telemetry_ring_;
+  std::atomic<uint64_t> telemetry_dropped_;
+
+  // written by the callback queue thread, read by Update() without locking
+  prosthesis::Mailbox<prosthesis_v7::TracedTwist> position_mailbox_;
+  prosthesis::Mailbox<geometry_msgs::Twist> velocity_mailbox_;
+  prosthesis::Mailbox<prosthesis::ImuSample> imu_mailbox_;
+  prosthesis::Mailbox<prosthesis::StateSample> state_mailbox_;
+  prosthesis::Mailbox<prosthesis::PIDGains> gains_mailbox_;
 
-  geometry_msgs::Twist velocity_command_;
-  geometry_msgs::Twist position_command_;
-  geometry_msgs::Twist controller_callback_;
   geometry_msgs::Twist real_velocity_;
-  void ControllerCallback(const geometry_msgs::TwistConstPtr&);
   void PositionCallback(const geometry_msgs::TwistConstPtr&);
+  void TracedPositionCallback(const prosthesis_v7::TracedTwistConstPtr&);
   void VelocityCallback(const geometry_msgs::TwistConstPtr&);
   void ImuCallback(const sensor_msgs::ImuConstPtr&);
   void StateCallback(const nav_msgs::OdometryConstPtr&);
 
+  bool GainsCallback(prosthesis_v7::SetGains::Request&, prosthesis_v7::SetGains::Response&);
   bool EngageCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
   bool ShutdownCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
 
+  // owned by the callback queue thread
   ros::Time state_stamp;
-#if (GAZEBO_MAJOR_VERSION >= 8)
-  ignition::math::Pose3d pose;
-  ignition::math::Vector3d euler, velocity, acceleration, angular_velocity;
-#else
-  math::Pose pose;
-  math::Vector3 euler, velocity, acceleration, angular_velocity, angular_accelaration;
-#endif
+  /// \brief arrival of the last traced position command, the plain ones are skipped while they come
+  ros::WallTime traced_position_stamp_;
+  prosthesis::StateSample state_;
+  /// \brief Gain table edited by GainsCallback, handed to Update() as a whole through gains_mailbox_
+  prosthesis::PIDGains shadow_gains_;
+
+  /// \brief State and commands the controller works on, assembled from the mailboxes and the link
+  prosthesis::ControllerInput input_;
+  prosthesis::LinkSample link_state_;
+
+  /// \brief Records every input consumed by Update() if a recordFile is given
+  prosthesis::ControllerLogWriter log_;
+
+  /// \brief Position commands written by myo_control_node to shared memory, read by Update() directly.
+  /// While they are younger than shared_command_timeout_ the position topic is ignored.
+  prosthesis::SharedCommandReader shared_command_;
+  double shared_command_stamp_;
+
+  /// \brief Continues the orientation of the position commands between their arrivals, so every tick
+  /// gets a fresh setpoint. Disabled while its horizon is 0.
+  prosthesis::SetpointPredictor setpoint_predictor_;
+
+  /// \brief Stage tracing (trace_file): the stages of the traced position commands go to the trace of
+  /// the process, which the first instance with a trace_file opens and flushes
+  bool owns_trace_;
+  ros::WallTime trace_last_flush_;
+  // trace ids of the command applied since the last tick and of the one whose wrench is due, 0 if none
+  uint32_t applied_trace_;
+  uint32_t wrench_trace_;
 
   std::string link_name_;
   std::string namespace_;
@@ -83,58 +154,32 @@ private:
   std::string imu_topic_;
   std::string state_topic_;
   std::string wrench_topic_;
-  std::string reconfigure_topic_;
+  std::string gains_service_;
+  std::string telemetry_topic_;
+  std::string record_file_;
+  std::string shared_command_name_;
+  std::string trace_file_;
+  std::string traced_position_topic_;
+  double shared_command_timeout_;
+  int telemetry_decimation_;
+  int telemetry_buffer_size_;
   double max_force_;
   double max_torque_;
+  double outer_update_period_;
 
-  bool running_;
+  std::atomic<bool> running_;
+  std::atomic<bool> auto_engaged_;
+  bool tick_running_;
   bool auto_engage_;
+  bool batched_;
 
-  class PIDController
-  {
-  public:
-    PIDController();
-    virtual ~PIDController();
-    virtual void Load(sdf::ElementPtr _sdf, const std::string& prefix = "");
-
-    double gain_p;
-    double gain_i;
-    double gain_d;
-    double time_constant;
-    double limit;
-
-    double input;
-    double dinput;
-    double output;
-    double p, i, d;
-
-    double update(double input, double x, double dx, double dt);
-    void updateGains(double gain_p, double gain_i, double gain_d, double time_constant);
-    void reset();
-  };
+  /// \brief Steps this instance together with the other batched ones of the world, NULL if not batched
+  boost::shared_ptr<SimpleControllerManager> manager_;
 
-  struct Controllers
-  {
-    PIDController roll_vel;
-    PIDController pitch_vel;
-    PIDController yaw_vel;
-    PIDController roll;
-    PIDController pitch;
-    PIDController yaw;
-    PIDController velocity_x;
-    PIDController velocity_y;
-    PIDController velocity_z;
-    PIDController position_x;
-    PIDController position_y;
-    PIDController position_z;
-  } controllers_;
+  void LoadController(sdf::ElementPtr _sdf, int controller, const std::string& prefix);
 
-#if (GAZEBO_MAJOR_VERSION >= 8)
-  ignition::math::Vector3d inertia;
-#else
-  math::Vector3 inertia;
-#endif
-  double mass;
+  /// \brief The control law, free of any Gazebo types, unused by batched instances
+  prosthesis::SimpleControllerCore core_;
 
 #if (GAZEBO_MAJOR_VERSION >= 8)
   ignition::math::Vector3d force, torque;
@@ -144,6 +189,33 @@ private:
 
   UpdateTimer controlTimer;
   event::ConnectionPtr updateConnection;
+
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+  /// \brief Timed phases, each histogram is written by one thread only
+  enum ProfilePhase
+  {
+    PROFILE_UPDATE,        // Update() as a whole (physics thread)
+    PROFILE_READ_INPUTS,   // mailbox take-over and recording (physics thread)
+    PROFILE_PREPARE_TICK,  // link state and engage logic (physics thread)
+    PROFILE_CASCADE,       // control law (physics thread)
+    PROFILE_FINISH_TICK,   // recording and telemetry queueing (physics thread)
+    PROFILE_APPLY_WRENCH,  // force and torque into gazebo (physics thread)
+    PROFILE_CALLBACKS,     // every ROS callback (callback queue thread)
+    PROFILE_PUBLISH,       // publishing one telemetry sample (telemetry thread)
+    PROFILE_PHASE_COUNT
+  };
+  prosthesis::LatencyHistogram profile_[PROFILE_PHASE_COUNT];
+
+  /// \brief Fills a profile message from the histograms, safe from any thread
+  void FillProfile(prosthesis_v7::ControllerProfile& profile);
+  bool ProfileCallback(prosthesis_v7::GetControllerProfile::Request&, prosthesis_v7::GetControllerProfile::Response&);
+
+  std::string profile_topic_;
+  double profile_period_;
+  ros::WallTime profile_last_publish_;
+  ros::Publisher profile_publisher_;
+  ros::ServiceServer profile_service_server_;
+#endif
 };
 }
 
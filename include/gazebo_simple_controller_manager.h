@@ -0,0 +1,78 @@
+#ifndef GAZEBO_SIMPLE_CONTROLLER_MANAGER_H
+#define GAZEBO_SIMPLE_CONTROLLER_MANAGER_H
+
+#include <gazebo/common/Plugin.hh>
+
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+
+#include <update_timer.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include <simple_controller_batch.h>
+
+#include <atomic>
+#include <vector>
+
+namespace gazebo
+{
+class GazeboSimpleController;
+
+/// \brief Steps all batched GazeboSimpleController instances of one world and cascade together.
+///
+/// Instead of one world update connection, callback queue thread and telemetry
+/// thread per model, the manager connects once, serves the ROS callbacks of all
+/// its instances from one thread, publishes their telemetry from another and
+/// runs their control laws in one SimpleControllerBatch per control tick. What
+/// is saved per model is the update event and the threads, the batched control
+/// law itself costs about as much as the core (see SimpleControllerBatch), so
+/// batching stays opt-in. The instances hold a reference to the manager, it
+/// lives as long as the last of them.
+class SimpleControllerManager
+{
+public:
+  /// \brief manager of the given world and cascade (position or velocity), created on first use
+  static boost::shared_ptr<SimpleControllerManager> Get(physics::WorldPtr world,
+                                                        prosthesis::SimpleControllerCore::Cascade cascade);
+
+  ~SimpleControllerManager();
+
+  /// \brief add a loaded controller, the first one also configures the control timer
+  void Register(GazeboSimpleController* controller, sdf::ElementPtr sdf);
+  void Unregister(GazeboSimpleController* controller);
+
+  /// \brief reset the attitude and velocity loops of a controller
+  void Reset(GazeboSimpleController* controller);
+
+  /// \brief queue the batched instances subscribe and advertise on
+  ros::CallbackQueue* GetCallbackQueue();
+
+private:
+  SimpleControllerManager(physics::WorldPtr world, prosthesis::SimpleControllerCore::Cascade cascade);
+
+  void Update();
+  void CallbackQueueThread();
+  void TelemetryThread();
+  std::size_t Find(GazeboSimpleController* controller) const;
+
+  physics::WorldPtr world;
+
+  /// \brief Guards the instances and the batch, shared by Update() and the telemetry thread
+  boost::shared_mutex mutex_;
+  std::vector<GazeboSimpleController*> controllers_;
+  prosthesis::SimpleControllerBatch batch_;
+
+  ros::CallbackQueue callback_queue_;
+  boost::thread callback_queue_thread_;
+  boost::thread telemetry_thread_;
+  std::atomic<bool> stop_;
+
+  UpdateTimer controlTimer;
+  event::ConnectionPtr updateConnection;
+};
+}
+
+#endif  // GAZEBO_SIMPLE_CONTROLLER_MANAGER_H
@@ -0,0 +1,69 @@
+#ifndef GRIPPER_FORCE_CONTROL_H
+#define GRIPPER_FORCE_CONTROL_H
+
+#include <ros/ros.h>
+
+#include <gazebo_msgs/ApplyJointEffort.h>
+#include <gazebo_msgs/JointRequest.h>
+#include <prosthesis_v7/CommandStats.h>
+#include <std_msgs/Int16.h>
+
+namespace prosthesis
+{
+/// \brief Applies the forces commanded on /gripperforce to the gripper joints through the
+/// gazebo joint effort services.
+///
+/// Used by the gripper_forces executable and the prosthesis_v7/GripperForces nodelet, with
+/// the same threading requirements as MyoControl. In a nodelet manager with MyoControl the
+/// commands arrive as the published pointer, without serialization.
+class GripperForceControl
+{
+public:
+  /// \brief subscribe and connect the services on node_handle, the parameters are read from private_handle
+  GripperForceControl(ros::NodeHandle node_handle, ros::NodeHandle private_handle);
+
+private:
+  // called quite frequently (~10 Hz)
+  void commandCallback(const std_msgs::Int16::ConstPtr &msg);
+
+  void pollCallback(const ros::TimerEvent &);
+  void intervalCallback(const ros::TimerEvent &);
+  void statsCallback(const ros::TimerEvent &);
+
+  /// \brief apply the pending command if it differs from the applied one
+  void applyPending();
+
+  /// \brief as the service is cumulative, first clear all active forces on the joints and then set the new ones
+  bool applyForce();
+
+  ros::ServiceClient clear_force_client_;
+  ros::ServiceClient apply_force_client_;
+  ros::Subscriber command_subscriber_;
+  ros::Publisher stats_publisher_;
+
+  ros::Timer poll_timer_;
+  ros::Timer interval_timer_;
+  ros::Timer stats_timer_;
+
+  // Because we have three different joints at the gripper, we need to define 3 different messages (name is different)
+  static const int joints = 3;
+  gazebo_msgs::ApplyJointEffort apply_joint_effort_[joints];
+  gazebo_msgs::JointRequest clear_joint_forces_[joints];
+
+  int force_, old_force_;
+
+  // newest command that has not been applied yet, older ones are overwritten (coalesced)
+  bool pending_;
+  ros::Time force_stamp_;
+  ros::Time last_applied_;
+  prosthesis_v7::CommandStats stats_;
+
+  // event_driven: apply a command as soon as it arrives instead of polling at 10 Hz,
+  // min_interval: minimum time between two applications, newer commands are coalesced meanwhile
+  bool event_driven_;
+  double min_interval_;
+  bool interval_armed_;
+};
+}
+
+#endif  // GRIPPER_FORCE_CONTROL_H
@@ -0,0 +1,113 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+namespace prosthesis
+{
+/// \brief Log-linear histogram of durations in nanoseconds for one writer thread and any number of readers.
+///
+/// Each power of two is split into 8 linear buckets, so a bucket is at most
+/// 12.5% wide relative to its values over the whole uint64 range. record()
+/// is a handful of relaxed atomic loads and stores, it never blocks or
+/// allocates. Readers see every counter consistently on its own, a snapshot
+/// taken while recording may be off by the samples recorded meanwhile.
+class LatencyHistogram
+{
+public:
+  static const int sub_bucket_bits = 3;
+  static const int sub_bucket_count = 1 << sub_bucket_bits;
+  static const std::size_t bucket_count = sub_bucket_count * (64 - sub_bucket_bits + 1);
+
+  LatencyHistogram() : count_(0), sum_(0), max_(0)
+  {
+    for (std::size_t k = 0; k < bucket_count; k++)
+      buckets_[k].store(0, std::memory_order_relaxed);
+  }
+
+  /// \brief writer side
+  void record(uint64_t nanoseconds)
+  {
+    std::atomic<uint64_t>& bucket = buckets_[bucketIndex(nanoseconds)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+    if (nanoseconds > max_.load(std::memory_order_relaxed))
+      max_.store(nanoseconds, std::memory_order_relaxed);
+  }
+
+  uint64_t count() const
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t sum() const
+  {
+    return sum_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t max() const
+  {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t bucket(std::size_t k) const
+  {
+    return buckets_[k].load(std::memory_order_relaxed);
+  }
+
+  /// \brief smallest value of bucket k
+  static uint64_t bucketLowerBound(std::size_t k)
+  {
+    if (k < static_cast<std::size_t>(sub_bucket_count))
+      return k;
+    const int shift = (k >> sub_bucket_bits) - 1;
+    return static_cast<uint64_t>(sub_bucket_count + (k & (sub_bucket_count - 1))) << shift;
+  }
+
+  /// \brief largest value of bucket k
+  static uint64_t bucketUpperBound(std::size_t k)
+  {
+    return k + 1 < bucket_count ? bucketLowerBound(k + 1) - 1 : UINT64_MAX;
+  }
+
+  static std::size_t bucketIndex(uint64_t value)
+  {
+    if (value < static_cast<uint64_t>(sub_bucket_count))
+      return value;
+    const int shift = 63 - __builtin_clzll(value) - sub_bucket_bits;
+    return ((shift + 1) << sub_bucket_bits) + ((value >> shift) & (sub_bucket_count - 1));
+  }
+
+  /// \brief upper bound of the bucket holding the given fraction (0..1) of the samples, 0 if empty
+  uint64_t percentile(double fraction) const
+  {
+    uint64_t total = 0;
+    for (std::size_t k = 0; k < bucket_count; k++)
+      total += bucket(k);
+    if (total == 0)
+      return 0;
+    uint64_t rank = static_cast<uint64_t>(fraction * total + 0.5);
+    if (rank < 1)
+      rank = 1;
+    uint64_t seen = 0;
+    for (std::size_t k = 0; k < bucket_count; k++)
+    {
+      seen += bucket(k);
+      if (seen >= rank)
+        return bucketUpperBound(k) < max() ? bucketUpperBound(k) : max();
+    }
+    return max();
+  }
+
+private:
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+  std::atomic<uint64_t> buckets_[bucket_count];
+};
+}
+
+#endif  // LATENCY_HISTOGRAM_H
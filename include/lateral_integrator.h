@@ -0,0 +1,53 @@
+#ifndef LATERAL_INTEGRATOR_H
+#define LATERAL_INTEGRATOR_H
+
+#include <quaternion_math.h>
+
+namespace prosthesis
+{
+/// \brief Integrates lateral velocity commands into a position over the time that really
+/// passed, independent of how often the commands arrive.
+///
+/// Every command is held until the next one (zero order hold), but for at most
+/// timeout seconds, so a silent input stops the motion. command() closes the
+/// segment of the previous command, advance() brings the position up to date.
+/// Every segment is clamped to the bounds on its own, so the position does not
+/// depend on how often advance() is called.
+class LateralIntegrator
+{
+public:
+  LateralIntegrator();
+
+  /// \brief take a new velocity command received at time (seconds)
+  void command(const Vector3& velocity, double time);
+
+  /// \brief integrate up to time, returns the bounded position
+  const Vector3& advance(double time);
+
+  const Vector3& position() const;
+
+  /// \brief whether the held command still moves the position after time
+  bool moving(double time) const;
+
+  /// \brief end of the hold of the current command, infinity if it is held forever
+  double holdEnd() const;
+
+  /// \brief velocity is scaled by gain, position units per input unit and second
+  double gain;
+  /// \brief longest time a command is held without a newer one, <= 0 holds forever
+  double timeout;
+  /// \brief bounds of the position per axis
+  Vector3 lower, upper;
+
+private:
+  void integrate(double time);
+
+  Vector3 velocity_;
+  Vector3 position_;
+  double stamp_;             // time of the held command
+  double integrated_until_;  // position_ includes the held command up to here
+  bool has_command_;
+};
+}
+
+#endif  // LATERAL_INTEGRATOR_H
@@ -0,0 +1,70 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <atomic>
+
+namespace prosthesis
+{
+/// \brief Wait-free single writer/single reader mailbox holding the latest value (triple buffer).
+///
+/// The writer fills back() and calls publish(), the reader calls update() and
+/// then uses read(). Neither side ever blocks or allocates, the reader always
+/// sees a complete value and values published between two update() calls are
+/// replaced by the newest one.
+template <typename T>
+class Mailbox
+{
+public:
+  Mailbox() : front_(0), back_(2), middle_(1)
+  {
+  }
+
+  /// \brief writer side: buffer to fill before publish()
+  T& back()
+  {
+    return buffers_[back_];
+  }
+
+  /// \brief writer side: hand the back buffer over to the reader
+  void publish()
+  {
+    back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  /// \brief writer side: publish a copy of value
+  void write(const T& value)
+  {
+    back() = value;
+    publish();
+  }
+
+  /// \brief reader side: take over the newest published value, returns false if there is none
+  bool update()
+  {
+    if (!(middle_.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  /// \brief reader side: value taken over by the last successful update()
+  const T& read() const
+  {
+    return buffers_[front_];
+  }
+
+private:
+  enum
+  {
+    INDEX = 3,
+    FRESH = 4
+  };
+
+  T buffers_[3];
+  unsigned front_;
+  unsigned back_;
+  std::atomic<unsigned> middle_;
+};
+}
+
+#endif  // MAILBOX_H
@@ -0,0 +1,92 @@
+#ifndef MYO_CONTROL_H
+#define MYO_CONTROL_H
+
+#include <ros/ros.h>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/Twist.h>
+#include <myo_control_core.h>
+#include <prosthesis_v7/TracedTwist.h>
+#include <ros_myo/MyoPose.h>
+#include <shared_command.h>
+
+namespace prosthesis
+{
+/// \brief Combines the Myo pose, the Myo gestures and the lateral input into the prosthesis
+/// commands /cmd_pos and /gripperforce. The commands are computed by MyoControlCore, this
+/// class adds the topics and decides when to publish.
+///
+/// Used by the myo_control_node executable and the prosthesis_v7/MyoControl nodelet. All
+/// callbacks run on the queue of the given node handle, which has to call them one at a
+/// time (ros::spin() or a nodelet's single threaded node handle). Every message is
+/// published as a new shared pointer, so nodelets in the same manager receive it without
+/// a copy or serialization.
+class MyoControl
+{
+public:
+  /// \brief subscribe and advertise on node_handle, the parameters are read from private_handle
+  MyoControl(ros::NodeHandle node_handle, ros::NodeHandle private_handle);
+  ~MyoControl();
+
+private:
+  void poseCallback(const geometry_msgs::PoseStamped::ConstPtr &pose);
+  void lateralCallback(const geometry_msgs::Twist::ConstPtr &input);
+  void fistCallback(const ros_myo::MyoPose::ConstPtr &pose);
+  void lateralTimerCallback(const ros::WallTimerEvent &);
+
+  /// \brief wake up at the next rate cap step while the held lateral command still moves
+  void armLateralTimer(double now);
+
+  /// \brief publish the current state, only the parts that are requested
+  void publishState(bool send_twist, bool send_force);
+
+  /// \brief hand a changed twist to the shared memory at once and to the topic when due
+  void twistChanged();
+
+  /// \brief in event driven mode, publish the changed parts now or when the rate cap allows it
+  void publishChanged();
+
+  void periodicCallback(const ros::TimerEvent &);
+  void rateCapCallback(const ros::WallTimerEvent &);
+  void keepaliveCallback(const ros::WallTimerEvent &);
+  void traceCallback(const ros::WallTimerEvent &);
+
+  ros::Publisher twist_publisher_;
+  ros::Publisher force_publisher_;
+  ros::Subscriber lateral_subscriber_;
+  ros::Subscriber pose_subscriber_;
+  ros::Subscriber fist_subscriber_;
+
+  ros::Timer periodic_timer_;
+  ros::WallTimer rate_cap_timer_;
+  ros::WallTimer keepalive_timer_;
+  ros::WallTimer lateral_timer_;
+
+  /// \brief the command, its lateral input is integrated with the parameters lateral_gain,
+  /// lateral_nominal_rate, lateral_timeout, lateral_min and lateral_max
+  MyoControlCore core_;
+
+  // set by the callbacks whenever the published state changed, used in event driven mode
+  bool twist_changed_;
+  bool force_changed_;
+
+  bool event_driven_;
+  ros::WallDuration min_period_;
+  ros::WallTime last_publish_;
+  bool rate_cap_armed_;
+
+  /// \brief Optional shared memory path to GazeboSimpleController (parameter shared_command),
+  /// written on every change in addition to the /cmd_pos publishing
+  SharedCommandWriter shared_command_;
+
+  /// \brief Stage tracing (parameter trace_file): the stages of every pose go to the trace file
+  /// and each /cmd_pos is also published with the trace of its pose on /cmd_pos_traced
+  ros::Publisher traced_twist_publisher_;
+  ros::WallTimer trace_timer_;
+  /// \brief trace of the pose that last changed the orientation command
+  prosthesis_v7::TraceStamp trace_;
+  bool owns_trace_;
+};
+}
+
+#endif  // MYO_CONTROL_H
@@ -0,0 +1,64 @@
+#ifndef MYO_CONTROL_CORE_H
+#define MYO_CONTROL_CORE_H
+
+#include <lateral_integrator.h>
+#include <quaternion_math.h>
+#include <relative_orientation.h>
+
+// The command logic of myo_control_node without ROS, so it can be instantiated per armband,
+// replayed and benchmarked (see benchmark/myo_control_core_benchmark.cpp).
+namespace prosthesis
+{
+/// \brief Gestures reported by the Myo (ros_myo/MyoPose)
+enum MyoGesture
+{
+  MYO_REST = 1,
+  MYO_FIST = 2,
+};
+
+/// \brief Turns the Myo pose, the lateral input and the gestures into the prosthesis command:
+/// a position (linear), an orientation (angular, roll/pitch/yaw) and a grip force.
+///
+/// Every input returns whether it changed the command, so the caller can publish on change.
+/// Not thread safe, one instance per armband.
+class MyoControlCore
+{
+public:
+  MyoControlCore();
+
+  /// \brief the next pose becomes the reference of the orientation, the lateral position is kept
+  void reset();
+
+  /// \brief new armband orientation, the command is its rotation relative to the reference
+  bool pose(const Quaternion& orientation);
+
+  /// \brief new lateral velocity input received at time (seconds), integrated by updateLateral()
+  void lateralInput(const Vector3& velocity, double time);
+
+  /// \brief integrate the lateral input up to time into the position
+  bool updateLateral(double time);
+
+  /// \brief a fist grasps, rest opens, other gestures keep the grip
+  bool gesture(int gesture);
+
+  const Vector3& linear() const;
+  const Vector3& angular() const;
+  bool grasp() const;
+  /// \brief grip force of the current grasp state
+  int force() const;
+
+  /// \brief integration of the lateral input (gain, timeout, bounds)
+  LateralIntegrator lateral;
+  int grasp_force;
+  int open_force;
+
+private:
+  RelativeOrientation orientation_;
+  bool reset_;
+  Vector3 linear_;
+  Vector3 angular_;
+  bool grasp_;
+};
+}
+
+#endif  // MYO_CONTROL_CORE_H
@@ -0,0 +1,59 @@
+#ifndef MYO_EMG_CONTROL_H
+#define MYO_EMG_CONTROL_H
+
+#include <ros/ros.h>
+
+#include <emg_features.h>
+#include <latency_histogram.h>
+#include <prosthesis_v7/CommandStats.h>
+#include <ros_myo/EmgArray.h>
+
+#include <string>
+#include <vector>
+
+namespace prosthesis
+{
+/// \brief Turns the raw 8 channel EMG of one or more Myo armbands (200 Hz each) into a
+/// continuous grip force on /gripperforce, instead of the fist/rest gesture of MyoControl.
+///
+/// Every sample is pushed into the sliding window of its device as it arrives, so the
+/// work per sample is constant and a core keeps up with many devices. Every decimation
+/// samples the window features are mapped to a force, which is published when it changed.
+/// Run it with myo_control_node's publish_force set to false, so only one node commands
+/// the gripper. Used by the myo_emg_control_node executable and the prosthesis_v7/MyoEmgControl
+/// nodelet, with the same threading requirements as MyoControl.
+class MyoEmgControl
+{
+public:
+  /// \brief subscribe and advertise on node_handle, the parameters are read from private_handle
+  MyoEmgControl(ros::NodeHandle node_handle, ros::NodeHandle private_handle);
+
+private:
+  struct Device
+  {
+    ros::Subscriber subscriber;
+    ros::Publisher force_publisher;
+    EmgWindow window;
+    GripForceMap map;
+    unsigned int pending;  // samples since the last force update
+    int published_force;
+    bool has_published;
+  };
+
+  void emgCallback(const ros_myo::EmgArray::ConstPtr &emg, std::size_t device);
+  void statsCallback(const ros::TimerEvent &);
+
+  /// \brief one entry per device, never resized after the subscriptions are made
+  std::vector<Device> devices_;
+  unsigned int decimation_;
+  double sample_period_;
+
+  ros::Publisher stats_publisher_;
+  ros::Timer stats_timer_;
+  prosthesis_v7::CommandStats stats_;
+  /// \brief time spent in emgCallback, reported with the stats
+  LatencyHistogram callback_time_;
+};
+}
+
+#endif  // MYO_EMG_CONTROL_H
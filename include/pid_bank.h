@@ -0,0 +1,57 @@
+#ifndef PID_BANK_H
+#define PID_BANK_H
+
+#include <cstddef>
+#include <vector>
+
+namespace prosthesis
+{
+/// \brief Gains of a set of PID loops, stored as one contiguous array per parameter
+struct PIDGains
+{
+  std::vector<double> gain_p;
+  std::vector<double> gain_i;
+  std::vector<double> gain_d;
+  std::vector<double> time_constant;
+  std::vector<double> limit;
+
+  void resize(std::size_t n);
+  std::size_t size() const;
+  void set(std::size_t k, double gain_p, double gain_i, double gain_d, double time_constant);
+};
+
+/// \brief State of a set of PID loops (structure of arrays).
+///
+/// update() steps a contiguous range of loops in one pass with AVX or SSE2
+/// when the build enables them and a scalar loop otherwise. All paths evaluate
+/// the same expressions in the same order as the former
+/// GazeboSimpleController::PIDController::update, so the results are bit
+/// identical to it (benchmark/pid_bank_check compares the two). Only a build
+/// that contracts mul/add into FMA (-mfma -ffp-contract=fast) may differ, by
+/// rounding of the fused products.
+class PIDBank
+{
+public:
+  explicit PIDBank(std::size_t n = 0);
+
+  void resize(std::size_t n);
+  std::size_t size() const;
+
+  /// \brief step loops [begin, end), element j of the input arrays belongs to loop begin + j
+  void update(const PIDGains& gains, std::size_t begin, std::size_t end, const double* new_input, const double* x,
+              const double* dx, double dt);
+
+  /// \brief step a single loop, returns its output
+  double update(const PIDGains& gains, std::size_t k, double new_input, double x, double dx, double dt);
+
+  void reset(std::size_t begin, std::size_t end);
+  void reset();
+
+  std::vector<double> input;
+  std::vector<double> dinput;
+  std::vector<double> output;
+  std::vector<double> p, i, d;
+};
+}
+
+#endif  // PID_BANK_H
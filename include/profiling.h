@@ -0,0 +1,54 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+
+// Scoped timers for the hot paths of the controller. They only exist in builds
+// with -DSIMPLE_CONTROLLER_ENABLE_PROFILING, otherwise PROSTHESIS_PROFILE_SCOPE
+// expands to nothing and its argument is never evaluated.
+#ifdef SIMPLE_CONTROLLER_ENABLE_PROFILING
+
+#include <latency_histogram.h>
+
+#include <stdint.h>
+#include <time.h>
+
+namespace prosthesis
+{
+/// \brief monotonic clock in nanoseconds
+inline uint64_t profileClock()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec;
+}
+
+/// \brief records the lifetime of the enclosing scope into a histogram
+class ScopedTimer
+{
+public:
+  explicit ScopedTimer(LatencyHistogram& histogram) : histogram_(histogram), start_(profileClock())
+  {
+  }
+
+  ~ScopedTimer()
+  {
+    histogram_.record(profileClock() - start_);
+  }
+
+private:
+  LatencyHistogram& histogram_;
+  const uint64_t start_;
+};
+}
+
+#define PROSTHESIS_PROFILE_CONCAT_(a, b) a##b
+#define PROSTHESIS_PROFILE_CONCAT(a, b) PROSTHESIS_PROFILE_CONCAT_(a, b)
+#define PROSTHESIS_PROFILE_SCOPE(histogram)                                                                            \
+  prosthesis::ScopedTimer PROSTHESIS_PROFILE_CONCAT(profile_scope_, __LINE__)(histogram)
+
+#else
+
+#define PROSTHESIS_PROFILE_SCOPE(histogram)
+
+#endif  // SIMPLE_CONTROLLER_ENABLE_PROFILING
+
+#endif  // PROFILING_H
@@ -0,0 +1,109 @@
+#ifndef QUATERNION_MATH_H
+#define QUATERNION_MATH_H
+
+#include <cmath>
+
+// Minimal quaternion helpers without ROS/Gazebo dependencies, used by the
+// orientation pipeline of the myo control chain and the controller core.
+namespace prosthesis
+{
+struct Quaternion
+{
+  double w, x, y, z;
+};
+
+struct Vector3
+{
+  double x, y, z;
+};
+
+/// \brief roll/pitch/yaw with the fixed axis convention of tf2::Matrix3x3::getRPY
+struct RPY
+{
+  double roll, pitch, yaw;
+};
+
+inline Quaternion multiply(const Quaternion& a, const Quaternion& b)
+{
+  Quaternion q;
+  q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+  q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+  q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+  q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  return q;
+}
+
+inline Quaternion conjugate(const Quaternion& q)
+{
+  Quaternion c = { q.w, -q.x, -q.y, -q.z };
+  return c;
+}
+
+inline Quaternion normalize(const Quaternion& q)
+{
+  double n = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+  Quaternion u = { q.w / n, q.x / n, q.y / n, q.z / n };
+  return u;
+}
+
+/// \brief rotate v by the unit quaternion q
+inline Vector3 rotate(const Quaternion& q, const Vector3& v)
+{
+  // t = 2 * (q.xyz x v), v' = v + w * t + q.xyz x t
+  Vector3 t = { 2.0 * (q.y * v.z - q.z * v.y), 2.0 * (q.z * v.x - q.x * v.z), 2.0 * (q.x * v.y - q.y * v.x) };
+  Vector3 r = { v.x + q.w * t.x + q.y * t.z - q.z * t.y, v.y + q.w * t.y + q.z * t.x - q.x * t.z,
+                v.z + q.w * t.z + q.x * t.y - q.y * t.x };
+  return r;
+}
+
+/// \brief rotate v by the inverse of the unit quaternion q
+inline Vector3 rotateReverse(const Quaternion& q, const Vector3& v)
+{
+  return rotate(conjugate(q), v);
+}
+
+/// \brief roll/pitch/yaw of a unit quaternion, three trig calls and no rotation matrix
+inline RPY toRPY(const Quaternion& q)
+{
+  RPY rpy;
+  rpy.roll = std::atan2(2.0 * (q.w * q.x + q.y * q.z), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+  double sinp = 2.0 * (q.w * q.y - q.z * q.x);
+  rpy.pitch = std::asin(sinp > 1.0 ? 1.0 : (sinp < -1.0 ? -1.0 : sinp));
+  rpy.yaw = std::atan2(2.0 * (q.w * q.z + q.x * q.y), 1.0 - 2.0 * (q.y * q.y + q.z * q.z));
+  return rpy;
+}
+
+/// \brief unit quaternion of roll/pitch/yaw, the inverse of toRPY
+inline Quaternion fromRPY(double roll, double pitch, double yaw)
+{
+  const double cr = std::cos(roll / 2), sr = std::sin(roll / 2);
+  const double cp = std::cos(pitch / 2), sp = std::sin(pitch / 2);
+  const double cy = std::cos(yaw / 2), sy = std::sin(yaw / 2);
+  Quaternion q = { cr * cp * cy + sr * sp * sy, sr * cp * cy - cr * sp * sy, cr * sp * cy + sr * cp * sy,
+                   cr * cp * sy - sr * sp * cy };
+  return q;
+}
+
+/// \brief rotation from a along the shortest arc to b, t = 0 is a and t = 1 is b. t outside
+/// 0..1 continues the arc at the same angular velocity, which extrapolates the rotation.
+inline Quaternion slerp(const Quaternion& a, const Quaternion& b, double t)
+{
+  // d = a^-1 b on the hemisphere of the shorter rotation, the result is a d^t
+  Quaternion d = multiply(conjugate(a), b);
+  if (d.w < 0.0)
+  {
+    d.w = -d.w;
+    d.x = -d.x;
+    d.y = -d.y;
+    d.z = -d.z;
+  }
+  const double s = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+  const double half_angle = std::atan2(s, d.w);
+  // sin(t * half_angle) / s, which tends to t / d.w for tiny rotations
+  const double scale = s > 1e-9 ? std::sin(t * half_angle) / s : t / d.w;
+  Quaternion p = { std::cos(t * half_angle), d.x * scale, d.y * scale, d.z * scale };
+  return normalize(multiply(a, p));
+}
+}
+
+#endif  // QUATERNION_MATH_H
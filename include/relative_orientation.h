@@ -0,0 +1,39 @@
+#ifndef RELATIVE_ORIENTATION_H
+#define RELATIVE_ORIENTATION_H
+
+#include <quaternion_math.h>
+
+#include <cstddef>
+
+namespace prosthesis
+{
+/// \brief Orientation of the armband relative to a reference pose.
+///
+/// The relative rotation is computed in quaternion space, angles are only
+/// produced at the output. Each angle is put on the 2 pi branch nearest to the
+/// previous output, so the output stays continuous when the arm turns past
+/// +-180 degrees (pitch itself still folds at +-90 degrees).
+class RelativeOrientation
+{
+public:
+  RelativeOrientation();
+
+  /// \brief use q as the reference all following samples are relative to, restarts the unwrapping
+  void setReference(const Quaternion& q);
+  bool hasReference() const;
+
+  /// \brief roll/pitch/yaw of q relative to the reference (in the reference frame), unwrapped
+  /// against the previous output
+  RPY update(const Quaternion& q);
+
+  /// \brief process a block of n consecutive samples in one call
+  void update(const Quaternion* q, RPY* rpy, std::size_t n);
+
+private:
+  Quaternion reference_inverse_;
+  bool has_reference_;
+  RPY previous_;  // last output, zero (the reference itself) after setReference
+};
+}
+
+#endif  // RELATIVE_ORIENTATION_H
@@ -0,0 +1,49 @@
+#ifndef RIGID_BODY_PLANT_H
+#define RIGID_BODY_PLANT_H
+
+#include <simple_controller_core.h>
+
+namespace prosthesis
+{
+struct PlantParameters
+{
+  double mass;
+  Vector3 inertia;  // principal moments, the body frame is the principal frame
+  Vector3 gravity;
+  double linear_damping;   // 1/s, 0 for none
+  double angular_damping;  // 1/s, 0 for none
+};
+
+/// \brief Free rigid body driven by the wrench of SimpleControllerCore, a stand-in for the
+/// simulated link when the controller is run without gzserver.
+///
+/// The force acts in the world frame and the torque in the body frame, like
+/// GazeboSimpleController::ApplyWrench() applies them (with the center of gravity
+/// in the link origin). Integration is semi-implicit Euler.
+class RigidBodyPlant
+{
+public:
+  RigidBodyPlant();
+  explicit RigidBodyPlant(const PlantParameters& parameters);
+
+  /// \brief put the body at rest at position with the given orientation
+  void reset(const Vector3& position, const Quaternion& orientation);
+
+  /// \brief advance by dt under force (world frame) and torque (body frame)
+  void step(const Vector3& force, const Vector3& torque, double dt);
+
+  /// \brief state in the form the plugin reads it from the link
+  LinkSample sample() const;
+
+  PlantParameters parameters;
+
+private:
+  Vector3 position_;
+  Quaternion orientation_;
+  Vector3 velocity_;
+  Vector3 angular_velocity_;  // world frame
+  Vector3 angular_acceleration_;
+};
+}
+
+#endif  // RIGID_BODY_PLANT_H
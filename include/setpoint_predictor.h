@@ -0,0 +1,46 @@
+#ifndef SETPOINT_PREDICTOR_H
+#define SETPOINT_PREDICTOR_H
+
+#include <quaternion_math.h>
+
+namespace prosthesis
+{
+/// \brief Turns orientation commands arriving at a low rate into a setpoint for every tick.
+///
+/// The commands are roll/pitch/yaw as sent by myo_control_node. The rotation between the
+/// last two of them gives the angular velocity, predict() continues along that arc (slerp
+/// beyond the latest command) for at most horizon seconds and then holds. The setpoint thus
+/// moves on every tick instead of jumping once per command, which hides part of the transport
+/// delay and keeps the steps out of the derivative terms. Commands further apart than
+/// max_interval give no rate, the latest one is held as before.
+class SetpointPredictor
+{
+public:
+  SetpointPredictor();
+
+  /// \brief forget all commands, e.g. after the simulation time jumped back
+  void reset();
+
+  /// \brief take a new command received at time (seconds)
+  void command(const Vector3& rpy, double time);
+
+  /// \brief setpoint for time, on the same 2 pi branch per axis as the latest command
+  Vector3 predict(double time) const;
+
+  bool hasCommand() const;
+
+  /// \brief longest extrapolation past the latest command [s], <= 0 disables the prediction
+  double horizon;
+  /// \brief two commands further apart than this [s] do not define a rate
+  double max_interval;
+
+private:
+  Quaternion previous_, latest_;
+  Vector3 latest_rpy_;
+  double latest_time_;
+  double interval_;  // time between previous_ and latest_, 0 without a previous command
+  bool has_command_;
+};
+}
+
+#endif  // SETPOINT_PREDICTOR_H
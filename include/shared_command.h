@@ -0,0 +1,74 @@
+#ifndef SHARED_COMMAND_H
+#define SHARED_COMMAND_H
+
+#include <quaternion_math.h>
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+// Position command handed from myo_control_node to GazeboSimpleController through a POSIX
+// shared memory object instead of a topic. The object holds only the newest command, guarded
+// by a sequence lock: the writer never waits, the reader retries while an update is in
+// progress. Both sides create the object if it does not exist yet, so they can start in any
+// order.
+namespace prosthesis
+{
+struct SharedCommand
+{
+  Vector3 linear;
+  Vector3 angular;
+  double stamp;  // sharedCommandClock() when it was written
+};
+
+/// \brief Layout of the shared memory object. The payload is stored as relaxed atomics,
+/// which are plain loads and stores on x86-64 but keep the concurrent reads well defined.
+struct SharedCommandBlock
+{
+  std::atomic<uint64_t> sequence;  // odd while the writer updates the values, 0 before the first command
+  std::atomic<double> values[7];   // linear x, y, z, angular x, y, z, stamp
+};
+
+/// \brief CLOCK_MONOTONIC in seconds, the same on both sides of the shared memory
+double sharedCommandClock();
+
+class SharedCommandWriter
+{
+public:
+  SharedCommandWriter();
+  ~SharedCommandWriter();
+
+  /// \brief create or open the shared memory object name (e.g. "/prosthesis_cmd_pos")
+  bool open(const std::string& name);
+  bool isOpen() const;
+  void close();
+
+  /// \brief publish a command stamped with the current time, lock free and without system calls
+  void write(const Vector3& linear, const Vector3& angular);
+
+private:
+  SharedCommandBlock* block_;
+};
+
+class SharedCommandReader
+{
+public:
+  SharedCommandReader();
+  ~SharedCommandReader();
+
+  bool open(const std::string& name);
+  bool isOpen() const;
+  void close();
+
+  /// \brief true and the command if the writer published one since the last successful read.
+  /// Never blocks: while the writer is in the middle of an update it gives up after a few
+  /// attempts and returns false, the command is read by the next call.
+  bool read(SharedCommand& command);
+
+private:
+  SharedCommandBlock* block_;
+  uint64_t last_sequence_;
+};
+}
+
+#endif  // SHARED_COMMAND_H
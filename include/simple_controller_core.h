@@ -0,0 +1,206 @@
+#ifndef SIMPLE_CONTROLLER_CORE_H
+#define SIMPLE_CONTROLLER_CORE_H
+
+#include <pid_bank.h>
+#include <quaternion_math.h>
+
+#include <string>
+
+// Control law of GazeboSimpleController without any Gazebo or ROS dependency,
+// so it can be profiled and benchmarked without running gzserver.
+namespace prosthesis
+{
+/// \brief State and commands of one control tick, world frame
+struct ControllerInput
+{
+  Vector3 position;
+  Quaternion orientation;
+  Vector3 euler;  // roll/pitch/yaw of orientation
+  Vector3 velocity;
+  Vector3 acceleration;
+  Vector3 angular_velocity;
+  Vector3 angular_acceleration;
+  Vector3 gravity;  // gravity vector of the world
+
+  Vector3 position_command_linear;
+  Vector3 position_command_angular;
+  Vector3 velocity_command_linear;
+  Vector3 velocity_command_angular;
+};
+
+/// \brief Result of one control tick
+struct ControllerOutput
+{
+  Vector3 force;
+  Vector3 torque;
+
+  // velocity commands actually tracked, computed by the outer loops of the position cascade
+  Vector3 velocity_command_linear;
+  Vector3 velocity_command_angular;
+};
+
+/// \brief Orientation and angular velocity measured by an imu
+struct ImuSample
+{
+  Quaternion orientation;
+  Vector3 euler;
+  Vector3 angular_velocity;
+};
+
+/// \brief State reported by an external state estimate (odometry)
+struct StateSample
+{
+  Vector3 position;
+  Quaternion orientation;
+  Vector3 euler;
+  Vector3 velocity;
+  Vector3 acceleration;
+  Vector3 angular_velocity;
+};
+
+/// \brief State of the simulated link
+struct LinkSample
+{
+  Vector3 position;
+  Quaternion orientation;
+  Vector3 euler;
+  Vector3 velocity;
+  Vector3 angular_velocity;
+  Vector3 angular_acceleration;
+};
+
+/// \brief input with zero state, identity orientation and zero commands
+ControllerInput makeControllerInput();
+
+/// \brief zero the state part of input, the commands and gravity are kept
+void resetState(ControllerInput& input);
+
+/// \brief take orientation and angular velocity from the imu
+void applyImu(const ImuSample& imu, ControllerInput& input);
+
+/// \brief take the state estimate, the orientation only if there is no imu
+void applyState(const StateSample& state, bool has_imu, ControllerInput& input);
+
+/// \brief take everything neither the imu nor the state estimate provides from the link,
+/// the acceleration is the difference to the previous velocity
+void applyLink(const LinkSample& link, bool has_imu, bool has_state, double dt, ControllerInput& input);
+
+struct ControllerParameters
+{
+  double mass;
+  Vector3 inertia;
+  double max_force;   // <= 0 disables the force limit
+  double max_torque;  // <= 0 disables the torque limit
+};
+
+/// \brief magnitude of the gravity vector and load factor at the given orientation
+void computeGravity(const Quaternion& orientation, const Vector3& gravity, double& gravity_length,
+                    double& load_factor);
+
+/// \brief Update schedule of the outer cascade layer (the position/attitude loops of the position
+/// cascade, the horizontal velocity loops of the velocity cascade, the attitude and height loops of
+/// the attitude and hover cascades), which may run slower than the inner layer. Between its updates
+/// the outer loops hold their output.
+class OuterSchedule
+{
+public:
+  OuterSchedule() : period(0.0), elapsed_(0.0)
+  {
+  }
+
+  /// \brief advance by one inner tick of dt, returns the time since the last outer update if the
+  /// outer layer is due in this tick and 0 otherwise
+  double advance(double dt)
+  {
+    elapsed_ += dt;
+    // half a tick of slack, so rounding of the accumulated dt never skips a tick
+    if (elapsed_ < period - 0.5 * dt)
+      return 0.0;
+    const double outer_dt = elapsed_;
+    elapsed_ = 0.0;
+    return outer_dt;
+  }
+
+  /// \brief update period of the outer layer, 0 (the default) updates it in every tick
+  double period;
+
+private:
+  double elapsed_;
+};
+
+class SimpleControllerCore
+{
+public:
+  /// \brief Index of every PID loop in the bank. The outer (position/attitude) loops come first
+  /// and are in the same order as the inner loops they command, so each cascade layer is one
+  /// contiguous range and the outputs of the outer layer are the inputs of the inner one.
+  enum Controller
+  {
+    POSITION_X,
+    POSITION_Y,
+    POSITION_Z,
+    ROLL,
+    PITCH,
+    YAW,
+    VELOCITY_X,
+    VELOCITY_Y,
+    VELOCITY_Z,
+    ROLL_VEL,
+    PITCH_VEL,
+    YAW_VEL,
+    CONTROLLER_COUNT
+  };
+
+  enum Cascade
+  {
+    /// position/attitude loops commanding velocity/rate loops (the prosthesis setup)
+    POSITION_CASCADE,
+    /// velocity loops commanding attitude loops (the original hector quadrotor setup, used with Gazebo >= 8)
+    VELOCITY_CASCADE,
+    /// attitude loops commanding rate loops, the thrust only compensates gravity
+    ATTITUDE_CASCADE,
+    /// height loops commanding the vertical velocity loop, level attitude with the commanded yaw
+    HOVER_CASCADE,
+    CASCADE_COUNT
+  };
+
+  SimpleControllerCore();
+
+  /// \brief select the cascade, each one is compiled into its own tick so update() runs only
+  /// the math and loops that cascade uses
+  void setCascade(Cascade cascade);
+  Cascade cascade() const;
+
+  /// \brief run one tick, when not running the loops of the cascade are reset and the output is zero.
+  /// The outer layer only runs when outer_period has elapsed, see OuterSchedule.
+  void update(const PIDGains& gains, const ControllerInput& input, double dt, bool running, ControllerOutput& output)
+  {
+    (this->*tick_)(gains, input, dt, running, output);
+  }
+
+  /// \brief reset the attitude and velocity loops
+  void reset();
+
+  ControllerParameters parameters;
+  PIDBank controllers;
+  OuterSchedule outer_schedule;
+
+private:
+  template <class Policy>
+  void tick(const PIDGains& gains, const ControllerInput& input, double dt, bool running, ControllerOutput& output);
+
+  typedef void (SimpleControllerCore::*Tick)(const PIDGains&, const ControllerInput&, double, bool, ControllerOutput&);
+
+  Cascade cascade_;
+  Tick tick_;
+};
+
+/// \brief name of a cascade as used by the cascade parameter of the plugin (position, velocity,
+/// attitude, hover)
+const char* cascadeName(SimpleControllerCore::Cascade cascade);
+
+/// \brief cascade of the given name, false if there is none
+bool cascadeFromName(const std::string& name, SimpleControllerCore::Cascade& cascade);
+}
+
+#endif  // SIMPLE_CONTROLLER_CORE_H
@@ -0,0 +1,78 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace prosthesis
+{
+/// \brief Bounded lock-free ring buffer for one producer and one consumer thread.
+///
+/// All storage is allocated by resize(), push() and pop() never allocate. When
+/// the ring is full push() fails and the value is left to the caller.
+template <typename T>
+class SpscRing
+{
+public:
+  explicit SpscRing(std::size_t capacity = 0) : mask_(0), head_(0), tail_(0)
+  {
+    resize(capacity);
+  }
+
+  /// \brief allocate room for at least capacity elements (rounded up to a power of two, at most the
+  /// largest power of two a size_t holds), not thread safe
+  void resize(std::size_t capacity)
+  {
+    const std::size_t largest = ~(~std::size_t(0) >> 1);
+    std::size_t size = 1;
+    while (size < capacity && size < largest)
+      size <<= 1;
+    buffer_.assign(size, T());
+    mask_ = size - 1;
+    head_.store(0);
+    tail_.store(0);
+  }
+
+  std::size_t capacity() const
+  {
+    return buffer_.size();
+  }
+
+  /// \brief producer side
+  bool push(const T& value)
+  {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= buffer_.size())
+      return false;
+    buffer_[head & mask_] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief consumer side: oldest element or NULL if the ring is empty
+  const T* front() const
+  {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+      return NULL;
+    return &buffer_[tail & mask_];
+  }
+
+  /// \brief consumer side: release the element returned by front()
+  void pop()
+  {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+private:
+  std::vector<T> buffer_;
+  std::size_t mask_;
+
+  // producer and consumer indices on separate cache lines
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::atomic<std::size_t> tail_;
+};
+}
+
+#endif  // SPSC_RING_H
@@ -0,0 +1,68 @@
+#ifndef TRACE_BUFFER_H
+#define TRACE_BUFFER_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+// Stage timestamps along the Myo -> cmd_pos -> controller -> wrench chain. Every thread
+// records into a ring of its own without locks, flushTrace() moves the events into a
+// Chrome trace / Perfetto JSON file (open it in ui.perfetto.dev or chrome://tracing, or
+// merge and summarize the files of several processes with trace_report).
+namespace prosthesis
+{
+/// \brief wall clock in nanoseconds, the same in all processes of a machine so their traces line up
+uint64_t traceClock();
+
+/// \brief how an event connects to the other events of its trace id (Perfetto draws them as arrows)
+enum TraceFlow
+{
+  TRACE_FLOW_NONE = 0,
+  TRACE_FLOW_IN = 1,       // last stage
+  TRACE_FLOW_OUT = 2,      // first stage
+  TRACE_FLOW_THROUGH = 3,  // any stage in between
+};
+
+/// \brief start recording into path, the process shows up as process_name. One trace per process,
+/// false if one is open already or the file cannot be written.
+bool openTrace(const std::string& path, const std::string& process_name, std::size_t events_per_thread = 65536);
+
+/// \brief whether a trace is open, a single relaxed load
+bool traceEnabled();
+
+/// \brief record a stage of the command with trace id (0 for none) that started at start (traceClock())
+/// and took duration ns. name must outlive the trace, use string literals. Does nothing without an
+/// open trace. Never blocks; the first event of a thread allocates its ring, events finding it full
+/// are dropped and counted.
+void recordTrace(const char* name, uint64_t start, uint64_t duration, uint32_t id, TraceFlow flow);
+
+/// \brief append the events recorded so far to the file, from any thread
+void flushTrace();
+
+/// \brief flush and complete the file, events recorded afterwards are discarded
+void closeTrace();
+
+/// \brief records the lifetime of the enclosing scope as a stage
+class ScopedTrace
+{
+public:
+  ScopedTrace(const char* name, uint32_t id, TraceFlow flow)
+    : name_(name), id_(id), flow_(flow), start_(traceEnabled() ? traceClock() : 0)
+  {
+  }
+
+  ~ScopedTrace()
+  {
+    if (start_)
+      recordTrace(name_, start_, traceClock() - start_, id_, flow_);
+  }
+
+private:
+  const char* name_;
+  const uint32_t id_;
+  const TraceFlow flow_;
+  const uint64_t start_;
+};
+}
+
+#endif  // TRACE_BUFFER_H
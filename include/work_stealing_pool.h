@@ -0,0 +1,67 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace prosthesis
+{
+/// \brief Fixed set of worker threads running index ranges, for offline tools.
+///
+/// parallelFor() splits the range into chunks and deals them out in contiguous
+/// blocks, one deque per worker. A worker takes chunks from the back of its own
+/// deque and, once that is empty, steals from the front of the others, so
+/// chunks that finish early (e.g. a diverging simulation) do not leave threads
+/// idle. The calling thread works as worker 0.
+class WorkStealingPool
+{
+public:
+  typedef std::function<void(std::size_t begin, std::size_t end)> Task;
+
+  /// \brief threads = 0 uses one worker per hardware thread
+  explicit WorkStealingPool(std::size_t threads = 0);
+  ~WorkStealingPool();
+
+  std::size_t size() const;
+
+  /// \brief run task over [0, count) in chunks of at most grain indices, returns when all are done
+  void parallelFor(std::size_t count, std::size_t grain, const Task& task);
+
+private:
+  struct Range
+  {
+    std::size_t begin, end;
+  };
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Range> ranges;
+  };
+
+  void workerThread(std::size_t worker);
+
+  /// \brief run one chunk of the own queue or a stolen one, false if there is none left
+  bool runOne(std::size_t worker);
+
+  std::vector<Queue> queues_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const Task* task_;
+  uint64_t generation_;
+  bool stop_;
+  std::atomic<std::size_t> remaining_;
+};
+}
+
+#endif  // WORK_STEALING_POOL_H
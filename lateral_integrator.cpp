@@ -0,0 +1,72 @@
+#include <lateral_integrator.h>
+
+#include <limits>
+
+namespace prosthesis
+{
+static double clamp(double value, double lower, double upper)
+{
+  return value < lower ? lower : (value > upper ? upper : value);
+}
+
+LateralIntegrator::LateralIntegrator()
+  : gain(0.1), timeout(0.5), stamp_(0.0), integrated_until_(0.0), has_command_(false)
+{
+  const double infinity = std::numeric_limits<double>::infinity();
+  lower.x = lower.y = lower.z = -infinity;
+  upper.x = upper.y = upper.z = infinity;
+  velocity_.x = velocity_.y = velocity_.z = 0.0;
+  position_.x = position_.y = position_.z = 0.0;
+}
+
+void LateralIntegrator::command(const Vector3& velocity, double time)
+{
+  integrate(time);
+  velocity_ = velocity;
+  stamp_ = time;
+  integrated_until_ = time;
+  has_command_ = true;
+}
+
+const Vector3& LateralIntegrator::advance(double time)
+{
+  integrate(time);
+  return position_;
+}
+
+const Vector3& LateralIntegrator::position() const
+{
+  return position_;
+}
+
+bool LateralIntegrator::moving(double time) const
+{
+  const bool zero = velocity_.x == 0.0 && velocity_.y == 0.0 && velocity_.z == 0.0;
+  return has_command_ && !zero && gain != 0.0 && time < holdEnd();
+}
+
+double LateralIntegrator::holdEnd() const
+{
+  return timeout > 0.0 ? stamp_ + timeout : std::numeric_limits<double>::infinity();
+}
+
+void LateralIntegrator::integrate(double time)
+{
+  if (!has_command_)
+    return;
+
+  // the held command covers [stamp_, stamp_ + timeout], the part after integrated_until_ is new
+  // the velocity is constant over the segment, so clamping its end equals clamping every step of it
+  double end = time;
+  if (end > holdEnd())
+    end = holdEnd();
+  const double dt = end - integrated_until_;
+  if (dt > 0.0)
+  {
+    position_.x = clamp(position_.x + gain * velocity_.x * dt, lower.x, upper.x);
+    position_.y = clamp(position_.y + gain * velocity_.y * dt, lower.y, upper.y);
+    position_.z = clamp(position_.z + gain * velocity_.z * dt, lower.z, upper.z);
+    integrated_until_ = end;
+  }
+}
+}
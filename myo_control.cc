@@ -0,0 +1,277 @@
+#include <myo_control.h>
+#include <trace_buffer.h>
+
+#include <std_msgs/Int16.h>
+#include <math.h>
+#include <vector>
+
+namespace prosthesis
+{
+MyoControl::MyoControl(ros::NodeHandle node_handle, ros::NodeHandle private_handle)
+  : twist_changed_(true), force_changed_(true), event_driven_(false), rate_cap_armed_(false), owns_trace_(false)
+{
+  twist_publisher_ = node_handle.advertise<geometry_msgs::Twist>("/cmd_pos", 10);
+  lateral_subscriber_ = node_handle.subscribe("/desired_lateral_cmd_pos", 10, &MyoControl::lateralCallback, this);
+  pose_subscriber_ = node_handle.subscribe("/myo_raw/pose", 10, &MyoControl::poseCallback, this);
+
+  // publish_force false leaves /gripperforce to myo_emg_control_node
+  bool publish_force = true;
+  private_handle.getParam("publish_force", publish_force);
+  if (publish_force)
+  {
+    force_publisher_ = node_handle.advertise<std_msgs::Int16>("/gripperforce", 10);
+    fist_subscriber_ = node_handle.subscribe("/myo_raw/myo_gest", 10, &MyoControl::fistCallback, this);
+  }
+
+  // event_driven: publish as soon as a callback changed the state, at most with max_rate
+  // and at least with keepalive_rate, otherwise publish everything with 10 Hz
+  double max_rate = 100;
+  double keepalive_rate = 1;
+  private_handle.getParam("event_driven", event_driven_);
+  private_handle.getParam("max_rate", max_rate);
+  private_handle.getParam("keepalive_rate", keepalive_rate);
+
+  // lateral input is a velocity, lateral_gain defaults to the old step of 0.01 per message at
+  // lateral_nominal_rate and lateral_timeout to one period of it, so inputs at that rate and
+  // isolated messages both move the prosthesis as before
+  double nominal_rate = 10;
+  private_handle.getParam("lateral_nominal_rate", nominal_rate);
+  core_.lateral.gain = 0.01 * nominal_rate;
+  if (nominal_rate > 0)
+    core_.lateral.timeout = 1.0 / nominal_rate;
+  private_handle.getParam("lateral_gain", core_.lateral.gain);
+  private_handle.getParam("lateral_timeout", core_.lateral.timeout);
+  std::vector<double> bound;
+  if (private_handle.getParam("lateral_min", bound) && bound.size() == 3)
+  {
+    core_.lateral.lower.x = bound[0];
+    core_.lateral.lower.y = bound[1];
+    core_.lateral.lower.z = bound[2];
+  }
+  if (private_handle.getParam("lateral_max", bound) && bound.size() == 3)
+  {
+    core_.lateral.upper.x = bound[0];
+    core_.lateral.upper.y = bound[1];
+    core_.lateral.upper.z = bound[2];
+  }
+
+  std::string shared_command;
+  private_handle.getParam("shared_command", shared_command);
+  if (!shared_command.empty() && !shared_command_.open(shared_command))
+    ROS_ERROR("Could not open shared memory %s, publishing on /cmd_pos only", shared_command.c_str());
+
+  // trace the stages of every command, trace_report merges the file with the controller's
+  std::string trace_file;
+  private_handle.getParam("trace_file", trace_file);
+  if (!trace_file.empty())
+  {
+    owns_trace_ = openTrace(trace_file, ros::this_node::getName());
+    if (owns_trace_)
+    {
+      traced_twist_publisher_ = node_handle.advertise<prosthesis_v7::TracedTwist>("/cmd_pos_traced", 10);
+      trace_timer_ = node_handle.createWallTimer(ros::WallDuration(1.0), &MyoControl::traceCallback, this);
+    }
+    else
+    {
+      ROS_ERROR("Could not trace to %s, the file is not writable or the process traces already", trace_file.c_str());
+    }
+  }
+
+  // a held lateral command moves the position until its hold ends, on the event driven and
+  // shared memory paths that motion is handed on in steps of the rate cap
+  min_period_ = ros::WallDuration(max_rate > 0 ? 1.0 / max_rate : 0.0);
+  lateral_timer_ =
+      node_handle.createWallTimer(min_period_, &MyoControl::lateralTimerCallback, this, true /* oneshot */, false);
+
+  if (!event_driven_)
+  {
+    periodic_timer_ = node_handle.createTimer(ros::Duration(0.1), &MyoControl::periodicCallback, this);
+  }
+  else
+  {
+    rate_cap_timer_ =
+        node_handle.createWallTimer(min_period_, &MyoControl::rateCapCallback, this, true /* oneshot */, false);
+    if (keepalive_rate > 0)
+      keepalive_timer_ =
+          node_handle.createWallTimer(ros::WallDuration(1.0 / keepalive_rate), &MyoControl::keepaliveCallback, this);
+    // the initial state counts as changed
+    publishChanged();
+  }
+
+  ROS_INFO("Spinning node");
+}
+
+MyoControl::~MyoControl()
+{
+  if (owns_trace_)
+    closeTrace();
+}
+
+// define the orientation of the prosthesis
+void MyoControl::poseCallback(const geometry_msgs::PoseStamped::ConstPtr &pose)
+{
+  ScopedTrace trace("myo_control pose", pose->header.seq, TRACE_FLOW_THROUGH);
+  // the driver stamps the pose with its ROS time, only without simulation that is the wall clock of the trace
+  if (owns_trace_ && !ros::Time::isSimTime())
+    recordTrace("myo_raw pose", pose->header.stamp.toNSec(), 0, pose->header.seq, TRACE_FLOW_OUT);
+
+  const geometry_msgs::Quaternion &o = pose->pose.orientation;
+  const Quaternion orientation = { o.w, o.x, o.y, o.z };
+  if (core_.pose(orientation))
+  {
+    trace_.id = pose->header.seq;
+    trace_.origin = pose->header.stamp;
+    twistChanged();
+  }
+
+  const Vector3 &angular = core_.angular();
+  ROS_DEBUG_THROTTLE(1.0, "You're sending r: %f p: %f y: %f values", (angular.x * 360) / (2 * M_PI),
+                     (angular.y * 360) / (2 * M_PI), (angular.z * 360) / (2 * M_PI));
+}
+
+// check the lateral movement of the whole prosthesis
+// the input is a velocity stamped with its arrival time (Twist has no header) and integrated
+// over the time that passed, so the input rate does not change the motion
+void MyoControl::lateralCallback(const geometry_msgs::Twist::ConstPtr &input)
+{
+  const double now = ros::WallTime::now().toSec();
+  const Vector3 velocity = { input->linear.x, input->linear.y, input->linear.z };
+  core_.lateralInput(velocity, now);
+
+  // with periodic publishing the inputs are integrated in one step at the next publish,
+  // the other paths hand on every change and follow the held command with the lateral timer
+  if (event_driven_ || shared_command_.isOpen())
+  {
+    if (core_.updateLateral(now))
+      twistChanged();
+    armLateralTimer(now);
+  }
+}
+
+void MyoControl::lateralTimerCallback(const ros::WallTimerEvent &)
+{
+  const double now = ros::WallTime::now().toSec();
+  if (core_.updateLateral(now))
+    twistChanged();
+  armLateralTimer(now);
+}
+
+void MyoControl::armLateralTimer(double now)
+{
+  lateral_timer_.stop();
+  if (!core_.lateral.moving(now))
+    return;
+  // the next rate cap step (10 ms without a rate cap) or the end of the hold, whichever comes first
+  const double step = min_period_.toSec() > 0.0 ? min_period_.toSec() : 0.01;
+  double wait = core_.lateral.holdEnd() - now;
+  if (step < wait)
+    wait = step;
+  lateral_timer_.setPeriod(ros::WallDuration(wait));
+  lateral_timer_.start();
+}
+
+// check whether the user wants to grasp or not
+void MyoControl::fistCallback(const ros_myo::MyoPose::ConstPtr &pose)
+{
+  // a fist grasps, the hand at rest opens
+  if (core_.gesture(pose->pose))
+  {
+    force_changed_ = true;
+    publishChanged();
+  }
+}
+
+void MyoControl::publishState(bool send_twist, bool send_force)
+{
+  // a new message every time, subscribers in the same process keep a pointer to it
+  if (send_twist)
+  {
+    ScopedTrace trace("myo_control publish", trace_.id, TRACE_FLOW_THROUGH);
+    if (core_.updateLateral(ros::WallTime::now().toSec()) && shared_command_.isOpen())
+      shared_command_.write(core_.linear(), core_.angular());
+    geometry_msgs::TwistPtr twist(new geometry_msgs::Twist);
+    twist->linear.x = core_.linear().x;
+    twist->linear.y = core_.linear().y;
+    twist->linear.z = core_.linear().z;
+    twist->angular.x = core_.angular().x;
+    twist->angular.y = core_.angular().y;
+    twist->angular.z = core_.angular().z;
+    twist_publisher_.publish(twist);
+    if (traced_twist_publisher_)
+    {
+      prosthesis_v7::TracedTwistPtr traced(new prosthesis_v7::TracedTwist);
+      traced->trace = trace_;
+      traced->trace.sent.fromNSec(traceClock());
+      traced->twist = *twist;
+      traced_twist_publisher_.publish(traced);
+    }
+    twist_changed_ = false;
+  }
+  if (send_force)
+  {
+    // positive to grasp, negative to open the gripper
+    if (force_publisher_)
+    {
+      std_msgs::Int16Ptr applied_force(new std_msgs::Int16);
+      applied_force->data = core_.force();
+      force_publisher_.publish(applied_force);
+    }
+    force_changed_ = false;
+  }
+}
+
+void MyoControl::twistChanged()
+{
+  twist_changed_ = true;
+  if (shared_command_.isOpen())
+  {
+    shared_command_.write(core_.linear(), core_.angular());
+  }
+  publishChanged();
+}
+
+void MyoControl::publishChanged()
+{
+  if (!event_driven_ || rate_cap_armed_)
+    return;
+
+  const ros::WallTime now = ros::WallTime::now();
+  if (now - last_publish_ >= min_period_)
+  {
+    publishState(twist_changed_, force_changed_);
+    last_publish_ = now;
+    return;
+  }
+
+  // changes until the rate cap allows the next publish go out together
+  rate_cap_timer_.stop();
+  rate_cap_timer_.setPeriod(last_publish_ + min_period_ - now);
+  rate_cap_timer_.start();
+  rate_cap_armed_ = true;
+}
+
+void MyoControl::periodicCallback(const ros::TimerEvent &)
+{
+  publishState(true, true);
+}
+
+void MyoControl::rateCapCallback(const ros::WallTimerEvent &)
+{
+  rate_cap_armed_ = false;
+  if (twist_changed_ || force_changed_)
+  {
+    publishState(twist_changed_, force_changed_);
+    last_publish_ = ros::WallTime::now();
+  }
+}
+
+void MyoControl::keepaliveCallback(const ros::WallTimerEvent &)
+{
+  publishState(true, true);
+}
+
+void MyoControl::traceCallback(const ros::WallTimerEvent &)
+{
+  flushTrace();
+}
+}
@@ -0,0 +1,76 @@
+#include <myo_control_core.h>
+
+namespace prosthesis
+{
+MyoControlCore::MyoControlCore() : grasp_force(30), open_force(-30), reset_(true), grasp_(false)
+{
+  linear_.x = linear_.y = linear_.z = 0.0;
+  angular_.x = angular_.y = angular_.z = 0.0;
+}
+
+void MyoControlCore::reset()
+{
+  reset_ = true;
+}
+
+// the orientation is computed relative to the pose at reset on the quaternions, RelativeOrientation
+// unwraps the angles against its previous output so they stay continuous past +-180 degrees
+bool MyoControlCore::pose(const Quaternion& orientation)
+{
+  if (reset_)
+  {
+    orientation_.setReference(orientation);
+    reset_ = false;
+  }
+  const RPY rpy = orientation_.update(orientation);
+
+  // the armband's axes are in "wrong order" for the prosthesis
+  const Vector3 angular = { -rpy.yaw, rpy.pitch, -rpy.roll };
+  const bool changed = angular.x != angular_.x || angular.y != angular_.y || angular.z != angular_.z;
+  angular_ = angular;
+  return changed;
+}
+
+void MyoControlCore::lateralInput(const Vector3& velocity, double time)
+{
+  lateral.command(velocity, time);
+}
+
+bool MyoControlCore::updateLateral(double time)
+{
+  const Vector3& position = lateral.advance(time);
+  const bool changed = position.x != linear_.x || position.y != linear_.y || position.z != linear_.z;
+  linear_ = position;
+  return changed;
+}
+
+bool MyoControlCore::gesture(int gesture)
+{
+  const bool grasp = grasp_;
+  if (gesture == MYO_FIST)
+    grasp_ = true;
+  if (gesture == MYO_REST)
+    grasp_ = false;
+  return grasp_ != grasp;
+}
+
+const Vector3& MyoControlCore::linear() const
+{
+  return linear_;
+}
+
+const Vector3& MyoControlCore::angular() const
+{
+  return angular_;
+}
+
+bool MyoControlCore::grasp() const
+{
+  return grasp_;
+}
+
+int MyoControlCore::force() const
+{
+  return grasp_ ? grasp_force : open_force;
+}
+}
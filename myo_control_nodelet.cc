@@ -0,0 +1,25 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <myo_control.h>
+
+#include <boost/shared_ptr.hpp>
+
+namespace prosthesis
+{
+/// \brief myo_control_node as a nodelet, /cmd_pos and /gripperforce reach nodelets in the same manager
+/// without serialization
+class MyoControlNodelet : public nodelet::Nodelet
+{
+private:
+  virtual void onInit()
+  {
+    // the single threaded node handles never run two callbacks of this nodelet at once
+    control_.reset(new MyoControl(getNodeHandle(), getPrivateNodeHandle()));
+  }
+
+  boost::shared_ptr<MyoControl> control_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(prosthesis::MyoControlNodelet, nodelet::Nodelet)
@@ -0,0 +1,124 @@
+#include <myo_emg_control.h>
+
+#include <std_msgs/Int16.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace prosthesis
+{
+MyoEmgControl::MyoEmgControl(ros::NodeHandle node_handle, ros::NodeHandle private_handle)
+{
+  // one entry per armband, emg_topics[k] drives force_topics[k]
+  std::vector<std::string> emg_topics(1, "/myo_raw/myo_emg");
+  std::vector<std::string> force_topics(1, "/gripperforce");
+  private_handle.getParam("emg_topics", emg_topics);
+  private_handle.getParam("force_topics", force_topics);
+  if (force_topics.size() != emg_topics.size())
+  {
+    emg_topics.resize(std::min(emg_topics.size(), force_topics.size()));
+    ROS_ERROR("emg_topics and force_topics differ in length, using the first %zu", emg_topics.size());
+  }
+
+  // window and decimation in samples of 5 ms
+  int window = 40;
+  int decimation = 4;
+  int threshold = 2;
+  double sample_rate = 200;
+  double stats_rate = 1.0;
+  std::string feature = "rms";
+  std::vector<double> weights;
+  GripForceMap map;
+  private_handle.getParam("window", window);
+  private_handle.getParam("decimation", decimation);
+  private_handle.getParam("zero_crossing_threshold", threshold);
+  private_handle.getParam("sample_rate", sample_rate);
+  private_handle.getParam("stats_rate", stats_rate);
+  private_handle.getParam("feature", feature);
+  private_handle.getParam("weights", weights);
+  private_handle.getParam("rest", map.rest);
+  private_handle.getParam("full", map.full);
+  private_handle.getParam("time_constant", map.time_constant);
+  private_handle.getParam("open_force", map.open_force);
+  private_handle.getParam("grasp_force", map.grasp_force);
+
+  map.use_mav = feature == "mav";
+  if (weights.size() == static_cast<std::size_t>(emg_channels))
+    for (int c = 0; c < emg_channels; c++)
+      map.weights[c] = weights[c];
+  decimation_ = decimation > 0 ? decimation : 1;
+  sample_period_ = sample_rate > 0 ? 1.0 / sample_rate : 0.005;
+
+  devices_.resize(emg_topics.size());
+  for (std::size_t k = 0; k < devices_.size(); k++)
+  {
+    Device &device = devices_[k];
+    device.window.resize(window > 0 ? window : 1);
+    device.window.threshold = threshold;
+    device.map = map;
+    device.pending = 0;
+    device.published_force = 0;
+    device.has_published = false;
+    device.force_publisher = node_handle.advertise<std_msgs::Int16>(force_topics[k], 10);
+    device.subscriber = node_handle.subscribe<ros_myo::EmgArray>(
+        emg_topics[k], 100, boost::bind(&MyoEmgControl::emgCallback, this, _1, k), ros::VoidConstPtr(),
+        ros::TransportHints().tcpNoDelay());
+  }
+
+  stats_publisher_ = private_handle.advertise<prosthesis_v7::CommandStats>("stats", 10);
+  if (stats_rate > 0.0)
+    stats_timer_ = node_handle.createTimer(ros::Duration(1.0 / stats_rate), &MyoEmgControl::statsCallback, this);
+
+  ROS_INFO("Grip force from the EMG of %zu device(s), window %d samples", devices_.size(), window);
+}
+
+void MyoEmgControl::emgCallback(const ros_myo::EmgArray::ConstPtr &emg, std::size_t index)
+{
+  const ros::WallTime start = ros::WallTime::now();
+  stats_.received++;
+  if (emg->data.size() < static_cast<std::size_t>(emg_channels))
+  {
+    stats_.dropped++;
+    ROS_WARN_THROTTLE(1.0, "EMG sample with %zu instead of %d channels", emg->data.size(), emg_channels);
+    return;
+  }
+
+  Device &device = devices_[index];
+  device.window.push(&emg->data[0]);
+  if (++device.pending < decimation_)
+  {
+    stats_.coalesced++;
+    return;
+  }
+
+  EmgFeatures features;
+  device.window.features(features);
+  const int force = static_cast<int>(lround(device.map.update(features, device.pending * sample_period_)));
+  device.pending = 0;
+
+  if (!device.has_published || force != device.published_force)
+  {
+    std_msgs::Int16Ptr message(new std_msgs::Int16);
+    message->data = force;
+    device.force_publisher.publish(message);
+    device.published_force = force;
+    device.has_published = true;
+    stats_.applied++;
+  }
+
+  const ros::WallDuration elapsed = ros::WallTime::now() - start;
+  stats_.last_latency = elapsed.toSec();
+  callback_time_.record(elapsed.toNSec());
+}
+
+void MyoEmgControl::statsCallback(const ros::TimerEvent &)
+{
+  prosthesis_v7::CommandStatsPtr stats(new prosthesis_v7::CommandStats(stats_));
+  stats->stamp = ros::Time::now();
+  stats_publisher_.publish(stats);
+  ROS_DEBUG("EMG callback p50 %.1f us, p99 %.1f us, max %.1f us", 1e-3 * callback_time_.percentile(0.5),
+            1e-3 * callback_time_.percentile(0.99), 1e-3 * callback_time_.max());
+}
+}
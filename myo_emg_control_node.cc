@@ -0,0 +1,17 @@
+#include <ros/ros.h>
+
+#include <myo_emg_control.h>
+
+// map the raw EMG of the Myo to a continuous grip force, the same as loading the
+// prosthesis_v7/MyoEmgControl nodelet
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "myo_emg_control_node");
+
+  ros::NodeHandle node_handle;
+  ros::NodeHandle private_handle("~");
+  prosthesis::MyoEmgControl control(node_handle, private_handle);
+
+  ros::spin();
+  return 0;
+}
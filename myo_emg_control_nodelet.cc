@@ -0,0 +1,25 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <myo_emg_control.h>
+
+#include <boost/shared_ptr.hpp>
+
+namespace prosthesis
+{
+/// \brief myo_emg_control_node as a nodelet, /gripperforce reaches prosthesis_v7/GripperForces in the
+/// same manager without serialization
+class MyoEmgControlNodelet : public nodelet::Nodelet
+{
+private:
+  virtual void onInit()
+  {
+    // the single threaded node handles never run two callbacks of this nodelet at once
+    control_.reset(new MyoEmgControl(getNodeHandle(), getPrivateNodeHandle()));
+  }
+
+  boost::shared_ptr<MyoEmgControl> control_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(prosthesis::MyoEmgControlNodelet, nodelet::Nodelet)
@@ -0,0 +1,541 @@
+// Stand-in for the Myo armband: publishes /myo_raw/pose, /myo_raw/myo_gest and
+// /desired_lateral_cmd_pos from scripted profiles or a recording, at rates up to
+// several kHz, and reports what myo_control_node and gripper_forces make of it.
+//
+// Report, every report_period and at the end:
+//  - poses sent and the /cmd_pos outputs matched to them: the poses hold still at identity
+//    for settle_time, so the node's reference is identity and every output angle can be
+//    traced back to the pose it came from (in playback the first recorded pose is the
+//    reference). Poses between two matched outputs were coalesced or dropped by the node, the
+//    latency is from the first publish of a value to its output. myo_control_node has to be
+//    started freshly for every run, so the first pose it receives sets its reference.
+//  - gesture toggles sent and the /gripperforce flips they caused, with their latency
+//  - the last ~stats of gripper_forces
+//  - ROS topic statistics (delivered, seq gaps, header stamp age) of every subscriber of the
+//    generated topics. The nodes under test have to be started after /enable_statistics was
+//    set, which this node does when enable_statistics is true.
+//
+// Parameters (private): pose_rate, gesture_rate, lateral_rate [Hz, 0 disables], duration [s,
+// 0 runs until shutdown], motion (sine, steps, static), amplitude [rad], frequency [Hz],
+// gesture_period [s], lateral_amplitude, lateral_frequency, playback_file (rows of
+// "time w x y z [gesture]", replaces motion and, with the column, the gesture profile),
+// playback_loop, settle_time, queue_size, report_period, report_file, enable_statistics
+#include <ros/ros.h>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/Twist.h>
+#include <latency_histogram.h>
+#include <prosthesis_v7/CommandStats.h>
+#include <relative_orientation.h>
+#include <rosgraph_msgs/TopicStatistics.h>
+#include <ros_myo/MyoPose.h>
+#include <std_msgs/Int16.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+using prosthesis::LatencyHistogram;
+using prosthesis::Quaternion;
+using prosthesis::fromRPY;
+
+struct PlaybackSample
+{
+  double time;
+  Quaternion orientation;
+  int gesture;  // -1 if the recording has none
+};
+
+/// \brief A pose as sent, with the /cmd_pos angles myo_control_node derives from it
+struct SentPose
+{
+  ros::WallTime stamp;
+  double angular[3];
+};
+
+/// \brief Sums of the topic statistics of one subscriber of one topic
+struct SubscriberStatistics
+{
+  uint64_t delivered;
+  uint64_t dropped;
+  double age_sum;  // stamp_age_mean weighted by delivered
+  double age_max;
+};
+
+class MyoLoadGenerator
+{
+public:
+  MyoLoadGenerator();
+  bool load();
+  void run();
+
+private:
+  void publishPose(double t);
+  void publishGesture(double t);
+  void publishLateral(double t);
+  void report(bool final);
+
+  void commandCallback(const geometry_msgs::Twist::ConstPtr &twist);
+  void forceCallback(const std_msgs::Int16::ConstPtr &force);
+  void gripperStatsCallback(const prosthesis_v7::CommandStats::ConstPtr &stats);
+  void statisticsCallback(const rosgraph_msgs::TopicStatistics::ConstPtr &statistics);
+
+  ros::NodeHandle node_handle_;
+  ros::NodeHandle private_handle_;
+  ros::Publisher pose_publisher_, gesture_publisher_, lateral_publisher_;
+  ros::Subscriber command_subscriber_, force_subscriber_, gripper_stats_subscriber_, statistics_subscriber_;
+
+  double pose_rate_, gesture_rate_, lateral_rate_, duration_;
+  std::string motion_;
+  double amplitude_, frequency_, gesture_period_, lateral_amplitude_, lateral_frequency_;
+  double settle_time_, report_period_;
+  std::string report_file_;
+  std::vector<PlaybackSample> playback_;
+  bool playback_gestures_;  // the recording has a gesture column, it replaces the gesture profile
+  bool playback_loop_;
+  std::size_t playback_index_;
+  double playback_offset_;
+
+  prosthesis::RelativeOrientation reference_;
+  uint32_t pose_seq_;
+  int gesture_;
+
+  // shared with the subscriber callbacks, which run on the spinner thread
+  boost::mutex mutex_;
+  std::vector<SentPose> sent_;  // ring of the latest poses
+  uint64_t poses_sent_, last_matched_;
+  double last_angular_[3];  // angles of the last matched output
+  uint64_t commands_received_, commands_matched_, poses_coalesced_;
+  LatencyHistogram pose_latency_;
+  uint64_t toggles_sent_, flips_seen_;
+  int expected_force_;
+  ros::WallTime toggle_stamp_;
+  LatencyHistogram gesture_latency_;
+  uint64_t laterals_sent_, gestures_sent_;
+  prosthesis_v7::CommandStats gripper_stats_;
+  std::map<std::string, SubscriberStatistics> statistics_;
+};
+
+MyoLoadGenerator::MyoLoadGenerator()
+  : private_handle_("~"), playback_gestures_(false), playback_loop_(true), playback_index_(0), playback_offset_(0.0),
+    pose_seq_(0), gesture_(1), poses_sent_(0), last_matched_(0), commands_received_(0), commands_matched_(0),
+    poses_coalesced_(0), toggles_sent_(0), flips_seen_(0), expected_force_(0), laterals_sent_(0), gestures_sent_(0)
+{
+  const Quaternion identity = { 1.0, 0.0, 0.0, 0.0 };
+  reference_.setReference(identity);
+  last_angular_[0] = last_angular_[1] = last_angular_[2] = NAN;
+}
+
+bool MyoLoadGenerator::load()
+{
+  pose_rate_ = 50;
+  gesture_rate_ = 10;
+  lateral_rate_ = 10;
+  duration_ = 0;
+  motion_ = "sine";
+  amplitude_ = 0.5;
+  frequency_ = 0.2;
+  gesture_period_ = 2.0;
+  lateral_amplitude_ = 1.0;
+  lateral_frequency_ = 0.1;
+  settle_time_ = 1.0;
+  report_period_ = 1.0;
+  int queue_size = 100;
+  int ring_size = 65536;
+  bool enable_statistics = true;
+  std::string playback_file;
+
+  private_handle_.getParam("pose_rate", pose_rate_);
+  private_handle_.getParam("gesture_rate", gesture_rate_);
+  private_handle_.getParam("lateral_rate", lateral_rate_);
+  private_handle_.getParam("duration", duration_);
+  private_handle_.getParam("motion", motion_);
+  private_handle_.getParam("amplitude", amplitude_);
+  private_handle_.getParam("frequency", frequency_);
+  private_handle_.getParam("gesture_period", gesture_period_);
+  private_handle_.getParam("lateral_amplitude", lateral_amplitude_);
+  private_handle_.getParam("lateral_frequency", lateral_frequency_);
+  private_handle_.getParam("settle_time", settle_time_);
+  private_handle_.getParam("report_period", report_period_);
+  private_handle_.getParam("report_file", report_file_);
+  private_handle_.getParam("queue_size", queue_size);
+  private_handle_.getParam("ring_size", ring_size);
+  private_handle_.getParam("enable_statistics", enable_statistics);
+  private_handle_.getParam("playback_file", playback_file);
+  private_handle_.getParam("playback_loop", playback_loop_);
+
+  if (motion_ != "sine" && motion_ != "steps" && motion_ != "static")
+  {
+    ROS_ERROR("Unknown motion profile %s, use sine, steps or static", motion_.c_str());
+    return false;
+  }
+
+  if (!playback_file.empty())
+  {
+    std::ifstream file(playback_file.c_str());
+    std::string line;
+    while (std::getline(file, line))
+    {
+      for (std::size_t k = 0; k < line.size(); k++)
+        if (line[k] == ',')
+          line[k] = ' ';
+      std::istringstream fields(line);
+      PlaybackSample sample;
+      if (!(fields >> sample.time >> sample.orientation.w >> sample.orientation.x >> sample.orientation.y >>
+            sample.orientation.z))
+        continue;  // header or comment
+      if (!(fields >> sample.gesture))
+        sample.gesture = -1;
+      else
+        playback_gestures_ = true;
+      sample.orientation = prosthesis::normalize(sample.orientation);
+      playback_.push_back(sample);
+    }
+    if (playback_.empty())
+    {
+      ROS_ERROR("No samples in playback file %s", playback_file.c_str());
+      return false;
+    }
+    // there is no identity phase in playback, the node takes the first recorded pose as its reference
+    reference_.setReference(playback_.front().orientation);
+    ROS_INFO("Playing back %lu poses from %s", static_cast<unsigned long>(playback_.size()), playback_file.c_str());
+  }
+
+  // the subscribers of the nodes under test only report statistics if this is set when they start
+  if (enable_statistics)
+    ros::param::set("/enable_statistics", true);
+
+  sent_.resize(ring_size > 0 ? ring_size : 1);
+  pose_publisher_ = node_handle_.advertise<geometry_msgs::PoseStamped>("/myo_raw/pose", queue_size);
+  gesture_publisher_ = node_handle_.advertise<ros_myo::MyoPose>("/myo_raw/myo_gest", queue_size);
+  lateral_publisher_ = node_handle_.advertise<geometry_msgs::Twist>("/desired_lateral_cmd_pos", queue_size);
+
+  ros::TransportHints hints = ros::TransportHints().tcpNoDelay();
+  command_subscriber_ = node_handle_.subscribe("/cmd_pos", queue_size, &MyoLoadGenerator::commandCallback, this, hints);
+  force_subscriber_ =
+      node_handle_.subscribe("/gripperforce", queue_size, &MyoLoadGenerator::forceCallback, this, hints);
+  gripper_stats_subscriber_ =
+      node_handle_.subscribe("/gripper_forces/stats", 10, &MyoLoadGenerator::gripperStatsCallback, this);
+  statistics_subscriber_ = node_handle_.subscribe("/statistics", 100, &MyoLoadGenerator::statisticsCallback, this);
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Streams
+
+void MyoLoadGenerator::publishPose(double t)
+{
+  Quaternion q = { 1.0, 0.0, 0.0, 0.0 };
+  if (!playback_.empty())
+  {
+    q = playback_[playback_index_].orientation;
+  }
+  else if (t >= settle_time_)
+  {
+    const double s = t - settle_time_;
+    const double w = 2.0 * M_PI * frequency_;
+    if (motion_ == "sine")
+    {
+      q = fromRPY(amplitude_ * sin(w * s), amplitude_ * sin(1.3 * w * s + 1.0), amplitude_ * sin(0.7 * w * s + 2.0));
+    }
+    else if (motion_ == "steps")
+    {
+      // a new orientation every 1 / frequency, a fixed pseudo random sequence
+      const double step = floor(s * frequency_);
+      q = fromRPY(amplitude_ * sin(12.9898 * step), amplitude_ * sin(78.233 * step), amplitude_ * sin(37.719 * step));
+    }
+  }
+
+  geometry_msgs::PoseStampedPtr pose(new geometry_msgs::PoseStamped);
+  pose->header.seq = ++pose_seq_;
+  pose->header.stamp = ros::Time::now();
+  pose->header.frame_id = "myo";
+  pose->pose.orientation.w = q.w;
+  pose->pose.orientation.x = q.x;
+  pose->pose.orientation.y = q.y;
+  pose->pose.orientation.z = q.z;
+
+  // the angles myo_control_node will put into /cmd_pos
+  const prosthesis::RPY rpy = reference_.update(q);
+  SentPose sent;
+  sent.angular[0] = -rpy.yaw;
+  sent.angular[1] = rpy.pitch;
+  sent.angular[2] = -rpy.roll;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    sent.stamp = ros::WallTime::now();
+    sent_[poses_sent_ % sent_.size()] = sent;
+    poses_sent_++;
+  }
+  pose_publisher_.publish(pose);
+}
+
+void MyoLoadGenerator::publishGesture(double t)
+{
+  int gesture;
+  if (playback_gestures_)
+    gesture = playback_[playback_index_].gesture;
+  else
+    gesture = gesture_period_ > 0.0 && static_cast<long>(t / gesture_period_) % 2 ? 2 : 1;
+
+  // fist (2) and rest (1) flip the grasp, anything else keeps it
+  if ((gesture == 1 || gesture == 2) && gesture != gesture_)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    expected_force_ = gesture == 2 ? 30 : -30;
+    toggle_stamp_ = ros::WallTime::now();
+    toggles_sent_++;
+  }
+  if (gesture == 1 || gesture == 2)
+    gesture_ = gesture;
+
+  ros_myo::MyoPosePtr message(new ros_myo::MyoPose);
+  message->pose = gesture;
+  gesture_publisher_.publish(message);
+  gestures_sent_++;
+}
+
+void MyoLoadGenerator::publishLateral(double t)
+{
+  geometry_msgs::TwistPtr twist(new geometry_msgs::Twist);
+  const double w = 2.0 * M_PI * lateral_frequency_;
+  twist->linear.x = lateral_amplitude_ * sin(w * t);
+  twist->linear.y = lateral_amplitude_ * cos(w * t);
+  twist->linear.z = 0.0;
+  lateral_publisher_.publish(twist);
+  laterals_sent_++;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Outputs of the nodes under test
+
+void MyoLoadGenerator::commandCallback(const geometry_msgs::Twist::ConstPtr &twist)
+{
+  const ros::WallTime now = ros::WallTime::now();
+  boost::mutex::scoped_lock lock(mutex_);
+  commands_received_++;
+
+  // repeated outputs (keepalive, 10 Hz mode, lateral changes) say nothing about the poses
+  if (twist->angular.x == last_angular_[0] && twist->angular.y == last_angular_[1] &&
+      twist->angular.z == last_angular_[2])
+    return;
+
+  // newest pose with these angles that was not matched before
+  const uint64_t oldest = poses_sent_ > sent_.size() ? poses_sent_ - sent_.size() : 0;
+  const uint64_t first = last_matched_ > oldest ? last_matched_ : oldest;
+  for (uint64_t k = poses_sent_; k > first; k--)
+  {
+    const SentPose &sent = sent_[(k - 1) % sent_.size()];
+    if (fabs(sent.angular[0] - twist->angular.x) > 1e-9 || fabs(sent.angular[1] - twist->angular.y) > 1e-9 ||
+        fabs(sent.angular[2] - twist->angular.z) > 1e-9)
+      continue;
+
+    // go back to the first pose of a run of equal ones, the node only reacts to changes
+    uint64_t match = k;
+    while (match - 1 > first)
+    {
+      const SentPose &previous = sent_[(match - 2) % sent_.size()];
+      if (previous.angular[0] != sent.angular[0] || previous.angular[1] != sent.angular[1] ||
+          previous.angular[2] != sent.angular[2])
+        break;
+      match--;
+    }
+    const SentPose &origin = sent_[(match - 1) % sent_.size()];
+    pose_latency_.record(static_cast<uint64_t>((now - origin.stamp).toNSec()));
+    if (last_matched_ > 0)
+      poses_coalesced_ += match - last_matched_ - 1;
+    last_matched_ = k;
+    last_angular_[0] = twist->angular.x;
+    last_angular_[1] = twist->angular.y;
+    last_angular_[2] = twist->angular.z;
+    commands_matched_++;
+    return;
+  }
+}
+
+void MyoLoadGenerator::forceCallback(const std_msgs::Int16::ConstPtr &force)
+{
+  const ros::WallTime now = ros::WallTime::now();
+  boost::mutex::scoped_lock lock(mutex_);
+  if (toggles_sent_ > flips_seen_ && force->data == expected_force_)
+  {
+    gesture_latency_.record(static_cast<uint64_t>((now - toggle_stamp_).toNSec()));
+    flips_seen_ = toggles_sent_;
+  }
+}
+
+void MyoLoadGenerator::gripperStatsCallback(const prosthesis_v7::CommandStats::ConstPtr &stats)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  gripper_stats_ = *stats;
+}
+
+void MyoLoadGenerator::statisticsCallback(const rosgraph_msgs::TopicStatistics::ConstPtr &statistics)
+{
+  if (statistics->topic != "/myo_raw/pose" && statistics->topic != "/myo_raw/myo_gest" &&
+      statistics->topic != "/desired_lateral_cmd_pos" && statistics->topic != "/cmd_pos" &&
+      statistics->topic != "/gripperforce")
+    return;
+  if (statistics->node_sub == ros::this_node::getName())
+    return;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  SubscriberStatistics &sum = statistics_[statistics->topic + " -> " + statistics->node_sub];
+  sum.delivered += statistics->delivered_msgs;
+  sum.dropped += statistics->dropped_msgs;
+  sum.age_sum += statistics->stamp_age_mean.toSec() * statistics->delivered_msgs;
+  if (statistics->stamp_age_max.toSec() > sum.age_max)
+    sum.age_max = statistics->stamp_age_max.toSec();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Report
+
+void MyoLoadGenerator::report(bool final)
+{
+  static const double ms = 1e-6;
+  std::ostringstream out;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    out << "poses_sent: " << poses_sent_ << "\n"
+        << "cmd_pos_received: " << commands_received_ << "\n"
+        << "cmd_pos_matched: " << commands_matched_ << "\n"
+        << "poses_coalesced_or_dropped: " << poses_coalesced_ << "\n"
+        << "pose_latency_ms: {p50: " << ms * pose_latency_.percentile(0.5)
+        << ", p90: " << ms * pose_latency_.percentile(0.9) << ", p99: " << ms * pose_latency_.percentile(0.99)
+        << ", max: " << ms * pose_latency_.max() << "}\n"
+        << "gestures_sent: " << gestures_sent_ << "\n"
+        << "gesture_toggles: " << toggles_sent_ << "\n"
+        << "gripperforce_flips: " << gesture_latency_.count() << "\n"
+        << "gesture_latency_ms: {p50: " << ms * gesture_latency_.percentile(0.5)
+        << ", p90: " << ms * gesture_latency_.percentile(0.9) << ", max: " << ms * gesture_latency_.max() << "}\n"
+        << "laterals_sent: " << laterals_sent_ << "\n"
+        << "gripper_forces: {received: " << gripper_stats_.received << ", applied: " << gripper_stats_.applied
+        << ", coalesced: " << gripper_stats_.coalesced << ", dropped: " << gripper_stats_.dropped
+        << ", last_latency_ms: " << 1e3 * gripper_stats_.last_latency << "}\n";
+    out << "topic_statistics:\n";
+    for (std::map<std::string, SubscriberStatistics>::const_iterator it = statistics_.begin();
+         it != statistics_.end(); ++it)
+    {
+      const SubscriberStatistics &s = it->second;
+      out << "  \"" << it->first << "\": {delivered: " << s.delivered << ", seq_gaps: " << s.dropped
+          << ", stamp_age_mean_ms: " << (s.delivered ? 1e3 * s.age_sum / s.delivered : 0.0)
+          << ", stamp_age_max_ms: " << 1e3 * s.age_max << "}\n";
+    }
+  }
+
+  ROS_INFO("%s", out.str().c_str());
+  if (final && !report_file_.empty())
+  {
+    std::ofstream file(report_file_.c_str());
+    file << out.str();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Publishing loop with absolute deadlines, so high rates do not drift
+
+void MyoLoadGenerator::run()
+{
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  const ros::WallTime start = ros::WallTime::now();
+  const ros::WallDuration pose_period(pose_rate_ > 0 ? 1.0 / pose_rate_ : 0.0);
+  const ros::WallDuration gesture_period(gesture_rate_ > 0 ? 1.0 / gesture_rate_ : 0.0);
+  const ros::WallDuration lateral_period(lateral_rate_ > 0 ? 1.0 / lateral_rate_ : 0.0);
+  const ros::WallDuration report_period(report_period_ > 0 ? report_period_ : 1.0);
+  ros::WallTime next_pose = start, next_gesture = start, next_lateral = start, next_report = start + report_period;
+  uint64_t late = 0;
+
+  while (ros::ok())
+  {
+    const ros::WallTime now = ros::WallTime::now();
+    const double t = (now - start).toSec();
+    if (duration_ > 0 && t >= duration_)
+      break;
+
+    if (!playback_.empty())
+    {
+      // recorded timing, the gesture column travels with the poses
+      const double recorded = playback_[playback_index_].time - playback_.front().time + playback_offset_;
+      if (t >= recorded)
+      {
+        publishPose(t);
+        if (playback_[playback_index_].gesture >= 0)
+          publishGesture(t);
+        if (++playback_index_ == playback_.size())
+        {
+          if (!playback_loop_)
+            break;
+          // the next loop starts one mean sample interval after the last sample
+          const double span = playback_.back().time - playback_.front().time;
+          playback_offset_ += span + (playback_.size() > 1 ? span / (playback_.size() - 1) : 0.0);
+          playback_index_ = 0;
+        }
+      }
+      const double next = playback_[playback_index_].time - playback_.front().time + playback_offset_;
+      next_pose = start + ros::WallDuration(next);
+    }
+    else if (pose_rate_ > 0 && now >= next_pose)
+    {
+      publishPose(t);
+      next_pose += pose_period;
+      if (now - next_pose > pose_period)
+        late++;
+    }
+    if (gesture_rate_ > 0 && !playback_gestures_ && now >= next_gesture)
+    {
+      publishGesture(t);
+      next_gesture += gesture_period;
+    }
+    if (lateral_rate_ > 0 && now >= next_lateral)
+    {
+      publishLateral(t);
+      next_lateral += lateral_period;
+    }
+    if (now >= next_report)
+    {
+      if (late)
+        ROS_WARN("%lu poses more than one period late, the requested pose rate is too high",
+                 static_cast<unsigned long>(late));
+      report(false);
+      next_report += report_period;
+    }
+
+    ros::WallTime next = next_report;
+    if ((pose_rate_ > 0 || !playback_.empty()) && next_pose < next)
+      next = next_pose;
+    if (gesture_rate_ > 0 && !playback_gestures_ && next_gesture < next)
+      next = next_gesture;
+    if (lateral_rate_ > 0 && next_lateral < next)
+      next = next_lateral;
+    const ros::WallDuration wait = next - ros::WallTime::now();
+    if (wait > ros::WallDuration(0))
+      wait.sleep();
+  }
+
+  // give the last outputs time to arrive
+  ros::WallDuration(0.5).sleep();
+  report(true);
+}
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "myo_load_generator");
+
+  MyoLoadGenerator generator;
+  if (!generator.load())
+    return 1;
+  generator.run();
+  return 0;
+}
@@ -0,0 +1,205 @@
+#include <pid_bank.h>
+
+#include <cmath>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace prosthesis
+{
+//////////////////////////////////////////////////////////////////////////////
+// Gains
+
+void PIDGains::resize(std::size_t n)
+{
+  gain_p.resize(n, 0.0);
+  gain_i.resize(n, 0.0);
+  gain_d.resize(n, 0.0);
+  time_constant.resize(n, 0.0);
+  limit.resize(n, -1.0);
+}
+
+std::size_t PIDGains::size() const
+{
+  return gain_p.size();
+}
+
+void PIDGains::set(std::size_t k, double gain_p_new, double gain_i_new, double gain_d_new, double time_constant_new)
+{
+  gain_p[k] = gain_p_new;
+  gain_i[k] = gain_i_new;
+  gain_d[k] = gain_d_new;
+  time_constant[k] = time_constant_new;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Bank
+
+PIDBank::PIDBank(std::size_t n)
+{
+  resize(n);
+}
+
+void PIDBank::resize(std::size_t n)
+{
+  input.resize(n, 0.0);
+  dinput.resize(n, 0.0);
+  output.resize(n, 0.0);
+  p.resize(n, 0.0);
+  i.resize(n, 0.0);
+  d.resize(n, 0.0);
+}
+
+std::size_t PIDBank::size() const
+{
+  return output.size();
+}
+
+double PIDBank::update(const PIDGains& gains, std::size_t k, double new_input, double x, double dx, double dt)
+{
+  // limit command
+  if (gains.limit[k] > 0.0 && fabs(new_input) > gains.limit[k])
+    new_input = (new_input < 0 ? -1.0 : 1.0) * gains.limit[k];
+
+  // filter command
+  const double time_constant = gains.time_constant[k];
+  if (dt + time_constant > 0.0)
+  {
+    dinput[k] = (new_input - input[k]) / (dt + time_constant);
+    input[k] = (dt * new_input + time_constant * input[k]) / (dt + time_constant);
+  }
+
+  // update proportional, differential and integral errors
+  p[k] = input[k] - x;
+  d[k] = dinput[k] - dx;
+  i[k] = i[k] + dt * p[k];
+
+  // update control output
+  output[k] = gains.gain_p[k] * p[k] + gains.gain_d[k] * d[k] + gains.gain_i[k] * i[k];
+  return output[k];
+}
+
+void PIDBank::update(const PIDGains& gains, std::size_t begin, std::size_t end, const double* new_input,
+                     const double* x, const double* dx, double dt)
+{
+  std::size_t k = begin;
+
+#if defined(__AVX__)
+  {
+    const __m256d vdt = _mm256_set1_pd(dt);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    for (; k + 4 <= end; k += 4)
+    {
+      const std::size_t j = k - begin;
+      __m256d in = _mm256_loadu_pd(new_input + j);
+
+      // limit command, copysign(limit, in) equals (in < 0 ? -1 : 1) * limit whenever the limit applies
+      __m256d limit = _mm256_loadu_pd(&gains.limit[k]);
+      __m256d limited = _mm256_and_pd(_mm256_cmp_pd(limit, zero, _CMP_GT_OQ),
+                                      _mm256_cmp_pd(_mm256_andnot_pd(sign, in), limit, _CMP_GT_OQ));
+      in = _mm256_blendv_pd(in, _mm256_or_pd(_mm256_and_pd(sign, in), limit), limited);
+
+      // filter command
+      __m256d time_constant = _mm256_loadu_pd(&gains.time_constant[k]);
+      __m256d denominator = _mm256_add_pd(vdt, time_constant);
+      __m256d filtered = _mm256_cmp_pd(denominator, zero, _CMP_GT_OQ);
+      __m256d old_input = _mm256_loadu_pd(&input[k]);
+      __m256d vdinput = _mm256_blendv_pd(_mm256_loadu_pd(&dinput[k]),
+                                         _mm256_div_pd(_mm256_sub_pd(in, old_input), denominator), filtered);
+      __m256d vinput = _mm256_blendv_pd(
+          old_input,
+          _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(vdt, in), _mm256_mul_pd(time_constant, old_input)), denominator),
+          filtered);
+
+      // update proportional, differential and integral errors
+      __m256d vp = _mm256_sub_pd(vinput, _mm256_loadu_pd(x + j));
+      __m256d vd = _mm256_sub_pd(vdinput, _mm256_loadu_pd(dx + j));
+      __m256d vi = _mm256_add_pd(_mm256_loadu_pd(&i[k]), _mm256_mul_pd(vdt, vp));
+
+      // update control output
+      __m256d out = _mm256_add_pd(
+          _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&gains.gain_p[k]), vp),
+                        _mm256_mul_pd(_mm256_loadu_pd(&gains.gain_d[k]), vd)),
+          _mm256_mul_pd(_mm256_loadu_pd(&gains.gain_i[k]), vi));
+
+      _mm256_storeu_pd(&input[k], vinput);
+      _mm256_storeu_pd(&dinput[k], vdinput);
+      _mm256_storeu_pd(&p[k], vp);
+      _mm256_storeu_pd(&d[k], vd);
+      _mm256_storeu_pd(&i[k], vi);
+      _mm256_storeu_pd(&output[k], out);
+    }
+  }
+#endif
+
+#if defined(__SSE2__)
+  {
+    const __m128d vdt = _mm_set1_pd(dt);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d sign = _mm_set1_pd(-0.0);
+    for (; k + 2 <= end; k += 2)
+    {
+      const std::size_t j = k - begin;
+      __m128d in = _mm_loadu_pd(new_input + j);
+
+      // limit command, SSE2 has no blend so the selects are done with and/andnot/or
+      __m128d limit = _mm_loadu_pd(&gains.limit[k]);
+      __m128d limited = _mm_and_pd(_mm_cmpgt_pd(limit, zero), _mm_cmpgt_pd(_mm_andnot_pd(sign, in), limit));
+      in = _mm_or_pd(_mm_andnot_pd(limited, in), _mm_and_pd(limited, _mm_or_pd(_mm_and_pd(sign, in), limit)));
+
+      // filter command
+      __m128d time_constant = _mm_loadu_pd(&gains.time_constant[k]);
+      __m128d denominator = _mm_add_pd(vdt, time_constant);
+      __m128d filtered = _mm_cmpgt_pd(denominator, zero);
+      __m128d old_input = _mm_loadu_pd(&input[k]);
+      __m128d new_dinput = _mm_div_pd(_mm_sub_pd(in, old_input), denominator);
+      __m128d new_input_filtered =
+          _mm_div_pd(_mm_add_pd(_mm_mul_pd(vdt, in), _mm_mul_pd(time_constant, old_input)), denominator);
+      __m128d vdinput =
+          _mm_or_pd(_mm_andnot_pd(filtered, _mm_loadu_pd(&dinput[k])), _mm_and_pd(filtered, new_dinput));
+      __m128d vinput = _mm_or_pd(_mm_andnot_pd(filtered, old_input), _mm_and_pd(filtered, new_input_filtered));
+
+      // update proportional, differential and integral errors
+      __m128d vp = _mm_sub_pd(vinput, _mm_loadu_pd(x + j));
+      __m128d vd = _mm_sub_pd(vdinput, _mm_loadu_pd(dx + j));
+      __m128d vi = _mm_add_pd(_mm_loadu_pd(&i[k]), _mm_mul_pd(vdt, vp));
+
+      // update control output
+      __m128d out = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_loadu_pd(&gains.gain_p[k]), vp),
+                                          _mm_mul_pd(_mm_loadu_pd(&gains.gain_d[k]), vd)),
+                               _mm_mul_pd(_mm_loadu_pd(&gains.gain_i[k]), vi));
+
+      _mm_storeu_pd(&input[k], vinput);
+      _mm_storeu_pd(&dinput[k], vdinput);
+      _mm_storeu_pd(&p[k], vp);
+      _mm_storeu_pd(&d[k], vd);
+      _mm_storeu_pd(&i[k], vi);
+      _mm_storeu_pd(&output[k], out);
+    }
+  }
+#endif
+
+  // scalar fallback and remainder
+  for (; k < end; k++)
+  {
+    const std::size_t j = k - begin;
+    update(gains, k, new_input[j], x[j], dx[j], dt);
+  }
+}
+
+void PIDBank::reset(std::size_t begin, std::size_t end)
+{
+  for (std::size_t k = begin; k < end; k++)
+  {
+    input[k] = dinput[k] = 0;
+    p[k] = i[k] = d[k] = output[k] = 0;
+  }
+}
+
+void PIDBank::reset()
+{
+  reset(0, size());
+}
+}
@@ -0,0 +1,60 @@
+#include <relative_orientation.h>
+
+#include <cmath>
+
+namespace prosthesis
+{
+// angle on the 2 pi branch nearest to previous
+static inline double unwrap(double angle, double previous)
+{
+  return previous + std::remainder(angle - previous, 2.0 * M_PI);
+}
+
+static inline RPY unwrap(const RPY& rpy, const RPY& previous)
+{
+  RPY r = { unwrap(rpy.roll, previous.roll), unwrap(rpy.pitch, previous.pitch), unwrap(rpy.yaw, previous.yaw) };
+  return r;
+}
+
+RelativeOrientation::RelativeOrientation() : has_reference_(false)
+{
+  reference_inverse_.w = 1.0;
+  reference_inverse_.x = reference_inverse_.y = reference_inverse_.z = 0.0;
+  previous_.roll = previous_.pitch = previous_.yaw = 0.0;
+}
+
+void RelativeOrientation::setReference(const Quaternion& q)
+{
+  reference_inverse_ = conjugate(normalize(q));
+  has_reference_ = true;
+  previous_.roll = previous_.pitch = previous_.yaw = 0.0;
+}
+
+bool RelativeOrientation::hasReference() const
+{
+  return has_reference_;
+}
+
+RPY RelativeOrientation::update(const Quaternion& q)
+{
+  previous_ = unwrap(toRPY(multiply(reference_inverse_, q)), previous_);
+  return previous_;
+}
+
+void RelativeOrientation::update(const Quaternion* q, RPY* rpy, std::size_t n)
+{
+  // the relative rotations only depend on the reference, so the multiplications of
+  // the whole block are independent of each other and can be pipelined/vectorized,
+  // only the cheap unwrapping runs along the samples
+  const Quaternion r = reference_inverse_;
+  for (std::size_t k = 0; k < n; k++)
+  {
+    rpy[k] = toRPY(multiply(r, q[k]));
+  }
+  for (std::size_t k = 0; k < n; k++)
+  {
+    previous_ = unwrap(rpy[k], previous_);
+    rpy[k] = previous_;
+  }
+}
+}
@@ -0,0 +1,82 @@
+#include <rigid_body_plant.h>
+
+namespace prosthesis
+{
+RigidBodyPlant::RigidBodyPlant()
+{
+  parameters.mass = 1.0;
+  parameters.inertia.x = parameters.inertia.y = parameters.inertia.z = 1.0;
+  parameters.gravity.x = parameters.gravity.y = 0.0;
+  parameters.gravity.z = -9.81;
+  parameters.linear_damping = 0.0;
+  parameters.angular_damping = 0.0;
+
+  const Vector3 zero = { 0.0, 0.0, 0.0 };
+  const Quaternion identity = { 1.0, 0.0, 0.0, 0.0 };
+  reset(zero, identity);
+}
+
+RigidBodyPlant::RigidBodyPlant(const PlantParameters& parameters_) : parameters(parameters_)
+{
+  const Vector3 zero = { 0.0, 0.0, 0.0 };
+  const Quaternion identity = { 1.0, 0.0, 0.0, 0.0 };
+  reset(zero, identity);
+}
+
+void RigidBodyPlant::reset(const Vector3& position, const Quaternion& orientation)
+{
+  const Vector3 zero = { 0.0, 0.0, 0.0 };
+  position_ = position;
+  orientation_ = normalize(orientation);
+  velocity_ = zero;
+  angular_velocity_ = zero;
+  angular_acceleration_ = zero;
+}
+
+void RigidBodyPlant::step(const Vector3& force, const Vector3& torque, double dt)
+{
+  const PlantParameters& p = parameters;
+
+  // translation in the world frame
+  velocity_.x += dt * (force.x / p.mass + p.gravity.x - p.linear_damping * velocity_.x);
+  velocity_.y += dt * (force.y / p.mass + p.gravity.y - p.linear_damping * velocity_.y);
+  velocity_.z += dt * (force.z / p.mass + p.gravity.z - p.linear_damping * velocity_.z);
+  position_.x += dt * velocity_.x;
+  position_.y += dt * velocity_.y;
+  position_.z += dt * velocity_.z;
+
+  // rotation in the body frame, Euler's equations including the gyroscopic term
+  Vector3 w = rotateReverse(orientation_, angular_velocity_);
+  const Vector3 momentum = { p.inertia.x * w.x, p.inertia.y * w.y, p.inertia.z * w.z };
+  const Vector3 gyroscopic = { w.y * momentum.z - w.z * momentum.y, w.z * momentum.x - w.x * momentum.z,
+                               w.x * momentum.y - w.y * momentum.x };
+  w.x += dt * ((torque.x - gyroscopic.x) / p.inertia.x - p.angular_damping * w.x);
+  w.y += dt * ((torque.y - gyroscopic.y) / p.inertia.y - p.angular_damping * w.y);
+  w.z += dt * ((torque.z - gyroscopic.z) / p.inertia.z - p.angular_damping * w.z);
+
+  const Vector3 angular_velocity = rotate(orientation_, w);
+  angular_acceleration_.x = (angular_velocity.x - angular_velocity_.x) / dt;
+  angular_acceleration_.y = (angular_velocity.y - angular_velocity_.y) / dt;
+  angular_acceleration_.z = (angular_velocity.z - angular_velocity_.z) / dt;
+  angular_velocity_ = angular_velocity;
+
+  // first order quaternion update with the body rate, renormalized every step
+  const Quaternion delta = { 1.0, 0.5 * dt * w.x, 0.5 * dt * w.y, 0.5 * dt * w.z };
+  orientation_ = normalize(multiply(orientation_, delta));
+}
+
+LinkSample RigidBodyPlant::sample() const
+{
+  const RPY rpy = toRPY(orientation_);
+  LinkSample link;
+  link.position = position_;
+  link.orientation = orientation_;
+  link.euler.x = rpy.roll;
+  link.euler.y = rpy.pitch;
+  link.euler.z = rpy.yaw;
+  link.velocity = velocity_;
+  link.angular_velocity = angular_velocity_;
+  link.angular_acceleration = angular_acceleration_;
+  return link;
+}
+}
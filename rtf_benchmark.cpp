@@ -0,0 +1,553 @@
+// Real time factor benchmark of GazeboSimpleController on a headless gzserver
+// (launch/rtf_benchmark.launch starts both with worlds/prosthesis_benchmark.world).
+//
+// For every combination of physics step size, model count and plugin mode the benchmark
+// pauses the world, replaces the models by model_count copies of model_file, sets the step
+// size, runs warmup simulated seconds and then measures duration simulated seconds while it
+// publishes a scripted /<model>/cmd_pos trajectory to every model. Per run it records
+//  - the achieved real time factor and the wall time per physics step (max_update_rate 0 lets
+//    gzserver run as fast as it can, so this is the throughput of physics plus plugins)
+//  - the tracking error of the first tracked_models models, polled with get_model_state at
+//    error_rate and compared to the command at the stamp of the state
+//  - the p50/p99 of the plugin's update phase from get_profile, in builds with
+//    SIMPLE_CONTROLLER_ENABLE_PROFILING (since the spawn, so including the warmup)
+// and writes all runs to output_file (JSON) and csv_file.
+//
+// Modes: none (model without the plugin and with gravity off, the physics baseline without
+// contacts), standalone (one plugin with its own threads per model), batched (all plugins
+// stepped by the world's controller manager).
+//
+// Parameters (private): model_file, step_sizes, model_counts, modes, max_update_rate,
+// trajectory (hover, sine, steps), amplitude [m], angular_amplitude [rad], frequency [Hz],
+// hover_height, spacing, warmup and duration [simulated s], wall_timeout [s per phase],
+// command_rate, error_rate [Hz], tracked_models, output_file, csv_file, min_real_time_factor
+// (exit code 1 if a run with the plugin stays below it, 0 disables), max_position_error [m] and
+// max_orientation_error [rad] (exit code 1 if a run with the plugin has no tracking samples or its
+// rms error is NaN or above them, so a controller that ignores /cmd_pos does not pass unnoticed)
+#include <ros/ros.h>
+
+#include <gazebo_msgs/DeleteModel.h>
+#include <gazebo_msgs/GetModelState.h>
+#include <gazebo_msgs/GetPhysicsProperties.h>
+#include <gazebo_msgs/GetWorldProperties.h>
+#include <gazebo_msgs/SetPhysicsProperties.h>
+#include <gazebo_msgs/SpawnModel.h>
+#include <geometry_msgs/Twist.h>
+#include <prosthesis_v7/GetControllerProfile.h>
+#include <quaternion_math.h>
+#include <rosgraph_msgs/Clock.h>
+#include <std_srvs/Empty.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct RunConfig
+{
+  double step_size;
+  int models;
+  std::string mode;
+};
+
+struct RunResult
+{
+  RunConfig config;
+  double sim_time;
+  double wall_time;
+  double real_time_factor;
+  double step_wall_time;
+  uint64_t steps;
+  uint64_t error_samples;
+  double position_rms, position_max;        // [m]
+  double orientation_rms, orientation_max;  // largest roll/pitch/yaw deviation [rad]
+  double update_p50, update_p99;            // [s], negative without profiling
+};
+
+double wrapAngle(double angle)
+{
+  return atan2(sin(angle), cos(angle));
+}
+
+class RtfBenchmark
+{
+public:
+  RtfBenchmark();
+  bool load();
+
+  /// \brief runs the whole sweep, false if gzserver failed or a run missed min_real_time_factor
+  bool run();
+
+private:
+  bool setUp(const RunConfig &config);
+  bool removeModels();
+
+  /// \brief publish commands until the simulation advanced by sim_seconds, records errors if result is given
+  bool advance(double sim_seconds, RunResult *result);
+  bool simTime(double &time);
+  void command(int model, double t, geometry_msgs::Twist &twist) const;
+  void sampleErrors(RunResult &result);
+  void readProfile(RunResult &result);
+  std::string modelName(int model) const;
+
+  void clockCallback(const rosgraph_msgs::Clock::ConstPtr &clock);
+  void write() const;
+
+  ros::NodeHandle node_handle_;
+  ros::NodeHandle private_handle_;
+  ros::Subscriber clock_subscriber_;
+  std::vector<ros::Publisher> command_publishers_;
+  ros::ServiceClient get_model_state_;
+
+  std::string model_template_;
+  std::vector<double> step_sizes_;
+  std::vector<int> model_counts_;
+  std::vector<std::string> modes_;
+  double max_update_rate_;
+  std::string trajectory_;
+  double amplitude_, angular_amplitude_, frequency_, hover_height_, spacing_;
+  double warmup_, duration_, wall_timeout_, command_rate_, error_rate_;
+  int tracked_models_;
+  std::string output_file_, csv_file_;
+  double min_real_time_factor_;
+  double max_position_error_, max_orientation_error_;
+
+  int spawned_;
+  double clock_;  // latest /clock, written by clockCallback on this thread
+  std::vector<RunResult> results_;
+};
+
+RtfBenchmark::RtfBenchmark() : private_handle_("~"), spawned_(0), clock_(0.0)
+{
+}
+
+bool RtfBenchmark::load()
+{
+  std::string model_file;
+  max_update_rate_ = 0;
+  trajectory_ = "sine";
+  amplitude_ = 0.3;
+  angular_amplitude_ = 0.3;
+  frequency_ = 0.25;
+  hover_height_ = 1.0;
+  spacing_ = 2.0;
+  warmup_ = 2.0;
+  duration_ = 10.0;
+  wall_timeout_ = 300.0;
+  command_rate_ = 100;
+  error_rate_ = 20;
+  tracked_models_ = 4;
+  output_file_ = "rtf_benchmark.json";
+  min_real_time_factor_ = 0;
+  max_position_error_ = 1.0;
+  max_orientation_error_ = 1.0;
+
+  private_handle_.getParam("model_file", model_file);
+  if (!private_handle_.getParam("step_sizes", step_sizes_))
+    step_sizes_.assign(1, 0.001);
+  if (!private_handle_.getParam("model_counts", model_counts_))
+    model_counts_.assign(1, 1);
+  if (!private_handle_.getParam("modes", modes_))
+  {
+    modes_.push_back("none");
+    modes_.push_back("standalone");
+    modes_.push_back("batched");
+  }
+  private_handle_.getParam("max_update_rate", max_update_rate_);
+  private_handle_.getParam("trajectory", trajectory_);
+  private_handle_.getParam("amplitude", amplitude_);
+  private_handle_.getParam("angular_amplitude", angular_amplitude_);
+  private_handle_.getParam("frequency", frequency_);
+  private_handle_.getParam("hover_height", hover_height_);
+  private_handle_.getParam("spacing", spacing_);
+  private_handle_.getParam("warmup", warmup_);
+  private_handle_.getParam("duration", duration_);
+  private_handle_.getParam("wall_timeout", wall_timeout_);
+  private_handle_.getParam("command_rate", command_rate_);
+  private_handle_.getParam("error_rate", error_rate_);
+  private_handle_.getParam("tracked_models", tracked_models_);
+  private_handle_.getParam("output_file", output_file_);
+  private_handle_.getParam("csv_file", csv_file_);
+  private_handle_.getParam("min_real_time_factor", min_real_time_factor_);
+  private_handle_.getParam("max_position_error", max_position_error_);
+  private_handle_.getParam("max_orientation_error", max_orientation_error_);
+
+  if (trajectory_ != "hover" && trajectory_ != "sine" && trajectory_ != "steps")
+  {
+    ROS_ERROR("Unknown trajectory %s, use hover, sine or steps", trajectory_.c_str());
+    return false;
+  }
+  for (std::size_t k = 0; k < modes_.size(); k++)
+  {
+    if (modes_[k] != "none" && modes_[k] != "standalone" && modes_[k] != "batched")
+    {
+      ROS_ERROR("Unknown mode %s, use none, standalone or batched", modes_[k].c_str());
+      return false;
+    }
+  }
+
+  std::ifstream file(model_file.c_str());
+  std::stringstream text;
+  text << file.rdbuf();
+  model_template_ = text.str();
+  if (model_template_.empty())
+  {
+    ROS_ERROR("Could not read the model_file %s", model_file.c_str());
+    return false;
+  }
+
+  clock_subscriber_ = node_handle_.subscribe("/clock", 10, &RtfBenchmark::clockCallback, this);
+  get_model_state_ = node_handle_.serviceClient<gazebo_msgs::GetModelState>("/gazebo/get_model_state", true);
+  return true;
+}
+
+bool RtfBenchmark::run()
+{
+  if (!ros::service::waitForService("/gazebo/spawn_sdf_model", ros::Duration(60)))
+  {
+    ROS_ERROR("gzserver with the gazebo_ros API is not running");
+    return false;
+  }
+
+  bool passed = true;
+  for (std::size_t s = 0; s < step_sizes_.size(); s++)
+  {
+    for (std::size_t m = 0; m < model_counts_.size(); m++)
+    {
+      for (std::size_t k = 0; k < modes_.size() && ros::ok(); k++)
+      {
+        RunResult result = RunResult();
+        result.config.step_size = step_sizes_[s];
+        result.config.models = model_counts_[m];
+        result.config.mode = modes_[k];
+        result.update_p50 = result.update_p99 = -1.0;
+
+        if (!setUp(result.config) || !advance(warmup_, NULL) || !advance(duration_, &result))
+        {
+          ROS_ERROR("Run with step size %g, %d models, mode %s failed", result.config.step_size, result.config.models,
+                    result.config.mode.c_str());
+          removeModels();
+          write();
+          return false;
+        }
+        readProfile(result);
+        results_.push_back(result);
+
+        ROS_INFO("step %g models %d mode %-10s rtf %6.3f step %8.1f us position rms %.4f orientation rms %.4f",
+                 result.config.step_size, result.config.models, result.config.mode.c_str(), result.real_time_factor,
+                 1e6 * result.step_wall_time, result.position_rms, result.orientation_rms);
+        if (min_real_time_factor_ > 0 && result.config.mode != "none" &&
+            result.real_time_factor < min_real_time_factor_)
+        {
+          ROS_ERROR("Real time factor %.3f is below the minimum %.3f", result.real_time_factor, min_real_time_factor_);
+          passed = false;
+        }
+        // written as !(error <= max) so a NaN fails as well
+        if (result.config.mode != "none" && error_rate_ > 0 &&
+            (result.error_samples == 0 || !(result.position_rms <= max_position_error_) ||
+             !(result.orientation_rms <= max_orientation_error_)))
+        {
+          ROS_ERROR("Tracking error (%llu samples, position rms %g, orientation rms %g) exceeds the maximum %g / %g",
+                    static_cast<unsigned long long>(result.error_samples), result.position_rms,
+                    result.orientation_rms, max_position_error_, max_orientation_error_);
+          passed = false;
+        }
+        write();
+      }
+    }
+  }
+
+  removeModels();
+  return passed;
+}
+
+std::string RtfBenchmark::modelName(int model) const
+{
+  std::ostringstream name;
+  name << "prosthesis_" << model;
+  return name.str();
+}
+
+static void replaceAll(std::string &text, const std::string &pattern, const std::string &value)
+{
+  for (std::size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + value.size()))
+    text.replace(at, pattern.size(), value);
+}
+
+bool RtfBenchmark::setUp(const RunConfig &config)
+{
+  std_srvs::Empty empty;
+  if (!ros::service::call("/gazebo/pause_physics", empty) || !removeModels())
+    return false;
+
+  gazebo_msgs::GetPhysicsProperties physics;
+  if (!ros::service::call("/gazebo/get_physics_properties", physics))
+    return false;
+  gazebo_msgs::SetPhysicsProperties set_physics;
+  set_physics.request.time_step = config.step_size;
+  set_physics.request.max_update_rate = max_update_rate_;
+  set_physics.request.gravity = physics.response.gravity;
+  set_physics.request.ode_config = physics.response.ode_config;
+  if (!ros::service::call("/gazebo/set_physics_properties", set_physics) || !set_physics.response.success)
+    return false;
+
+  std::string options, link_options;
+  if (config.mode == "batched")
+    options = "<batched>true</batched>";
+  if (config.mode == "none")
+    link_options = "<gravity>false</gravity>";
+
+  const int columns = static_cast<int>(ceil(sqrt(static_cast<double>(config.models))));
+  command_publishers_.clear();
+  for (int model = 0; model < config.models; model++)
+  {
+    std::string xml = model_template_;
+    if (config.mode == "none")
+    {
+      const std::size_t begin = xml.find("<plugin");
+      const std::size_t end = xml.find("</plugin>");
+      if (begin != std::string::npos && end != std::string::npos)
+        xml.erase(begin, end + 9 - begin);
+    }
+    replaceAll(xml, "@NAMESPACE@", modelName(model));
+    replaceAll(xml, "@OPTIONS@", options);
+    replaceAll(xml, "@LINK_OPTIONS@", link_options);
+
+    gazebo_msgs::SpawnModel spawn;
+    spawn.request.model_name = modelName(model);
+    spawn.request.model_xml = xml;
+    spawn.request.reference_frame = "world";
+    spawn.request.initial_pose.position.x = spacing_ * (model % columns);
+    spawn.request.initial_pose.position.y = spacing_ * (model / columns);
+    spawn.request.initial_pose.position.z = hover_height_;
+    spawn.request.initial_pose.orientation.w = 1.0;
+    if (!ros::service::call("/gazebo/spawn_sdf_model", spawn) || !spawn.response.success)
+    {
+      ROS_ERROR("Could not spawn %s: %s", spawn.request.model_name.c_str(), spawn.response.status_message.c_str());
+      return false;
+    }
+    spawned_ = model + 1;
+    command_publishers_.push_back(node_handle_.advertise<geometry_msgs::Twist>("/" + modelName(model) + "/cmd_pos", 1));
+  }
+
+  return ros::service::call("/gazebo/unpause_physics", empty);
+}
+
+bool RtfBenchmark::removeModels()
+{
+  for (; spawned_ > 0; spawned_--)
+  {
+    gazebo_msgs::DeleteModel remove;
+    remove.request.model_name = modelName(spawned_ - 1);
+    if (!ros::service::call("/gazebo/delete_model", remove))
+      return false;
+  }
+  return true;
+}
+
+bool RtfBenchmark::simTime(double &time)
+{
+  gazebo_msgs::GetWorldProperties world;
+  if (!ros::service::call("/gazebo/get_world_properties", world) || !world.response.success)
+    return false;
+  time = world.response.sim_time;
+  return true;
+}
+
+bool RtfBenchmark::advance(double sim_seconds, RunResult *result)
+{
+  double start = 0.0;
+  if (!simTime(start))
+    return false;
+  const ros::WallTime wall_start = ros::WallTime::now();
+
+  ros::WallTime next_sample = wall_start;
+  ros::WallRate rate(command_rate_);
+  for (double now = start; now < start + sim_seconds; rate.sleep())
+  {
+    ros::spinOnce();
+    if (!ros::ok() || ros::WallTime::now() - wall_start > ros::WallDuration(wall_timeout_))
+      return false;
+
+    geometry_msgs::Twist twist;
+    for (std::size_t model = 0; model < command_publishers_.size(); model++)
+    {
+      command(model, clock_, twist);
+      command_publishers_[model].publish(twist);
+    }
+
+    // without the plugin the models just float, there is nothing to track
+    if (result && result->config.mode != "none" && error_rate_ > 0 && ros::WallTime::now() >= next_sample)
+    {
+      sampleErrors(*result);
+      next_sample += ros::WallDuration(1.0 / error_rate_);
+    }
+    now = clock_;
+  }
+
+  double end = 0.0;
+  if (!simTime(end))
+    return false;
+  if (result)
+  {
+    result->sim_time = end - start;
+    result->wall_time = (ros::WallTime::now() - wall_start).toSec();
+    result->real_time_factor = result->sim_time / result->wall_time;
+    result->steps = static_cast<uint64_t>(result->sim_time / result->config.step_size + 0.5);
+    result->step_wall_time = result->steps > 0 ? result->wall_time / result->steps : 0.0;
+    if (result->error_samples > 0)
+    {
+      result->position_rms = sqrt(result->position_rms / result->error_samples);
+      result->orientation_rms = sqrt(result->orientation_rms / result->error_samples);
+    }
+  }
+  return true;
+}
+
+// command of one model at simulated time t, around its spawn position
+void RtfBenchmark::command(int model, double t, geometry_msgs::Twist &twist) const
+{
+  const int columns = static_cast<int>(ceil(sqrt(static_cast<double>(command_publishers_.size()))));
+  twist.linear.x = spacing_ * (model % columns);
+  twist.linear.y = spacing_ * (model / columns);
+  twist.linear.z = hover_height_;
+  twist.angular.x = twist.angular.y = twist.angular.z = 0.0;
+
+  const double phase = 2 * M_PI * frequency_ * t;
+  if (trajectory_ == "sine")
+  {
+    twist.linear.x += amplitude_ * sin(phase);
+    twist.linear.y += amplitude_ * cos(phase) - amplitude_;
+    twist.linear.z += 0.5 * amplitude_ * sin(2 * phase);
+    twist.angular.z = angular_amplitude_ * sin(phase);
+  }
+  else if (trajectory_ == "steps")
+  {
+    const double sign = static_cast<int64_t>(floor(2 * frequency_ * t)) % 2 == 0 ? 1.0 : -1.0;
+    twist.linear.x += amplitude_ * sign;
+    twist.angular.z = angular_amplitude_ * sign;
+  }
+}
+
+void RtfBenchmark::sampleErrors(RunResult &result)
+{
+  const int tracked = std::min<int>(tracked_models_, command_publishers_.size());
+  for (int model = 0; model < tracked; model++)
+  {
+    gazebo_msgs::GetModelState state;
+    state.request.model_name = modelName(model);
+    if (!get_model_state_.call(state) || !state.response.success)
+      continue;
+
+    geometry_msgs::Twist expected;
+    command(model, state.response.header.stamp.toSec(), expected);
+    const geometry_msgs::Point &p = state.response.pose.position;
+    const double dx = p.x - expected.linear.x, dy = p.y - expected.linear.y, dz = p.z - expected.linear.z;
+    const double position = sqrt(dx * dx + dy * dy + dz * dz);
+
+    const geometry_msgs::Quaternion &o = state.response.pose.orientation;
+    const prosthesis::Quaternion q = { o.w, o.x, o.y, o.z };
+    const prosthesis::RPY rpy = prosthesis::toRPY(q);
+    const double orientation = std::max(std::max(fabs(wrapAngle(rpy.roll - expected.angular.x)),
+                                                 fabs(wrapAngle(rpy.pitch - expected.angular.y))),
+                                        fabs(wrapAngle(rpy.yaw - expected.angular.z)));
+
+    // the rms fields hold the sums of squares until advance() finishes the run
+    result.error_samples++;
+    result.position_rms += position * position;
+    result.orientation_rms += orientation * orientation;
+    result.position_max = std::max(result.position_max, position);
+    result.orientation_max = std::max(result.orientation_max, orientation);
+  }
+}
+
+void RtfBenchmark::readProfile(RunResult &result)
+{
+  if (result.config.mode == "none")
+    return;
+  const std::string service = "/" + modelName(0) + "/get_profile";
+  prosthesis_v7::GetControllerProfile profile;
+  if (!ros::service::exists(service, false) || !ros::service::call(service, profile))
+    return;
+  const std::vector<prosthesis_v7::TimingHistogram> &histograms = profile.response.profile.histograms;
+  for (std::size_t k = 0; k < histograms.size(); k++)
+  {
+    if (histograms[k].name == "update")
+    {
+      result.update_p50 = histograms[k].p50;
+      result.update_p99 = histograms[k].p99;
+    }
+  }
+}
+
+void RtfBenchmark::clockCallback(const rosgraph_msgs::Clock::ConstPtr &clock)
+{
+  clock_ = clock->clock.toSec();
+}
+
+// rewritten after every run, so an aborted sweep keeps the finished runs
+void RtfBenchmark::write() const
+{
+  FILE *json = fopen(output_file_.c_str(), "w");
+  if (!json)
+  {
+    ROS_ERROR("Could not write %s", output_file_.c_str());
+  }
+  else
+  {
+    fprintf(json, "{\n  \"trajectory\": \"%s\",\n  \"max_update_rate\": %g,\n  \"runs\": [", trajectory_.c_str(),
+            max_update_rate_);
+    for (std::size_t k = 0; k < results_.size(); k++)
+    {
+      const RunResult &r = results_[k];
+      fprintf(json, "%s\n    {\"step_size\": %g, \"models\": %d, \"mode\": \"%s\", \"sim_time\": %.6f, "
+                    "\"wall_time\": %.6f, \"real_time_factor\": %.6f, \"steps\": %llu, \"step_wall_time\": %.9f, "
+                    "\"error_samples\": %llu, \"position_rms\": %.6f, \"position_max\": %.6f, "
+                    "\"orientation_rms\": %.6f, \"orientation_max\": %.6f, \"update_p50\": %.9f, "
+                    "\"update_p99\": %.9f}",
+              k ? "," : "", r.config.step_size, r.config.models, r.config.mode.c_str(), r.sim_time, r.wall_time,
+              r.real_time_factor, static_cast<unsigned long long>(r.steps), r.step_wall_time,
+              static_cast<unsigned long long>(r.error_samples), r.position_rms, r.position_max, r.orientation_rms,
+              r.orientation_max, r.update_p50, r.update_p99);
+    }
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+  }
+
+  if (csv_file_.empty())
+    return;
+  FILE *csv = fopen(csv_file_.c_str(), "w");
+  if (!csv)
+  {
+    ROS_ERROR("Could not write %s", csv_file_.c_str());
+    return;
+  }
+  fprintf(csv, "step_size,models,mode,sim_time,wall_time,real_time_factor,steps,step_wall_time,error_samples,"
+               "position_rms,position_max,orientation_rms,orientation_max,update_p50,update_p99\n");
+  for (std::size_t k = 0; k < results_.size(); k++)
+  {
+    const RunResult &r = results_[k];
+    fprintf(csv, "%g,%d,%s,%.6f,%.6f,%.6f,%llu,%.9f,%llu,%.6f,%.6f,%.6f,%.6f,%.9f,%.9f\n", r.config.step_size,
+            r.config.models, r.config.mode.c_str(), r.sim_time, r.wall_time, r.real_time_factor,
+            static_cast<unsigned long long>(r.steps), r.step_wall_time,
+            static_cast<unsigned long long>(r.error_samples), r.position_rms, r.position_max, r.orientation_rms,
+            r.orientation_max, r.update_p50, r.update_p99);
+  }
+  fclose(csv);
+}
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "rtf_benchmark");
+
+  RtfBenchmark benchmark;
+  if (!benchmark.load())
+    return 1;
+  return benchmark.run() ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include <setpoint_predictor.h>
+
+#include <cmath>
+
+namespace prosthesis
+{
+// the angle a - b on (-pi, pi]
+static double angleDifference(double a, double b)
+{
+  return std::remainder(a - b, 2.0 * M_PI);
+}
+
+SetpointPredictor::SetpointPredictor() : horizon(0.0), max_interval(0.5)
+{
+  reset();
+}
+
+void SetpointPredictor::reset()
+{
+  const Quaternion identity = { 1.0, 0.0, 0.0, 0.0 };
+  previous_ = latest_ = identity;
+  latest_rpy_.x = latest_rpy_.y = latest_rpy_.z = 0.0;
+  latest_time_ = 0.0;
+  interval_ = 0.0;
+  has_command_ = false;
+}
+
+void SetpointPredictor::command(const Vector3& rpy, double time)
+{
+  const Quaternion orientation = fromRPY(rpy.x, rpy.y, rpy.z);
+  // a second command within the same instant replaces the latest one and keeps the interval to the one before
+  if (has_command_ && time > latest_time_)
+  {
+    previous_ = latest_;
+    interval_ = time - latest_time_;
+  }
+  latest_ = orientation;
+  latest_rpy_ = rpy;
+  latest_time_ = time;
+  has_command_ = true;
+}
+
+Vector3 SetpointPredictor::predict(double time) const
+{
+  if (horizon <= 0.0 || interval_ <= 0.0 || interval_ > max_interval)
+    return latest_rpy_;
+
+  double ahead = time - latest_time_;
+  if (ahead <= 0.0)
+    return latest_rpy_;
+  if (ahead > horizon)
+    ahead = horizon;
+
+  const RPY rpy = toRPY(slerp(previous_, latest_, 1.0 + ahead / interval_));
+  Vector3 setpoint = { latest_rpy_.x + angleDifference(rpy.roll, latest_rpy_.x),
+                       latest_rpy_.y + angleDifference(rpy.pitch, latest_rpy_.y),
+                       latest_rpy_.z + angleDifference(rpy.yaw, latest_rpy_.z) };
+  return setpoint;
+}
+
+bool SetpointPredictor::hasCommand() const
+{
+  return has_command_;
+}
+}
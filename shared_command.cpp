@@ -0,0 +1,148 @@
+#include <shared_command.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace prosthesis
+{
+double sharedCommandClock()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + 1e-9 * now.tv_nsec;
+}
+
+// create the object if needed (a new object is zero filled, i.e. holds no command) and map it
+static SharedCommandBlock* mapBlock(const std::string& name)
+{
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd < 0)
+    return NULL;
+
+  struct stat status;
+  const off_t size = sizeof(SharedCommandBlock);
+  if (fstat(fd, &status) != 0 || (status.st_size < size && ftruncate(fd, size) != 0))
+  {
+    ::close(fd);
+    return NULL;
+  }
+
+  void* memory = mmap(NULL, sizeof(SharedCommandBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  return memory != MAP_FAILED ? static_cast<SharedCommandBlock*>(memory) : NULL;
+}
+
+static void unmapBlock(SharedCommandBlock* block)
+{
+  if (block)
+    munmap(block, sizeof(SharedCommandBlock));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Writer
+
+SharedCommandWriter::SharedCommandWriter() : block_(NULL)
+{
+}
+
+SharedCommandWriter::~SharedCommandWriter()
+{
+  close();
+}
+
+bool SharedCommandWriter::open(const std::string& name)
+{
+  close();
+  block_ = mapBlock(name);
+  return block_ != NULL;
+}
+
+bool SharedCommandWriter::isOpen() const
+{
+  return block_ != NULL;
+}
+
+void SharedCommandWriter::close()
+{
+  unmapBlock(block_);
+  block_ = NULL;
+}
+
+void SharedCommandWriter::write(const Vector3& linear, const Vector3& angular)
+{
+  const double values[7] = { linear.x, linear.y, linear.z, angular.x, angular.y, angular.z, sharedCommandClock() };
+
+  // a restarted writer continues the sequence of its predecessor
+  const uint64_t sequence = block_->sequence.load(std::memory_order_relaxed) | 1;
+  block_->sequence.store(sequence, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (int k = 0; k < 7; k++)
+    block_->values[k].store(values[k], std::memory_order_relaxed);
+  block_->sequence.store(sequence + 1, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Reader
+
+SharedCommandReader::SharedCommandReader() : block_(NULL), last_sequence_(0)
+{
+}
+
+SharedCommandReader::~SharedCommandReader()
+{
+  close();
+}
+
+bool SharedCommandReader::open(const std::string& name)
+{
+  close();
+  block_ = mapBlock(name);
+  last_sequence_ = 0;
+  return block_ != NULL;
+}
+
+bool SharedCommandReader::isOpen() const
+{
+  return block_ != NULL;
+}
+
+void SharedCommandReader::close()
+{
+  unmapBlock(block_);
+  block_ = NULL;
+}
+
+bool SharedCommandReader::read(SharedCommand& command)
+{
+  static const int attempts = 4;
+  for (int attempt = 0; attempt < attempts; attempt++)
+  {
+    const uint64_t sequence = block_->sequence.load(std::memory_order_acquire);
+    if (sequence == last_sequence_)
+      return false;
+    if (sequence & 1)
+      continue;
+
+    double values[7];
+    for (int k = 0; k < 7; k++)
+      values[k] = block_->values[k].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (block_->sequence.load(std::memory_order_relaxed) != sequence)
+      continue;
+
+    command.linear.x = values[0];
+    command.linear.y = values[1];
+    command.linear.z = values[2];
+    command.angular.x = values[3];
+    command.angular.y = values[4];
+    command.angular.z = values[5];
+    command.stamp = values[6];
+    last_sequence_ = sequence;
+    return true;
+  }
+  return false;
+}
+}
@@ -0,0 +1,364 @@
+#include <simple_controller_batch.h>
+
+#include <cmath>
+
+namespace prosthesis
+{
+typedef SimpleControllerCore Core;
+
+// models per OpenMP work item, large enough for long vector passes per layer
+static const std::size_t chunk_size = 32;
+
+SimpleControllerBatch::SimpleControllerBatch()
+  : cascade(Core::POSITION_CASCADE), parallel_threshold(2 * chunk_size), size_(0)
+{
+}
+
+std::size_t SimpleControllerBatch::size() const
+{
+  return size_;
+}
+
+std::size_t SimpleControllerBatch::addModel()
+{
+  ControllerParameters p;
+  p.mass = 0.0;
+  p.inertia.x = p.inertia.y = p.inertia.z = 0.0;
+  p.max_force = -1.0;
+  p.max_torque = -1.0;
+  parameters.push_back(p);
+  inputs.push_back(makeControllerInput());
+  running.push_back(0);
+  outputs.push_back(ControllerOutput());
+
+  relayout(size_ + 1, size_);
+  return size_ - 1;
+}
+
+void SimpleControllerBatch::removeModel(std::size_t model)
+{
+  parameters.erase(parameters.begin() + model);
+  inputs.erase(inputs.begin() + model);
+  running.erase(running.begin() + model);
+  outputs.erase(outputs.begin() + model);
+
+  relayout(size_ - 1, model);
+}
+
+// move every loop to its index for the new model count, skipping model removed
+// (removed == size_ when a model is appended)
+void SimpleControllerBatch::relayout(std::size_t size, std::size_t removed)
+{
+  PIDGains new_gains;
+  PIDBank new_controllers(size * Core::CONTROLLER_COUNT);
+  new_gains.resize(size * Core::CONTROLLER_COUNT);
+
+  for (int c = 0; c < Core::CONTROLLER_COUNT; c++)
+  {
+    for (std::size_t m = 0, n = 0; m < size_; m++)
+    {
+      if (m == removed)
+        continue;
+      const std::size_t from = index(c, m);
+      const std::size_t to = c * size + n++;
+      new_gains.set(to, gains.gain_p[from], gains.gain_i[from], gains.gain_d[from], gains.time_constant[from]);
+      new_gains.limit[to] = gains.limit[from];
+      new_controllers.input[to] = controllers.input[from];
+      new_controllers.dinput[to] = controllers.dinput[from];
+      new_controllers.output[to] = controllers.output[from];
+      new_controllers.p[to] = controllers.p[from];
+      new_controllers.i[to] = controllers.i[from];
+      new_controllers.d[to] = controllers.d[from];
+    }
+  }
+
+  gains.gain_p.swap(new_gains.gain_p);
+  gains.gain_i.swap(new_gains.gain_i);
+  gains.gain_d.swap(new_gains.gain_d);
+  gains.time_constant.swap(new_gains.time_constant);
+  gains.limit.swap(new_gains.limit);
+  controllers.input.swap(new_controllers.input);
+  controllers.dinput.swap(new_controllers.dinput);
+  controllers.output.swap(new_controllers.output);
+  controllers.p.swap(new_controllers.p);
+  controllers.i.swap(new_controllers.i);
+  controllers.d.swap(new_controllers.d);
+
+  size_ = size;
+  new_input_.assign(size * Core::CONTROLLER_COUNT, 0.0);
+  x_.assign(size * Core::CONTROLLER_COUNT, 0.0);
+  dx_.assign(size * Core::CONTROLLER_COUNT, 0.0);
+  gravity_.assign(size, 0.0);
+  load_factor_.assign(size, 0.0);
+  held_.assign(6 * 3 * size, 0.0);
+}
+
+void SimpleControllerBatch::setGains(std::size_t model, const PIDGains& model_gains)
+{
+  for (int c = 0; c < Core::CONTROLLER_COUNT; c++)
+  {
+    const std::size_t k = index(c, model);
+    gains.set(k, model_gains.gain_p[c], model_gains.gain_i[c], model_gains.gain_d[c], model_gains.time_constant[c]);
+    gains.limit[k] = model_gains.limit[c];
+  }
+}
+
+void SimpleControllerBatch::reset(std::size_t model)
+{
+  // attitude and velocity loops
+  for (int c = Core::ROLL; c < Core::ROLL_VEL; c++)
+    controllers.reset(index(c, model), index(c, model) + 1);
+}
+
+void SimpleControllerBatch::update(double dt)
+{
+  const double outer_dt = outer_schedule.advance(dt);
+
+#ifdef _OPENMP
+  if (size_ >= parallel_threshold)
+  {
+    const long chunks = static_cast<long>((size_ + chunk_size - 1) / chunk_size);
+#pragma omp parallel for schedule(static)
+    for (long chunk = 0; chunk < chunks; chunk++)
+    {
+      const std::size_t begin = chunk * chunk_size;
+      const std::size_t end = begin + chunk_size < size_ ? begin + chunk_size : size_;
+      updateModels(begin, end, dt, outer_dt);
+    }
+    return;
+  }
+#endif
+  updateModels(0, size_, dt, outer_dt);
+}
+
+// step controllers [first, last) of models [begin, end) on the gathered x_/dx_, the commands of controller c
+// are the values of controller c - first + input_first in new_input, which is laid out like the bank
+void SimpleControllerBatch::stepLayer(int first, int last, std::size_t begin, std::size_t end,
+                                      const double* new_input, int input_first, double dt)
+{
+  for (int c = first; c < last; c++)
+  {
+    const std::size_t k = index(c, begin);
+    controllers.update(gains, k, k + (end - begin), new_input + index(c - first + input_first, begin), &x_[k],
+                       &dx_[k], dt);
+  }
+}
+
+void SimpleControllerBatch::updateModels(std::size_t begin, std::size_t end, double dt, double outer_dt)
+{
+  bool any_running = false;
+  for (std::size_t m = begin; m < end; m++)
+  {
+    ControllerOutput& output = outputs[m];
+    output.force.x = output.force.y = output.force.z = 0.0;
+    output.torque.x = output.torque.y = output.torque.z = 0.0;
+    output.velocity_command_linear = inputs[m].velocity_command_linear;
+    output.velocity_command_angular = inputs[m].velocity_command_angular;
+    any_running = any_running || running[m];
+  }
+
+  if (any_running)
+  {
+    // the position loops of models that are not running keep their state, as in SimpleControllerCore
+    if (cascade == Core::POSITION_CASCADE)
+    {
+      for (std::size_t m = begin; m < end; m++)
+      {
+        if (running[m])
+          continue;
+        for (int c = Core::POSITION_X; c <= Core::POSITION_Z; c++)
+        {
+          const std::size_t k = index(c, m);
+          double* h = &held_[6 * (3 * m + c)];
+          h[0] = controllers.input[k];
+          h[1] = controllers.dinput[k];
+          h[2] = controllers.output[k];
+          h[3] = controllers.p[k];
+          h[4] = controllers.i[k];
+          h[5] = controllers.d[k];
+        }
+      }
+      updatePositionCascade(begin, end, dt, outer_dt);
+      for (std::size_t m = begin; m < end; m++)
+      {
+        if (running[m])
+          continue;
+        for (int c = Core::POSITION_X; c <= Core::POSITION_Z; c++)
+        {
+          const std::size_t k = index(c, m);
+          const double* h = &held_[6 * (3 * m + c)];
+          controllers.input[k] = h[0];
+          controllers.dinput[k] = h[1];
+          controllers.output[k] = h[2];
+          controllers.p[k] = h[3];
+          controllers.i[k] = h[4];
+          controllers.d[k] = h[5];
+        }
+      }
+    }
+    else
+    {
+      updateVelocityCascade(begin, end, dt, outer_dt);
+    }
+  }
+
+  for (std::size_t m = begin; m < end; m++)
+  {
+    if (running[m])
+      continue;
+    // everything but the position loops, with a zero output
+    ControllerOutput& output = outputs[m];
+    output.force.x = output.force.y = output.force.z = 0.0;
+    output.torque.x = output.torque.y = output.torque.z = 0.0;
+    output.velocity_command_linear = inputs[m].velocity_command_linear;
+    output.velocity_command_angular = inputs[m].velocity_command_angular;
+    for (int c = Core::ROLL; c < Core::CONTROLLER_COUNT; c++)
+      controllers.reset(index(c, m), index(c, m) + 1);
+  }
+}
+
+void SimpleControllerBatch::updatePositionCascade(std::size_t begin, std::size_t end, double dt, double outer_dt)
+{
+  // outer layer: position and attitude loops of all models, when due
+  for (std::size_t m = begin; m < end; m++)
+  {
+    const ControllerInput& in = inputs[m];
+    computeGravity(in.orientation, in.gravity, gravity_[m], load_factor_[m]);
+
+    new_input_[index(Core::POSITION_X, m)] = in.position_command_linear.x;
+    new_input_[index(Core::POSITION_Y, m)] = in.position_command_linear.y;
+    new_input_[index(Core::POSITION_Z, m)] = in.position_command_linear.z;
+    new_input_[index(Core::ROLL, m)] = in.position_command_angular.x;
+    new_input_[index(Core::PITCH, m)] = in.position_command_angular.y;
+    new_input_[index(Core::YAW, m)] = in.position_command_angular.z;
+    x_[index(Core::POSITION_X, m)] = in.position.x;
+    x_[index(Core::POSITION_Y, m)] = in.position.y;
+    x_[index(Core::POSITION_Z, m)] = in.position.z;
+    x_[index(Core::ROLL, m)] = in.euler.x;
+    x_[index(Core::PITCH, m)] = in.euler.y;
+    x_[index(Core::YAW, m)] = in.euler.z;
+    dx_[index(Core::POSITION_X, m)] = in.velocity.x;
+    dx_[index(Core::POSITION_Y, m)] = in.velocity.y;
+    dx_[index(Core::POSITION_Z, m)] = in.velocity.z;
+    dx_[index(Core::ROLL, m)] = in.angular_velocity.x;
+    dx_[index(Core::PITCH, m)] = in.angular_velocity.y;
+    dx_[index(Core::YAW, m)] = in.angular_velocity.z;
+
+    // inner layer inputs
+    x_[index(Core::VELOCITY_X, m)] = in.velocity.x;
+    x_[index(Core::VELOCITY_Y, m)] = in.velocity.y;
+    x_[index(Core::VELOCITY_Z, m)] = in.velocity.z;
+    x_[index(Core::ROLL_VEL, m)] = in.angular_velocity.x;
+    x_[index(Core::PITCH_VEL, m)] = in.angular_velocity.y;
+    x_[index(Core::YAW_VEL, m)] = in.angular_velocity.z;
+    dx_[index(Core::VELOCITY_X, m)] = in.acceleration.x;
+    dx_[index(Core::VELOCITY_Y, m)] = in.acceleration.y;
+    dx_[index(Core::VELOCITY_Z, m)] = in.acceleration.z;
+    dx_[index(Core::ROLL_VEL, m)] = in.angular_acceleration.x;
+    dx_[index(Core::PITCH_VEL, m)] = in.angular_acceleration.y;
+    dx_[index(Core::YAW_VEL, m)] = in.angular_acceleration.z;
+  }
+  if (outer_dt > 0.0)
+    stepLayer(Core::POSITION_X, Core::VELOCITY_X, begin, end, new_input_.data(), Core::POSITION_X, outer_dt);
+
+  // inner layer: velocity and rate loops, commanded by the outputs of the outer layer
+  stepLayer(Core::VELOCITY_X, Core::CONTROLLER_COUNT, begin, end, controllers.output.data(), Core::POSITION_X, dt);
+
+  for (std::size_t m = begin; m < end; m++)
+  {
+    const double* out = controllers.output.data();
+    ControllerOutput& output = outputs[m];
+    output.velocity_command_linear.x = out[index(Core::POSITION_X, m)];
+    output.velocity_command_linear.y = out[index(Core::POSITION_Y, m)];
+    output.velocity_command_linear.z = out[index(Core::POSITION_Z, m)];
+    output.velocity_command_angular.x = out[index(Core::ROLL, m)];
+    output.velocity_command_angular.y = out[index(Core::PITCH, m)];
+    output.velocity_command_angular.z = out[index(Core::YAW, m)];
+
+    const ControllerParameters& p = parameters[m];
+    Vector3& force = output.force;
+    Vector3& torque = output.torque;
+    force.x = p.mass * out[index(Core::VELOCITY_X, m)];
+    force.y = p.mass * out[index(Core::VELOCITY_Y, m)];
+    force.z = p.mass * (out[index(Core::VELOCITY_Z, m)] + load_factor_[m] * gravity_[m]);
+    torque.x = p.inertia.x * out[index(Core::ROLL_VEL, m)];
+    torque.y = p.inertia.y * out[index(Core::PITCH_VEL, m)];
+    torque.z = p.inertia.z * out[index(Core::YAW_VEL, m)];
+
+    // saturation, the same quirks as SimpleControllerCore
+    if (p.max_force > 0.0 && fabs(force.z) + 10 > p.max_force)
+      force.z = (force.z > p.max_force) ? p.max_force + 10 : -p.max_force - 10;
+    if (p.max_force > 0.0 && fabs(force.x) > p.max_force)
+      force.x = (force.x > p.max_force) ? p.max_force : -p.max_force;
+    if (p.max_force > 0.0 && fabs(force.y) > p.max_force)
+      force.y = (force.y > p.max_force) ? p.max_force : -p.max_force;
+    if (p.max_torque > 0.0 && fabs(torque.x) > p.max_torque)
+      torque.x = (torque.x > p.max_force) ? p.max_torque : -p.max_torque;
+    if (p.max_torque > 0.0 && fabs(torque.y) > p.max_torque)
+      torque.y = (torque.y > p.max_force) ? p.max_torque : -p.max_torque;
+    if (p.max_torque > 0.0 && fabs(torque.z) > p.max_torque)
+      torque.z = (torque.z > p.max_force) ? p.max_torque : -p.max_torque;
+  }
+}
+
+void SimpleControllerBatch::updateVelocityCascade(std::size_t begin, std::size_t end, double dt, double outer_dt)
+{
+  // first layer: velocity loops of all models, the horizontal ones only when due
+  for (std::size_t m = begin; m < end; m++)
+  {
+    const ControllerInput& in = inputs[m];
+    computeGravity(in.orientation, in.gravity, gravity_[m], load_factor_[m]);
+
+    // Rotate vectors to coordinate frames relevant for control
+    const Quaternion heading_quaternion = { cos(in.euler.z / 2), 0, 0, sin(in.euler.z / 2) };
+    const Vector3 velocity_xy = rotateReverse(heading_quaternion, in.velocity);
+    const Vector3 acceleration_xy = rotateReverse(heading_quaternion, in.acceleration);
+    const Vector3 angular_velocity_body = rotateReverse(in.orientation, in.angular_velocity);
+
+    new_input_[index(Core::VELOCITY_X, m)] = in.velocity_command_linear.x;
+    new_input_[index(Core::VELOCITY_Y, m)] = in.velocity_command_linear.y;
+    new_input_[index(Core::VELOCITY_Z, m)] = in.velocity_command_linear.z;
+    x_[index(Core::VELOCITY_X, m)] = velocity_xy.x;
+    x_[index(Core::VELOCITY_Y, m)] = velocity_xy.y;
+    x_[index(Core::VELOCITY_Z, m)] = in.velocity.z;
+    dx_[index(Core::VELOCITY_X, m)] = acceleration_xy.x;
+    dx_[index(Core::VELOCITY_Y, m)] = acceleration_xy.y;
+    dx_[index(Core::VELOCITY_Z, m)] = in.acceleration.z;
+
+    // second layer inputs but the roll/pitch commands
+    new_input_[index(Core::YAW, m)] = in.velocity_command_angular.z;
+    x_[index(Core::ROLL, m)] = in.euler.x;
+    x_[index(Core::PITCH, m)] = in.euler.y;
+    x_[index(Core::YAW, m)] = in.angular_velocity.z;
+    dx_[index(Core::ROLL, m)] = angular_velocity_body.x;
+    dx_[index(Core::PITCH, m)] = angular_velocity_body.y;
+    dx_[index(Core::YAW, m)] = 0;
+  }
+  if (outer_dt > 0.0)
+    stepLayer(Core::VELOCITY_X, Core::VELOCITY_Z, begin, end, new_input_.data(), Core::VELOCITY_X, outer_dt);
+  stepLayer(Core::VELOCITY_Z, Core::ROLL_VEL, begin, end, new_input_.data(), Core::VELOCITY_Z, dt);
+
+  // second layer: attitude loops commanded by the horizontal velocity loops, yaw rate loop
+  const double* out = controllers.output.data();
+  for (std::size_t m = begin; m < end; m++)
+  {
+    new_input_[index(Core::PITCH, m)] = out[index(Core::VELOCITY_X, m)] / gravity_[m];
+    new_input_[index(Core::ROLL, m)] = -out[index(Core::VELOCITY_Y, m)] / gravity_[m];
+  }
+  stepLayer(Core::ROLL, Core::VELOCITY_X, begin, end, new_input_.data(), Core::ROLL, dt);
+
+  for (std::size_t m = begin; m < end; m++)
+  {
+    const ControllerParameters& p = parameters[m];
+    ControllerOutput& output = outputs[m];
+    output.torque.x = p.inertia.x * out[index(Core::ROLL, m)];
+    output.torque.y = p.inertia.y * out[index(Core::PITCH, m)];
+    output.torque.z = p.inertia.z * out[index(Core::YAW, m)];
+    output.force.z = p.mass * (out[index(Core::VELOCITY_Z, m)] + load_factor_[m] * gravity_[m]);
+    if (p.max_force > 0.0 && output.force.z > p.max_force)
+      output.force.z = p.max_force;
+    if (output.force.z < 0.0)
+      output.force.z = 0.0;
+  }
+}
+}
@@ -0,0 +1,359 @@
+#include <simple_controller_core.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace prosthesis
+{
+void computeGravity(const Quaternion& orientation, const Vector3& gravity, double& gravity_length,
+                    double& load_factor)
+{
+  Vector3 gravity_body = rotate(orientation, gravity);
+  gravity_length = std::sqrt(gravity_body.x * gravity_body.x + gravity_body.y * gravity_body.y +
+                             gravity_body.z * gravity_body.z);
+  load_factor = gravity_length * gravity_length /
+                (gravity.x * gravity_body.x + gravity.y * gravity_body.y + gravity.z * gravity_body.z);
+}
+
+ControllerInput makeControllerInput()
+{
+  ControllerInput input = ControllerInput();
+  input.orientation.w = 1.0;
+  return input;
+}
+
+void resetState(ControllerInput& input)
+{
+  const Vector3 zero = { 0.0, 0.0, 0.0 };
+  const Quaternion identity = { 1.0, 0.0, 0.0, 0.0 };
+  input.position = zero;
+  input.orientation = identity;
+  input.euler = zero;
+  input.velocity = zero;
+  input.acceleration = zero;
+  input.angular_velocity = zero;
+  input.angular_acceleration = zero;
+}
+
+void applyImu(const ImuSample& imu, ControllerInput& input)
+{
+  input.orientation = imu.orientation;
+  input.euler = imu.euler;
+  input.angular_velocity = imu.angular_velocity;
+}
+
+void applyState(const StateSample& state, bool has_imu, ControllerInput& input)
+{
+  if (!has_imu)
+  {
+    input.position = state.position;
+    input.orientation = state.orientation;
+    input.euler = state.euler;
+    input.angular_velocity = state.angular_velocity;
+  }
+  input.velocity = state.velocity;
+  input.acceleration = state.acceleration;
+}
+
+void applyLink(const LinkSample& link, bool has_imu, bool has_state, double dt, ControllerInput& input)
+{
+  if (!has_imu)
+  {
+    input.position = link.position;
+    input.orientation = link.orientation;
+    input.euler = link.euler;
+    input.angular_velocity = link.angular_velocity;
+    input.angular_acceleration = link.angular_acceleration;
+  }
+  if (!has_state)
+  {
+    input.acceleration.x = (link.velocity.x - input.velocity.x) / dt;
+    input.acceleration.y = (link.velocity.y - input.velocity.y) / dt;
+    input.acceleration.z = (link.velocity.z - input.velocity.z) / dt;
+    input.velocity = link.velocity;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Cascade policies. Each one provides the loops of its topology as
+//   static void update(controllers, gains, parameters, input, dt, outer_dt, output)
+//   static void reset(controllers)  -- the loops reset while the controller is not running
+// and SimpleControllerCore::tick() is instantiated once per policy, so a tick computes nothing
+// its cascade does not use and does not branch on the cascade.
+
+typedef SimpleControllerCore Core;
+
+static void limitTorque(const ControllerParameters& p, Vector3& torque)
+{
+  if (p.max_torque <= 0.0)
+    return;
+  torque.x = std::max(-p.max_torque, std::min(p.max_torque, torque.x));
+  torque.y = std::max(-p.max_torque, std::min(p.max_torque, torque.y));
+  torque.z = std::max(-p.max_torque, std::min(p.max_torque, torque.z));
+}
+
+// attitude loops (outer, when due) commanding the rate loops, shared by the attitude and hover cascades
+static void updateAttitude(PIDBank& controllers, const PIDGains& gains, const ControllerParameters& p,
+                           const ControllerInput& input, const Vector3& command, double dt, double outer_dt,
+                           ControllerOutput& output)
+{
+  const double rate[] = { input.angular_velocity.x, input.angular_velocity.y, input.angular_velocity.z };
+  if (outer_dt > 0.0)
+  {
+    const double attitude_command[] = { command.x, command.y, command.z };
+    const double attitude[] = { input.euler.x, input.euler.y, input.euler.z };
+    controllers.update(gains, Core::ROLL, Core::YAW + 1, attitude_command, attitude, rate, outer_dt);
+  }
+  const double rate_dx[] = { input.angular_acceleration.x, input.angular_acceleration.y,
+                             input.angular_acceleration.z };
+  controllers.update(gains, Core::ROLL_VEL, Core::CONTROLLER_COUNT, &controllers.output[Core::ROLL], rate, rate_dx,
+                     dt);
+
+  output.velocity_command_angular.x = controllers.output[Core::ROLL];
+  output.velocity_command_angular.y = controllers.output[Core::PITCH];
+  output.velocity_command_angular.z = controllers.output[Core::YAW];
+  output.torque.x = p.inertia.x * controllers.output[Core::ROLL_VEL];
+  output.torque.y = p.inertia.y * controllers.output[Core::PITCH_VEL];
+  output.torque.z = p.inertia.z * controllers.output[Core::YAW_VEL];
+  limitTorque(p, output.torque);
+}
+
+static void limitThrust(const ControllerParameters& p, Vector3& force)
+{
+  if (p.max_force > 0.0 && force.z > p.max_force)
+    force.z = p.max_force;
+  if (force.z < 0.0)
+    force.z = 0.0;
+}
+
+struct PositionCascade
+{
+  static void update(PIDBank& controllers, const PIDGains& gains, const ControllerParameters& p,
+                     const ControllerInput& input, double dt, double outer_dt, ControllerOutput& output)
+  {
+    double gravity, load_factor;
+    computeGravity(input.orientation, input.gravity, gravity, load_factor);
+
+    // outer layer: position and attitude loops, stepped in one pass when due
+    if (outer_dt > 0.0)
+    {
+      const double outer_input[] = { input.position_command_linear.x,  input.position_command_linear.y,
+                                     input.position_command_linear.z,  input.position_command_angular.x,
+                                     input.position_command_angular.y, input.position_command_angular.z };
+      const double outer_x[] = { input.position.x, input.position.y, input.position.z,
+                                 input.euler.x,    input.euler.y,    input.euler.z };
+      const double outer_dx[] = { input.velocity.x,         input.velocity.y,         input.velocity.z,
+                                  input.angular_velocity.x, input.angular_velocity.y, input.angular_velocity.z };
+      controllers.update(gains, Core::POSITION_X, Core::VELOCITY_X, outer_input, outer_x, outer_dx, outer_dt);
+    }
+
+    // inner layer: velocity and rate loops, commanded by the outputs of the outer layer
+    const double inner_x[] = { input.velocity.x,         input.velocity.y,         input.velocity.z,
+                               input.angular_velocity.x, input.angular_velocity.y, input.angular_velocity.z };
+    const double inner_dx[] = { input.acceleration.x,         input.acceleration.y,
+                                input.acceleration.z,         input.angular_acceleration.x,
+                                input.angular_acceleration.y, input.angular_acceleration.z };
+    controllers.update(gains, Core::VELOCITY_X, Core::CONTROLLER_COUNT, &controllers.output[Core::POSITION_X], inner_x,
+                       inner_dx, dt);
+
+    output.velocity_command_linear.x = controllers.output[Core::POSITION_X];
+    output.velocity_command_linear.y = controllers.output[Core::POSITION_Y];
+    output.velocity_command_linear.z = controllers.output[Core::POSITION_Z];
+    output.velocity_command_angular.x = controllers.output[Core::ROLL];
+    output.velocity_command_angular.y = controllers.output[Core::PITCH];
+    output.velocity_command_angular.z = controllers.output[Core::YAW];
+
+    Vector3& force = output.force;
+    Vector3& torque = output.torque;
+    force.x = p.mass * controllers.output[Core::VELOCITY_X];
+    force.y = p.mass * controllers.output[Core::VELOCITY_Y];
+    force.z = p.mass * (controllers.output[Core::VELOCITY_Z] + load_factor * gravity);
+    torque.x = p.inertia.x * controllers.output[Core::ROLL_VEL];
+    torque.y = p.inertia.y * controllers.output[Core::PITCH_VEL];
+    torque.z = p.inertia.z * controllers.output[Core::YAW_VEL];
+
+    // saturation, including the +10 N margin on z and the torque sign test against max_force of the plugin
+    if (p.max_force > 0.0 && fabs(force.z) + 10 > p.max_force)
+      force.z = (force.z > p.max_force) ? p.max_force + 10 : -p.max_force - 10;
+    if (p.max_force > 0.0 && fabs(force.x) > p.max_force)
+      force.x = (force.x > p.max_force) ? p.max_force : -p.max_force;
+    if (p.max_force > 0.0 && fabs(force.y) > p.max_force)
+      force.y = (force.y > p.max_force) ? p.max_force : -p.max_force;
+    if (p.max_torque > 0.0 && fabs(torque.x) > p.max_torque)
+      torque.x = (torque.x > p.max_force) ? p.max_torque : -p.max_torque;
+    if (p.max_torque > 0.0 && fabs(torque.y) > p.max_torque)
+      torque.y = (torque.y > p.max_force) ? p.max_torque : -p.max_torque;
+    if (p.max_torque > 0.0 && fabs(torque.z) > p.max_torque)
+      torque.z = (torque.z > p.max_force) ? p.max_torque : -p.max_torque;
+  }
+
+  static void reset(PIDBank& controllers)
+  {
+    // everything but the position loops
+    controllers.reset(Core::ROLL, Core::CONTROLLER_COUNT);
+  }
+};
+
+struct VelocityCascade
+{
+  static void update(PIDBank& controllers, const PIDGains& gains, const ControllerParameters& p,
+                     const ControllerInput& input, double dt, double outer_dt, ControllerOutput& output)
+  {
+    double gravity, load_factor;
+    computeGravity(input.orientation, input.gravity, gravity, load_factor);
+
+    // Rotate vectors to coordinate frames relevant for control
+    const Quaternion heading_quaternion = { cos(input.euler.z / 2), 0, 0, sin(input.euler.z / 2) };
+    const Vector3 velocity_xy = rotateReverse(heading_quaternion, input.velocity);
+    const Vector3 acceleration_xy = rotateReverse(heading_quaternion, input.acceleration);
+    const Vector3 angular_velocity_body = rotateReverse(input.orientation, input.angular_velocity);
+
+    if (outer_dt > 0.0)
+    {
+      controllers.update(gains, Core::VELOCITY_X, input.velocity_command_linear.x, velocity_xy.x, acceleration_xy.x,
+                         outer_dt);
+      controllers.update(gains, Core::VELOCITY_Y, input.velocity_command_linear.y, velocity_xy.y, acceleration_xy.y,
+                         outer_dt);
+    }
+    double pitch_command = controllers.output[Core::VELOCITY_X] / gravity;
+    double roll_command = -controllers.output[Core::VELOCITY_Y] / gravity;
+    output.torque.x =
+        p.inertia.x * controllers.update(gains, Core::ROLL, roll_command, input.euler.x, angular_velocity_body.x, dt);
+    output.torque.y =
+        p.inertia.y * controllers.update(gains, Core::PITCH, pitch_command, input.euler.y, angular_velocity_body.y, dt);
+    output.torque.z = p.inertia.z * controllers.update(gains, Core::YAW, input.velocity_command_angular.z,
+                                                       input.angular_velocity.z, 0, dt);
+    output.force.z = p.mass * (controllers.update(gains, Core::VELOCITY_Z, input.velocity_command_linear.z,
+                                                  input.velocity.z, input.acceleration.z, dt) +
+                               load_factor * gravity);
+    limitThrust(p, output.force);
+  }
+
+  static void reset(PIDBank& controllers)
+  {
+    controllers.reset(Core::ROLL, Core::CONTROLLER_COUNT);
+  }
+};
+
+struct AttitudeCascade
+{
+  static void update(PIDBank& controllers, const PIDGains& gains, const ControllerParameters& p,
+                     const ControllerInput& input, double dt, double outer_dt, ControllerOutput& output)
+  {
+    double gravity, load_factor;
+    computeGravity(input.orientation, input.gravity, gravity, load_factor);
+
+    updateAttitude(controllers, gains, p, input, input.position_command_angular, dt, outer_dt, output);
+    output.force.z = p.mass * load_factor * gravity;
+    limitThrust(p, output.force);
+  }
+
+  static void reset(PIDBank& controllers)
+  {
+    controllers.reset(Core::ROLL, Core::YAW + 1);
+    controllers.reset(Core::ROLL_VEL, Core::CONTROLLER_COUNT);
+  }
+};
+
+struct HoverCascade
+{
+  static void update(PIDBank& controllers, const PIDGains& gains, const ControllerParameters& p,
+                     const ControllerInput& input, double dt, double outer_dt, ControllerOutput& output)
+  {
+    double gravity, load_factor;
+    computeGravity(input.orientation, input.gravity, gravity, load_factor);
+
+    const Vector3 level = { 0.0, 0.0, input.position_command_angular.z };
+    updateAttitude(controllers, gains, p, input, level, dt, outer_dt, output);
+
+    if (outer_dt > 0.0)
+      controllers.update(gains, Core::POSITION_Z, input.position_command_linear.z, input.position.z, input.velocity.z,
+                         outer_dt);
+    output.velocity_command_linear.z = controllers.output[Core::POSITION_Z];
+    output.force.z = p.mass * (controllers.update(gains, Core::VELOCITY_Z, controllers.output[Core::POSITION_Z],
+                                                  input.velocity.z, input.acceleration.z, dt) +
+                               load_factor * gravity);
+    limitThrust(p, output.force);
+  }
+
+  static void reset(PIDBank& controllers)
+  {
+    // the height loop keeps its state like the position loops of the position cascade
+    controllers.reset(Core::ROLL, Core::YAW + 1);
+    controllers.reset(Core::VELOCITY_Z, Core::CONTROLLER_COUNT);
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// SimpleControllerCore
+
+SimpleControllerCore::SimpleControllerCore() : controllers(CONTROLLER_COUNT)
+{
+  parameters.mass = 0.0;
+  parameters.inertia.x = parameters.inertia.y = parameters.inertia.z = 0.0;
+  parameters.max_force = -1.0;
+  parameters.max_torque = -1.0;
+  setCascade(POSITION_CASCADE);
+}
+
+void SimpleControllerCore::setCascade(Cascade cascade)
+{
+  static const Tick ticks[CASCADE_COUNT] = { &SimpleControllerCore::tick<PositionCascade>,
+                                             &SimpleControllerCore::tick<VelocityCascade>,
+                                             &SimpleControllerCore::tick<AttitudeCascade>,
+                                             &SimpleControllerCore::tick<HoverCascade> };
+  cascade_ = cascade;
+  tick_ = ticks[cascade];
+}
+
+SimpleControllerCore::Cascade SimpleControllerCore::cascade() const
+{
+  return cascade_;
+}
+
+template <class Policy>
+void SimpleControllerCore::tick(const PIDGains& gains, const ControllerInput& input, double dt, bool running,
+                                ControllerOutput& output)
+{
+  output.force.x = output.force.y = output.force.z = 0.0;
+  output.torque.x = output.torque.y = output.torque.z = 0.0;
+  output.velocity_command_linear = input.velocity_command_linear;
+  output.velocity_command_angular = input.velocity_command_angular;
+
+  // the schedule keeps running while the controller does not, so the outer layer stays in phase
+  const double outer_dt = outer_schedule.advance(dt);
+
+  if (!running)
+  {
+    Policy::reset(controllers);
+    return;
+  }
+  Policy::update(controllers, gains, parameters, input, dt, outer_dt, output);
+}
+
+void SimpleControllerCore::reset()
+{
+  // attitude and velocity loops
+  controllers.reset(ROLL, ROLL_VEL);
+}
+
+static const char* const cascade_names[] = { "position", "velocity", "attitude", "hover" };
+
+const char* cascadeName(SimpleControllerCore::Cascade cascade)
+{
+  return cascade_names[cascade];
+}
+
+bool cascadeFromName(const std::string& name, SimpleControllerCore::Cascade& cascade)
+{
+  for (int k = 0; k < SimpleControllerCore::CASCADE_COUNT; k++)
+  {
+    if (name == cascade_names[k])
+    {
+      cascade = static_cast<SimpleControllerCore::Cascade>(k);
+      return true;
+    }
+  }
+  return false;
+}
+}
@@ -0,0 +1,274 @@
+// Runs the steps of GazeboSimpleController's control tick on synthetic inputs, without gzserver,
+// and fails if any of them makes a heap call after the warm-up.
+//
+// Per tick it does what ReadInputs, PrepareTick, the core and FinishTick do with everything but
+// the Gazebo link: take over the commands, gains and imu from their mailboxes (position commands
+// as prosthesis_v7::TracedTwist), predict the setpoint, complete the input from a synthetic link
+// state, step SimpleControllerCore, record the tick to a ControllerLogWriter, queue the
+// prosthesis_v7::ControllerSample in the telemetry SpscRing and record the trace stages, and
+// ApplyWrench's last trace stage. The callback and telemetry sides (publishing into the
+// mailboxes, draining the ring) run in between on the same thread but are not counted, in the
+// plugin they run on their own threads, which may allocate.
+//
+// usage: tick_allocation_check [--ticks n] [--warm-up n] [--cascade position|velocity|attitude|hover]
+//                              [--trace-file file] [--log-file file]
+// exit code 3 if a heap call was counted
+#include <allocation_counter.h>
+#include <controller_log.h>
+#include <mailbox.h>
+#include <setpoint_predictor.h>
+#include <simple_controller_core.h>
+#include <spsc_ring.h>
+#include <trace_buffer.h>
+
+#include <geometry_msgs/Twist.h>
+#include <prosthesis_v7/ControllerSample.h>
+#include <prosthesis_v7/TracedTwist.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace prosthesis;
+
+static void usage(const char* name)
+{
+  fprintf(stderr,
+          "usage: %s [--ticks n] [--warm-up n] [--cascade position|velocity|attitude|hover]\n"
+          "       [--trace-file file] [--log-file file]\n",
+          name);
+}
+
+// link state of a slow lissajous figure with a swinging orientation
+static LinkSample makeLink(double t)
+{
+  LinkSample link;
+  link.position.x = 0.1 * sin(1.3 * t);
+  link.position.y = 0.1 * sin(0.7 * t);
+  link.position.z = 1.0 + 0.05 * sin(2.1 * t);
+  link.euler.x = 0.2 * sin(0.9 * t);
+  link.euler.y = 0.1 * sin(1.1 * t);
+  link.euler.z = 0.3 * sin(0.5 * t);
+  link.orientation = fromRPY(link.euler.x, link.euler.y, link.euler.z);
+  link.velocity.x = 0.13 * cos(1.3 * t);
+  link.velocity.y = 0.07 * cos(0.7 * t);
+  link.velocity.z = 0.105 * cos(2.1 * t);
+  link.angular_velocity.x = 0.18 * cos(0.9 * t);
+  link.angular_velocity.y = 0.11 * cos(1.1 * t);
+  link.angular_velocity.z = 0.15 * cos(0.5 * t);
+  link.angular_acceleration.x = -0.162 * sin(0.9 * t);
+  link.angular_acceleration.y = -0.121 * sin(1.1 * t);
+  link.angular_acceleration.z = -0.075 * sin(0.5 * t);
+  return link;
+}
+
+static Vector3 toCore(const geometry_msgs::Vector3& v)
+{
+  Vector3 r = { v.x, v.y, v.z };
+  return r;
+}
+
+int main(int argc, char** argv)
+{
+  long ticks = 100000;
+  long warm_up = 1000;
+  const char* cascade_name = "position";
+  const char* trace_path = "/dev/null";
+  const char* log_path = "/dev/null";
+  for (int arg = 1; arg < argc; arg++)
+  {
+    const bool has_value = arg + 1 < argc;
+    if (strcmp(argv[arg], "--ticks") == 0 && has_value)
+      ticks = atol(argv[++arg]);
+    else if (strcmp(argv[arg], "--warm-up") == 0 && has_value)
+      warm_up = atol(argv[++arg]);
+    else if (strcmp(argv[arg], "--cascade") == 0 && has_value)
+      cascade_name = argv[++arg];
+    else if (strcmp(argv[arg], "--trace-file") == 0 && has_value)
+      trace_path = argv[++arg];
+    else if (strcmp(argv[arg], "--log-file") == 0 && has_value)
+      log_path = argv[++arg];
+    else
+    {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  SimpleControllerCore::Cascade cascade;
+  if (!cascadeFromName(cascade_name, cascade) || ticks <= 0 || warm_up < 0)
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // the state the plugin sets up in Load()
+  SimpleControllerCore core;
+  core.setCascade(cascade);
+  core.parameters.mass = 1.5;
+  core.parameters.inertia.x = core.parameters.inertia.y = 0.012;
+  core.parameters.inertia.z = 0.004;
+  core.parameters.max_force = 60.0;
+  core.parameters.max_torque = 5.0;
+  core.outer_schedule.period = 0.005;
+
+  PIDGains shadow_gains;
+  shadow_gains.resize(SimpleControllerCore::CONTROLLER_COUNT);
+  for (int k = 0; k < SimpleControllerCore::CONTROLLER_COUNT; k++)
+    shadow_gains.set(k, 5.0, 0.5, 1.0, 0.01);
+
+  Mailbox<prosthesis_v7::TracedTwist> position_mailbox;
+  Mailbox<geometry_msgs::Twist> velocity_mailbox;
+  Mailbox<ImuSample> imu_mailbox;
+  Mailbox<PIDGains> gains_mailbox;
+  gains_mailbox.write(shadow_gains);
+  gains_mailbox.update();
+
+  SpscRing<prosthesis_v7::ControllerSample> telemetry_ring(1024);
+  SetpointPredictor setpoint_predictor;
+  setpoint_predictor.horizon = 0.1;
+
+  ControllerLogWriter log;
+  if (!log.open(log_path))
+  {
+    fprintf(stderr, "could not open %s for recording\n", log_path);
+    return 2;
+  }
+  if (!openTrace(trace_path, "tick_allocation_check"))
+  {
+    fprintf(stderr, "could not trace to %s\n", trace_path);
+    return 2;
+  }
+
+  ControllerInput input = makeControllerInput();
+  input.gravity.z = -9.81;
+  uint32_t applied_trace = 0, wrench_trace = 0, next_trace = 1;
+  const double dt = 0.001;
+  uint64_t allocations = 0;
+
+  for (long tick = 0; tick < warm_up + ticks; tick++)
+  {
+    const bool counted = tick >= warm_up;
+    const double time = tick * dt;
+
+    // callback queue thread: traced position commands at 50 Hz, velocity and imu at 100 Hz,
+    // a gain change every second (GainsCallback writes the shadow table of the same size)
+    if (tick % 20 == 0)
+    {
+      prosthesis_v7::TracedTwist& command = position_mailbox.back();
+      command.trace.id = next_trace++;
+      command.twist.linear.z = 1.0;
+      command.twist.angular.z = 0.3 * sin(0.5 * time);
+      position_mailbox.publish();
+    }
+    if (tick % 10 == 0)
+    {
+      geometry_msgs::Twist& command = velocity_mailbox.back();
+      command.linear.x = 0.1 * cos(time);
+      velocity_mailbox.publish();
+
+      const LinkSample link = makeLink(time);
+      ImuSample& imu = imu_mailbox.back();
+      imu.orientation = link.orientation;
+      imu.euler = link.euler;
+      imu.angular_velocity = link.angular_velocity;
+      imu_mailbox.publish();
+    }
+    if (tick % 1000 == 500)
+    {
+      shadow_gains.gain_p[SimpleControllerCore::POSITION_Z] = 5.0 + 0.1 * (tick / 1000 % 10);
+      gains_mailbox.write(shadow_gains);
+    }
+
+    if (counted)
+      AllocationCounter::start();
+
+    // ReadInputs
+    if (position_mailbox.update())
+    {
+      const prosthesis_v7::TracedTwist& command = position_mailbox.read();
+      input.position_command_linear = toCore(command.twist.linear);
+      input.position_command_angular = toCore(command.twist.angular);
+      if (command.trace.id != 0)
+      {
+        recordTrace("controller apply", traceClock(), 0, command.trace.id, TRACE_FLOW_THROUGH);
+        applied_trace = command.trace.id;
+      }
+      setpoint_predictor.command(input.position_command_angular, time);
+      LogCommand logged = { input.position_command_linear, input.position_command_angular };
+      log.write(LOG_POSITION_COMMAND, time, logged);
+    }
+    if (setpoint_predictor.hasCommand())
+      input.position_command_angular = setpoint_predictor.predict(time);
+    if (velocity_mailbox.update())
+    {
+      input.velocity_command_linear = toCore(velocity_mailbox.read().linear);
+      input.velocity_command_angular = toCore(velocity_mailbox.read().angular);
+    }
+    if (imu_mailbox.update())
+    {
+      applyImu(imu_mailbox.read(), input);
+      log.write(LOG_IMU, time, imu_mailbox.read());
+    }
+    if (gains_mailbox.update())
+      log.writeGains(time, gains_mailbox.read());
+
+    // PrepareTick, with the link state Gazebo would report
+    const LinkSample link = makeLink(time);
+    applyLink(link, true, false, dt, input);
+
+    ControllerOutput output;
+    core.update(gains_mailbox.read(), input, dt, true, output);
+
+    // FinishTick
+    input.velocity_command_linear = output.velocity_command_linear;
+    input.velocity_command_angular = output.velocity_command_angular;
+    LogTick logged_tick;
+    logged_tick.dt = dt;
+    logged_tick.running = 1.0;
+    logged_tick.gravity = input.gravity;
+    logged_tick.link = link;
+    logged_tick.force = output.force;
+    logged_tick.torque = output.torque;
+    log.write(LOG_TICK, time, logged_tick);
+
+    prosthesis_v7::ControllerSample sample;
+    sample.stamp.fromSec(time);
+    sample.wrench.force.x = output.force.x;
+    sample.wrench.force.y = output.force.y;
+    sample.wrench.force.z = output.force.z;
+    sample.wrench.torque.x = output.torque.x;
+    sample.wrench.torque.y = output.torque.y;
+    sample.wrench.torque.z = output.torque.z;
+    sample.desired_velocity.linear.x = output.velocity_command_linear.x;
+    sample.desired_velocity.linear.y = output.velocity_command_linear.y;
+    sample.desired_velocity.linear.z = output.velocity_command_linear.z;
+    telemetry_ring.push(sample);
+    if (applied_trace != 0)
+    {
+      recordTrace("controller tick", traceClock(), 0, applied_trace, TRACE_FLOW_THROUGH);
+      wrench_trace = applied_trace;
+      applied_trace = 0;
+    }
+
+    // ApplyWrench
+    if (wrench_trace != 0)
+    {
+      recordTrace("controller wrench", traceClock(), 0, wrench_trace, TRACE_FLOW_IN);
+      wrench_trace = 0;
+    }
+
+    if (counted)
+      allocations += AllocationCounter::stop();
+
+    // telemetry thread: drain the ring
+    while (telemetry_ring.front() != NULL)
+      telemetry_ring.pop();
+  }
+  closeTrace();
+
+  printf("cascade: %s\nticks: %ld after %ld warm-up ticks\nheap calls: %lu\n", cascadeName(cascade), ticks, warm_up,
+         static_cast<unsigned long>(allocations));
+  return allocations ? 3 : 0;
+}
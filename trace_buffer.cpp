@@ -0,0 +1,210 @@
+#include <trace_buffer.h>
+#include <spsc_ring.h>
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace prosthesis
+{
+namespace
+{
+struct TraceEvent
+{
+  const char* name;
+  uint64_t start;
+  uint64_t duration;
+  uint32_t id;
+  TraceFlow flow;
+};
+
+// the events of one thread, recorded by it and drained by flushTrace()
+struct ThreadTrace
+{
+  SpscRing<TraceEvent> ring;
+  unsigned tid;
+  char name[32];
+  bool described;  // thread name written to the current file
+};
+
+struct TraceState
+{
+  TraceState() : enabled(false), dropped(0), file(NULL), capacity(0), pid(0)
+  {
+  }
+
+  std::atomic<bool> enabled;
+  std::atomic<uint64_t> dropped;
+
+  // everything below is guarded by mutex
+  std::mutex mutex;
+  FILE* file;
+  std::size_t capacity;
+  int pid;
+  // rings are kept after their thread ended, its events are still to be written and
+  // the ring is reused by the next trace of the process
+  std::vector<ThreadTrace*> threads;
+};
+
+TraceState& state()
+{
+  static TraceState trace;
+  return trace;
+}
+
+thread_local ThreadTrace* local_trace = NULL;
+
+// thread names come from the system and are written into JSON strings
+void copyName(char* target, std::size_t size, const char* source)
+{
+  std::size_t k = 0;
+  for (; source[k] && k + 1 < size; k++)
+  {
+    const bool plain = source[k] != '"' && source[k] != '\\' && static_cast<unsigned char>(source[k]) >= 0x20;
+    target[k] = plain ? source[k] : '_';
+  }
+  target[k] = '\0';
+}
+
+ThreadTrace* registerThread()
+{
+  TraceState& trace = state();
+  // the ring keeps its indices on their own cache lines, which plain new does not honour before C++17
+  void* memory = NULL;
+  if (posix_memalign(&memory, alignof(ThreadTrace), sizeof(ThreadTrace)) != 0)
+    return NULL;
+  ThreadTrace* thread = new (memory) ThreadTrace;
+  char name[16] = "";
+  pthread_getname_np(pthread_self(), name, sizeof(name));
+  copyName(thread->name, sizeof(thread->name), name);
+  thread->described = false;
+
+  std::lock_guard<std::mutex> lock(trace.mutex);
+  thread->ring.resize(trace.capacity);
+  thread->tid = trace.threads.size() + 1;
+  trace.threads.push_back(thread);
+  return thread;
+}
+
+void writeEvent(FILE* file, int pid, unsigned tid, const TraceEvent& event)
+{
+  // microseconds with three decimals from the integer nanoseconds, a double would round them
+  fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%d,\"tid\":%u,", event.name,
+          static_cast<unsigned long long>(event.start / 1000), static_cast<unsigned>(event.start % 1000),
+          static_cast<unsigned long long>(event.duration / 1000), static_cast<unsigned>(event.duration % 1000), pid,
+          tid);
+  if (event.id != 0 && event.flow != TRACE_FLOW_NONE)
+    fprintf(file, "\"bind_id\":%u,\"flow_in\":%s,\"flow_out\":%s,", event.id,
+            event.flow & TRACE_FLOW_IN ? "true" : "false", event.flow & TRACE_FLOW_OUT ? "true" : "false");
+  fprintf(file, "\"args\":{\"id\":%u}},\n", event.id);
+}
+
+// write (or with file NULL discard) the buffered events, with the mutex held
+void drain(TraceState& trace, FILE* file)
+{
+  for (std::size_t k = 0; k < trace.threads.size(); k++)
+  {
+    ThreadTrace& thread = *trace.threads[k];
+    const TraceEvent* event = thread.ring.front();
+    if (file && event && !thread.described)
+    {
+      fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n",
+              trace.pid, thread.tid, thread.name[0] ? thread.name : "thread");
+      thread.described = true;
+    }
+    for (; event != NULL; event = thread.ring.front())
+    {
+      if (file)
+        writeEvent(file, trace.pid, thread.tid, *event);
+      thread.ring.pop();
+    }
+  }
+}
+}
+
+uint64_t traceClock()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec;
+}
+
+bool openTrace(const std::string& path, const std::string& process_name, std::size_t events_per_thread)
+{
+  TraceState& trace = state();
+  std::lock_guard<std::mutex> lock(trace.mutex);
+  if (trace.file)
+    return false;
+  trace.file = fopen(path.c_str(), "w");
+  if (!trace.file)
+    return false;
+
+  // events left over from an earlier trace of this process
+  drain(trace, NULL);
+  trace.capacity = events_per_thread;
+  trace.pid = getpid();
+  trace.dropped.store(0);
+  for (std::size_t k = 0; k < trace.threads.size(); k++)
+    trace.threads[k]->described = false;
+
+  // the JSON array format, viewers accept it without the closing bracket if the process dies
+  char name[64];
+  copyName(name, sizeof(name), process_name.c_str());
+  fprintf(trace.file, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+          trace.pid, name);
+  trace.enabled.store(true);
+  return true;
+}
+
+bool traceEnabled()
+{
+  return state().enabled.load(std::memory_order_relaxed);
+}
+
+void recordTrace(const char* name, uint64_t start, uint64_t duration, uint32_t id, TraceFlow flow)
+{
+  TraceState& trace = state();
+  if (!trace.enabled.load(std::memory_order_relaxed))
+    return;
+  if (!local_trace)
+    local_trace = registerThread();
+
+  TraceEvent event = { name, start, duration, id, flow };
+  if (!local_trace || !local_trace->ring.push(event))
+    trace.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void flushTrace()
+{
+  TraceState& trace = state();
+  std::lock_guard<std::mutex> lock(trace.mutex);
+  if (!trace.file)
+    return;
+  drain(trace, trace.file);
+  fflush(trace.file);
+}
+
+void closeTrace()
+{
+  TraceState& trace = state();
+  std::lock_guard<std::mutex> lock(trace.mutex);
+  if (!trace.file)
+    return;
+  trace.enabled.store(false);
+  drain(trace, trace.file);
+
+  // the events lost to full rings as a counter at the end of the trace
+  fprintf(trace.file,
+          "{\"name\":\"dropped events\",\"ph\":\"C\",\"ts\":%llu,\"pid\":%d,\"args\":{\"dropped\":%llu}}\n]\n",
+          static_cast<unsigned long long>(traceClock() / 1000), trace.pid,
+          static_cast<unsigned long long>(trace.dropped.load()));
+  fclose(trace.file);
+  trace.file = NULL;
+}
+}
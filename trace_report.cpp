@@ -0,0 +1,189 @@
+// Merges the trace files of several processes (myo_control_node's and the controller's
+// trace_file, see trace_buffer.h) into one that Perfetto or chrome://tracing can open, and
+// prints how long the commands took from stage to stage.
+//
+// The stages of one command share its trace id, the seq of the Myo pose it came from. Per
+// command the first event of every stage counts, the hops between consecutive stages and
+// the whole chain are reported as percentiles over all commands.
+//
+// usage: trace_report [--output merged.json] <trace file>...
+#include <latency_histogram.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace prosthesis;
+
+namespace
+{
+struct Stage
+{
+  uint64_t time;  // ns
+  std::string name;
+
+  bool operator<(const Stage& other) const
+  {
+    return time < other.time;
+  }
+};
+
+struct Hop
+{
+  std::string name;
+  LatencyHistogram histogram;
+};
+
+// the value of "key": in a line written by trace_buffer.cpp, NULL if it has none
+const char* field(const std::string& line, const char* key)
+{
+  const std::size_t at = line.find(key);
+  return at == std::string::npos ? NULL : line.c_str() + at + strlen(key);
+}
+
+// "ts" in microseconds with up to three decimals, as integer nanoseconds
+uint64_t parseTime(const char* text)
+{
+  char* end;
+  uint64_t time = strtoull(text, &end, 10) * 1000;
+  if (*end == '.')
+  {
+    uint64_t scale = 100;
+    for (const char* digit = end + 1; *digit >= '0' && *digit <= '9' && scale > 0; digit++, scale /= 10)
+      time += (*digit - '0') * scale;
+  }
+  return time;
+}
+
+// hops are kept in the map, which never moves its elements, and listed in the order they first show up
+Hop& hop(std::map<std::string, Hop>& hops, std::vector<Hop*>& order, const std::string& name)
+{
+  Hop& entry = hops[name];
+  if (entry.name.empty())
+  {
+    entry.name = name;
+    order.push_back(&entry);
+  }
+  return entry;
+}
+}
+
+int main(int argc, char** argv)
+{
+  const char* output_path = NULL;
+  std::vector<const char*> paths;
+  for (int arg = 1; arg < argc; arg++)
+  {
+    if (strcmp(argv[arg], "--output") == 0 && arg + 1 < argc)
+    {
+      output_path = argv[++arg];
+    }
+    else if (argv[arg][0] != '-')
+    {
+      paths.push_back(argv[arg]);
+    }
+    else
+    {
+      paths.clear();
+      break;
+    }
+  }
+  if (paths.empty())
+  {
+    fprintf(stderr, "usage: %s [--output merged.json] <trace file>...\n", argv[0]);
+    return 2;
+  }
+
+  // the events are one per line, so merging is collecting the lines of all files
+  std::vector<std::string> events;
+  std::map<uint32_t, std::vector<Stage> > commands;
+  for (std::size_t k = 0; k < paths.size(); k++)
+  {
+    std::ifstream file(paths[k]);
+    if (!file)
+    {
+      fprintf(stderr, "could not open %s\n", paths[k]);
+      return 2;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+      if (line.empty() || line[0] != '{')
+        continue;
+      if (line[line.size() - 1] == ',')
+        line.erase(line.size() - 1);
+      events.push_back(line);
+
+      const char* name = field(line, "\"name\":\"");
+      const char* phase = field(line, "\"ph\":\"");
+      const char* time = field(line, "\"ts\":");
+      const char* id = field(line, "\"args\":{\"id\":");
+      if (!name || !phase || *phase != 'X' || !time || !id)
+        continue;
+      const uint32_t trace_id = strtoul(id, NULL, 10);
+      if (trace_id == 0)
+        continue;
+      Stage stage;
+      stage.time = parseTime(time);
+      stage.name.assign(name, strchr(name, '"') - name);
+      commands[trace_id].push_back(stage);
+    }
+  }
+
+  if (output_path)
+  {
+    FILE* output = fopen(output_path, "w");
+    if (!output)
+    {
+      fprintf(stderr, "could not open %s\n", output_path);
+      return 2;
+    }
+    fprintf(output, "[\n");
+    for (std::size_t k = 0; k < events.size(); k++)
+      fprintf(output, "%s%s\n", events[k].c_str(), k + 1 < events.size() ? "," : "");
+    fprintf(output, "]\n");
+    fclose(output);
+  }
+
+  // the chain of every command sorted by time
+  std::map<std::string, Hop> hops;
+  std::vector<Hop*> order;
+  std::size_t complete = 0;
+  for (std::map<uint32_t, std::vector<Stage> >::iterator command = commands.begin(); command != commands.end();
+       ++command)
+  {
+    std::vector<Stage>& stages = command->second;
+    std::stable_sort(stages.begin(), stages.end());
+    std::vector<Stage> first;
+    for (std::size_t k = 0; k < stages.size(); k++)
+    {
+      bool seen = false;
+      for (std::size_t j = 0; j < first.size() && !seen; j++)
+        seen = first[j].name == stages[k].name;
+      if (!seen)
+        first.push_back(stages[k]);
+    }
+    if (first.size() < 2)
+      continue;
+    complete++;
+    for (std::size_t k = 1; k < first.size(); k++)
+      hop(hops, order, first[k - 1].name + " -> " + first[k].name).histogram.record(first[k].time - first[k - 1].time);
+    hop(hops, order, "end to end: " + first.front().name + " -> " + first.back().name)
+        .histogram.record(first.back().time - first.front().time);
+  }
+
+  printf("events: %zu\ncommands: %zu, %zu with more than one stage\n", events.size(), commands.size(), complete);
+  printf("%-72s %8s %10s %10s %10s\n", "hop", "count", "p50 [us]", "p99 [us]", "max [us]");
+  for (std::size_t k = 0; k < order.size(); k++)
+  {
+    const LatencyHistogram& histogram = order[k]->histogram;
+    printf("%-72s %8lu %10.1f %10.1f %10.1f\n", order[k]->name.c_str(), static_cast<unsigned long>(histogram.count()),
+           1e-3 * histogram.percentile(0.5), 1e-3 * histogram.percentile(0.99), 1e-3 * histogram.max());
+  }
+  return 0;
+}
@@ -0,0 +1,138 @@
+#include <work_stealing_pool.h>
+
+namespace prosthesis
+{
+static std::size_t workerCount(std::size_t threads)
+{
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  return threads > 0 ? threads : 1;
+}
+
+WorkStealingPool::WorkStealingPool(std::size_t threads)
+  : queues_(workerCount(threads)), task_(NULL), generation_(0), stop_(false), remaining_(0)
+{
+  for (std::size_t worker = 1; worker < queues_.size(); worker++)
+    threads_.push_back(std::thread(&WorkStealingPool::workerThread, this, worker));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::size_t k = 0; k < threads_.size(); k++)
+    threads_[k].join();
+}
+
+std::size_t WorkStealingPool::size() const
+{
+  return queues_.size();
+}
+
+void WorkStealingPool::parallelFor(std::size_t count, std::size_t grain, const Task& task)
+{
+  if (count == 0)
+    return;
+  if (grain == 0)
+    grain = 1;
+
+  const std::size_t chunks = (count + grain - 1) / grain;
+  const std::size_t workers = queues_.size();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    remaining_ = chunks;
+
+    // contiguous blocks of chunks per worker, so neighbouring indices stay on one thread until stolen
+    for (std::size_t worker = 0; worker < workers; worker++)
+    {
+      std::lock_guard<std::mutex> queue_lock(queues_[worker].mutex);
+      for (std::size_t chunk = chunks * worker / workers; chunk < chunks * (worker + 1) / workers; chunk++)
+      {
+        Range range = { chunk * grain, chunk * grain + grain < count ? chunk * grain + grain : count };
+        queues_[worker].ranges.push_back(range);
+      }
+    }
+    generation_++;
+  }
+  wake_.notify_all();
+
+  while (runOne(0))
+  {
+  }
+
+  // chunks stolen by the other workers may still be running
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (remaining_ != 0)
+    done_.wait(lock);
+  task_ = NULL;
+}
+
+void WorkStealingPool::workerThread(std::size_t worker)
+{
+  uint64_t generation = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!stop_ && generation == generation_)
+        wake_.wait(lock);
+      if (stop_)
+        return;
+      generation = generation_;
+    }
+
+    while (runOne(worker))
+    {
+    }
+  }
+}
+
+bool WorkStealingPool::runOne(std::size_t worker)
+{
+  const std::size_t workers = queues_.size();
+  Range range;
+  bool found = false;
+
+  // own queue from the back, most recently dealt chunk first
+  {
+    Queue& own = queues_[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.ranges.empty())
+    {
+      range = own.ranges.back();
+      own.ranges.pop_back();
+      found = true;
+    }
+  }
+
+  // steal from the front of the others, the chunks their owners would run last
+  for (std::size_t k = 1; !found && k < workers; k++)
+  {
+    Queue& victim = queues_[(worker + k) % workers];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.ranges.empty())
+    {
+      range = victim.ranges.front();
+      victim.ranges.pop_front();
+      found = true;
+    }
+  }
+
+  if (!found)
+    return false;
+
+  // task_ is set before any chunk is queued and cleared only after all of them are done
+  (*task_)(range.begin, range.end);
+
+  if (--remaining_ == 0)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_.notify_all();
+  }
+  return true;
+}
+}